@@ -0,0 +1,144 @@
+#include "TestSupport.h"
+#include "DBFAggregate.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+    const int ROWS = 20000; // three parallel chunks
+    const int DELETED = 10;
+
+    struct Row {
+        std::string id, item, city, date;
+        int qty;
+    };
+
+    struct Totals {
+        unsigned long rows = 0;
+        double sum = 0, min = 0, max = 0;
+    };
+
+    std::vector<Row> MakeRows() {
+        std::vector<Row> rows;
+        for (int i = 0; i < ROWS; ++i) {
+            char id[8], date[9];
+            snprintf(id, sizeof(id), "R%05d", i);
+            snprintf(date, sizeof(date), "2024%02d%02d", 1 + i % 12, 1 + i % 28);
+            rows.push_back({ id, "I" + std::to_string(i % 7), "C" + std::to_string(i % 3), date, (i * 37) % 500 - 100 });
+        }
+        return rows;
+    }
+
+    // s.dbf holding MakeRows, with the first DELETED rows deleted
+    void CreateRows(DBFManager& table) {
+        REQUIRE(Tests::CreateTable("s.dbf", { Tests::Field("ID", 'C', 6), Tests::Field("ITEM", 'C', 4),
+            Tests::Field("CITY", 'C', 4), Tests::Field("DATE", 'D', 8), Tests::Field("QTY", 'N', 6) }, table));
+        std::vector<std::vector<std::string>> values;
+        for (const Row& row : MakeRows()) values.push_back({ row.id, row.item, row.city, row.date, std::to_string(row.qty) });
+        REQUIRE(table.AddRecords(values));
+        for (int i = 0; i < DELETED; ++i) REQUIRE(table.DeleteByFieldKey("ID", values[i][0]));
+    }
+
+    // The same grouping worked out from MakeRows, by item and month
+    std::map<std::vector<std::string>, Totals> ByItemAndMonth(const std::string& city = "") {
+        std::map<std::vector<std::string>, Totals> out;
+        std::vector<Row> rows = MakeRows();
+        for (size_t i = DELETED; i < rows.size(); ++i) {
+            if (!city.empty() && rows[i].city != city) continue;
+            Totals& totals = out[{ rows[i].item, rows[i].date.substr(0, 6) }];
+            totals.min = totals.rows ? std::min(totals.min, (double)rows[i].qty) : rows[i].qty;
+            totals.max = totals.rows ? std::max(totals.max, (double)rows[i].qty) : rows[i].qty;
+            totals.sum += rows[i].qty;
+            totals.rows++;
+        }
+        return out;
+    }
+
+    void AddAggregates(DBFAggregator& aggregator) {
+        REQUIRE(aggregator.Add(DBFAggregator::AGG_COUNT));
+        REQUIRE(aggregator.Add(DBFAggregator::AGG_SUM, "QTY"));
+        REQUIRE(aggregator.Add(DBFAggregator::AGG_MIN, "QTY"));
+        REQUIRE(aggregator.Add(DBFAggregator::AGG_MAX, "QTY"));
+        REQUIRE(aggregator.Add(DBFAggregator::AGG_AVG, "QTY"));
+    }
+
+    void CheckGroups(const std::vector<DBFAggregator::Group>& groups, const std::map<std::vector<std::string>, Totals>& expected) {
+        REQUIRE(groups.size() == expected.size());
+        auto it = expected.begin();
+        for (const auto& group : groups) {
+            CHECK(group.keys == it->first);
+            CHECK(group.rows == it->second.rows);
+            CHECK(group.values[0] == it->second.rows);
+            CHECK(group.values[1] == it->second.sum);
+            CHECK(group.values[2] == it->second.min);
+            CHECK(group.values[3] == it->second.max);
+            CHECK(group.values[4] == it->second.sum / it->second.rows);
+            ++it;
+        }
+    }
+}
+
+TEST(GroupByAFieldAndADatePrefix) {
+    DBFManager table;
+    CreateRows(table);
+
+    DBFAggregator aggregator(table);
+    REQUIRE(aggregator.GroupBy("ITEM"));
+    REQUIRE(aggregator.GroupBy("DATE", 6));
+    AddAggregates(aggregator);
+    CHECK(!aggregator.GroupBy("NONE"));
+    CHECK(!aggregator.Add(DBFAggregator::AGG_SUM, "ITEM"));
+
+    // Whole numbers add up exactly, so SUM and AVG match for any thread count
+    for (unsigned threads : { 1u, 4u }) {
+        std::vector<DBFAggregator::Group> groups;
+        REQUIRE(aggregator.Run(groups, threads));
+        CheckGroups(groups, ByItemAndMonth());
+    }
+}
+
+TEST(ForOnlyAggregatesMatchingRows) {
+    DBFManager table;
+    CreateRows(table);
+
+    DBFAggregator aggregator(table);
+    REQUIRE(aggregator.GroupBy("ITEM"));
+    REQUIRE(aggregator.GroupBy("DATE", 6));
+    AddAggregates(aggregator);
+    REQUIRE(aggregator.For("CITY='C1'"));
+    CHECK(!aggregator.For("NONE='C1'"));
+
+    for (unsigned threads : { 1u, 4u }) {
+        std::vector<DBFAggregator::Group> groups;
+        REQUIRE(aggregator.Run(groups, threads));
+        CheckGroups(groups, ByItemAndMonth("C1"));
+    }
+}
+
+// Without GroupBy there is one group even when nothing matched; with it,
+// no group at all
+TEST(NoMatchingRowsGiveZeroes) {
+    DBFManager table;
+    CreateRows(table);
+
+    DBFAggregator aggregator(table);
+    AddAggregates(aggregator);
+    REQUIRE(aggregator.For("QTY>1000"));
+    for (unsigned threads : { 1u, 4u }) {
+        std::vector<DBFAggregator::Group> groups;
+        REQUIRE(aggregator.Run(groups, threads));
+        REQUIRE(groups.size() == 1);
+        CHECK(groups[0].keys.empty());
+        CHECK(groups[0].rows == 0);
+        CHECK(groups[0].values == std::vector<double>(5, 0.0));
+    }
+
+    REQUIRE(aggregator.GroupBy("ITEM"));
+    for (unsigned threads : { 1u, 4u }) {
+        std::vector<DBFAggregator::Group> groups;
+        REQUIRE(aggregator.Run(groups, threads));
+        CHECK(groups.empty());
+    }
+}
@@ -0,0 +1,107 @@
+#include "TestSupport.h"
+#include "BPlusTreeIndex.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+    const unsigned short KEY_LENGTH = 8;
+
+    // K0000.. blank-padded to the key width
+    std::string Key(unsigned n) {
+        char key[16];
+        snprintf(key, sizeof(key), "K%04u", n);
+        std::string out = key;
+        out.resize(KEY_LENGTH, ' ');
+        return out;
+    }
+
+    // Record numbers in (key, recno) order, as the tree returns them
+    std::vector<unsigned> Expected(const std::multimap<std::string, unsigned>& entries, const std::string& low,
+        const std::string& high) {
+        std::vector<std::pair<std::string, unsigned>> sorted;
+        for (auto it = entries.lower_bound(low); it != entries.upper_bound(high); ++it) sorted.push_back(*it);
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<unsigned> out;
+        for (const auto& entry : sorted) out.push_back(entry.second);
+        return out;
+    }
+}
+
+// Enough entries for leaf and interior splits, inserted out of order with
+// every key twice, then found again after the file is reopened
+TEST(TreeInsertsAndErasesSurviveReopening) {
+    const unsigned KEYS = 3000;
+    std::multimap<std::string, unsigned> entries;
+    {
+        BPlusTreeIndex tree;
+        REQUIRE(tree.Create("t.bpt", KEY_LENGTH));
+        unsigned recno = 1;
+        for (unsigned i = 0; i < KEYS; ++i) {
+            unsigned n = (i * 7919) % KEYS;
+            for (int copy = 0; copy < 2; ++copy) {
+                REQUIRE(tree.Insert(Key(n), recno));
+                entries.emplace(Key(n), recno++);
+            }
+        }
+        CHECK(!tree.Insert("SHORT", recno));
+
+        // Every third key loses its first row
+        for (unsigned n = 0; n < KEYS; n += 3) {
+            auto it = entries.find(Key(n));
+            REQUIRE(tree.Erase(it->first, it->second));
+            entries.erase(it);
+        }
+        CHECK(!tree.Erase(Key(0), 999999));
+    }
+
+    BPlusTreeIndex tree;
+    REQUIRE(tree.Open("t.bpt"));
+    CHECK(tree.GetKeyLength() == KEY_LENGTH);
+    CHECK(tree.GetEntryCount() == entries.size());
+
+    std::vector<unsigned> found;
+    for (unsigned n = 0; n < KEYS; n += 97) {
+        REQUIRE(tree.Find(Key(n), found));
+        CHECK(found == Expected(entries, Key(n), Key(n)));
+    }
+    CHECK(!tree.Find("K9999", found));
+
+    REQUIRE(tree.FindRange(Key(100), Key(250), found));
+    CHECK(found == Expected(entries, Key(100), Key(250)));
+
+    // K012 covers K0120 to K0129 and nothing else
+    REQUIRE(tree.FindPrefix("K012", found));
+    CHECK(found == Expected(entries, Key(120), Key(129)));
+}
+
+TEST(BulkLoadedTreeKeepsItsSyncStamp) {
+    const unsigned char today[3] = { 124, 1, 31 };
+    std::multimap<std::string, unsigned> entries;
+    {
+        std::vector<BPlusTreeIndex::Entry> load;
+        for (unsigned i = 0; i < 2000; ++i) {
+            load.push_back({ Key(1999 - i), i + 1 });
+            entries.emplace(Key(1999 - i), i + 1);
+        }
+        BPlusTreeIndex tree;
+        REQUIRE(tree.Create("t.bpt", KEY_LENGTH));
+        REQUIRE(tree.BulkLoad(load));
+        REQUIRE(tree.SetSynced(2000, today, 7));
+    }
+
+    BPlusTreeIndex tree;
+    REQUIRE(tree.Open("t.bpt"));
+    CHECK(tree.IsSyncedWith(2000, today, 7));
+    CHECK(!tree.IsSyncedWith(2000, today, 8));
+    CHECK(!tree.IsSyncedWith(2001, today, 7));
+
+    std::vector<unsigned> found;
+    REQUIRE(tree.FindRange(Key(0), Key(1999), found));
+    CHECK(found == Expected(entries, Key(0), Key(1999)));
+    REQUIRE(tree.Insert(Key(5), 2001));
+    REQUIRE(tree.Find(Key(5), found));
+    CHECK(found == std::vector<unsigned>({ 1995, 2001 }));
+}
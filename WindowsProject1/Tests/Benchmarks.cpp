@@ -0,0 +1,93 @@
+#include "TestSupport.h"
+#include "ProductDBManager.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Timings behind the figures quoted when these paths went in, on generated
+// tables so they run anywhere: Tests --bench [name ...]
+namespace {
+    // Zero-padded so every key has the same width
+    std::string Key(const char* prefix, unsigned n) {
+        char key[16];
+        snprintf(key, sizeof(key), "%s%05u", prefix, n);
+        return key;
+    }
+
+    // b.dbf with rows keyed K00000.. and a few fields of each type
+    void CreateRows(DBFManager& table, unsigned rows) {
+        REQUIRE(Tests::CreateTable("b.dbf", { Tests::Field("ID", 'C', 10), Tests::Field("NAME", 'C', 30),
+            Tests::Field("CITY", 'C', 20), Tests::Field("QTY", 'N', 8), Tests::Field("PRICE", 'N', 12, 2) }, table));
+        std::vector<std::vector<std::string>> values;
+        for (unsigned i = 0; i < rows; ++i) {
+            values.push_back({ Key("K", i), "Customer name " + std::to_string(i % 977), "City " + std::to_string(i % 31),
+                std::to_string(i % 500), std::to_string(i % 1000) + ".25" });
+        }
+        REQUIRE(table.AddRecords(values));
+    }
+}
+
+// Repeated key lookups on a small hot set, with and without the page pool
+BENCHMARK(PagePoolHotKeyLookups) {
+    const unsigned ROWS = 26000, LOOKUPS = 52000, HOT = 64;
+    DBFManager table;
+    CreateRows(table, ROWS);
+
+    for (size_t budget : { (size_t)0, (size_t)4 << 20 }) {
+        REQUIRE(table.SetPagePoolBudget(budget));
+        std::vector<std::string> row;
+        REQUIRE(table.GetByFieldKey("ID", Key("K", 0), row)); // builds the field index
+
+        unsigned long long misses = table.GetPagePoolStats().misses;
+        double ms = Tests::TimeBest(3, [&] {
+            for (unsigned i = 0; i < LOOKUPS; ++i) table.GetByFieldKey("ID", Key("K", (i * 7919) % HOT * (ROWS / HOT)), row);
+        });
+        printf("    budget %zu KB: %u lookups in %.1f ms, %llu misses\n",
+            budget >> 10, LOOKUPS, ms, table.GetPagePoolStats().misses - misses);
+    }
+}
+
+// Memory and build time of the decoded rows BuildIndices keeps
+BENCHMARK(RowCacheBuild) {
+    const unsigned ROWS = 26000;
+    DBFManager table;
+    CreateRows(table, ROWS);
+
+    double ms = Tests::TimeBest(3, [&] { table.BuildIndices(); });
+    const DBFRowCache& cache = table.GetRowCache();
+    CHECK(cache.RowCount() == ROWS);
+    printf("    %zu rows x %zu fields: %.2f MB, built in %.1f ms\n",
+        cache.RowCount(), cache.FieldCount(), cache.MemoryUsage() / 1048576.0, ms);
+}
+
+// Per-product COGS through the PRODUCTID+DTOS(DATE) index, and the batch
+BENCHMARK(MovementRangeLookups) {
+    const unsigned MOVEMENTS = 60000, PRODUCTS = 3100;
+    {
+        DBFTableManager movements("inventory_movements.dbf");
+        for (const auto& field : DBFRecordLayout<Product::InventoryMovement>::Descriptors())
+            movements.AddFieldDescriptor(field);
+
+        std::vector<Product::InventoryMovement> rows;
+        for (unsigned i = 0; i < MOVEMENTS; ++i) {
+            char date[9];
+            snprintf(date, sizeof(date), "2024%02u%02u", 1 + i % 12, 1 + i % 28);
+            bool purchase = i % 3 != 2;
+            rows.push_back({ date, Key("P", i % PRODUCTS), purchase ? 10 : -4, 2.5, purchase ? "PURCHASE" : "SALE", "" });
+        }
+        REQUIRE(movements.AddTypedRecords(rows));
+    }
+
+    Product products;
+    CHECK(products.CalculateCOGS_Average(Key("P", 0), "20240101", "20241231") >= 0); // builds the index
+
+    double ms = Tests::TimeBest(3, [&] {
+        for (unsigned p = 0; p < PRODUCTS; ++p) products.CalculateCOGS_Average(Key("P", p), "20240101", "20241231");
+    });
+    printf("    average COGS: %.1f us per product\n", ms * 1000 / PRODUCTS);
+
+    std::vector<Product::COGSResult> results;
+    ms = Tests::TimeBest(3, [&] { products.CalculateCOGS_Batch("20240101", "20241231", results); });
+    CHECK(results.size() == PRODUCTS);
+    printf("    batch COGS of %u products: %.1f ms\n", PRODUCTS, ms);
+}
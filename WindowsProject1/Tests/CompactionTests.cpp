@@ -0,0 +1,75 @@
+#include "TestSupport.h"
+#include "DBFManager.h"
+#include <string>
+
+namespace {
+    // c.dbf with rows R0..R9, then the given ones deleted
+    void CreateWithHoles(DBFManager& table, const std::vector<std::string>& deleted) {
+        REQUIRE(Tests::CreateTable("c.dbf", { Tests::Field("ID", 'C', 10) }, table));
+        std::vector<std::vector<std::string>> rows;
+        for (int i = 0; i < 10; ++i) rows.push_back({ "R" + std::to_string(i) });
+        REQUIRE(table.AddRecords(rows));
+        for (const auto& id : deleted) REQUIRE(table.DeleteByFieldKey("ID", id));
+    }
+
+    std::vector<std::string> Ids(DBFManager& table) {
+        std::vector<std::vector<std::string>> rows;
+        table.GetAllRecords(rows, 1);
+        std::vector<std::string> out;
+        for (auto& row : rows) out.push_back(row[0]);
+        return out;
+    }
+}
+
+TEST(CompactionKeepsRowsInFileOrder) {
+    DBFManager table;
+    CreateWithHoles(table, { "R1", "R2", "R6", "R9" });
+
+    bool done = false;
+    for (int step = 0; step < 20 && !done; ++step) REQUIRE(table.CompactStep(2, done));
+    REQUIRE(done);
+
+    CHECK(table.RecordCount() == 6);
+    CHECK(table.FreeSlotCount() == 0);
+    CHECK((Ids(table) == std::vector<std::string>{ "R0", "R3", "R4", "R5", "R7", "R8" }));
+
+    // Moved rows are found again through their index at the new position
+    std::vector<std::string> row;
+    REQUIRE(table.GetByFieldKey("ID", "R8", row));
+    CHECK(row[0] == "R8");
+}
+
+TEST(CompactedTableStaysCorrectAfterReopen) {
+    {
+        DBFManager table;
+        CreateWithHoles(table, { "R0", "R5" });
+        bool done = false;
+        while (!done) REQUIRE(table.CompactStep(100, done));
+    }
+
+    DBFManager table;
+    REQUIRE(table.Open("c.dbf"));
+    CHECK((Ids(table) == std::vector<std::string>{ "R1", "R2", "R3", "R4", "R6", "R7", "R8", "R9" }));
+    REQUIRE(table.AddRecord({ "R10" }));
+    CHECK(Ids(table).back() == "R10");
+}
+
+// The row cache (built by BuildIndices) follows every later write, including
+// slots that were already deleted when it was built
+TEST(RowCacheFollowsFillsAndAppends) {
+    DBFManager table;
+    CreateWithHoles(table, { "R3" });
+    table.BuildIndices();
+    REQUIRE(table.GetRowCache().RowCount() == 9);
+
+    table.ReuseDeletedSlots(true);
+    REQUIRE(table.AddRecords({ { "F" }, { "A" } })); // F refills R3's slot, A is appended
+    const DBFRowCache& cache = table.GetRowCache();
+    CHECK(cache.RowCount() == 11);
+
+    size_t row;
+    REQUIRE(cache.FindRow(table.PositionOfRecno(4), row));
+    CHECK(cache.Text(row, 0) == "F");
+    REQUIRE(cache.FindRow(table.PositionOfRecno(11), row));
+    CHECK(cache.Text(row, 0) == "A");
+}
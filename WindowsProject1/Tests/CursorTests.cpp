@@ -0,0 +1,111 @@
+#include "TestSupport.h"
+#include "DBFCursor.h"
+#include "DBFSnapshot.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    // c.dbf with IDs R000..R099, then the rows at deleted (0-based) deleted
+    void CreateRows(DBFManager& table, const std::vector<unsigned>& deleted) {
+        REQUIRE(Tests::CreateTable("c.dbf", { Tests::Field("ID", 'C', 6), Tests::Field("QTY", 'N', 4) }, table));
+        std::vector<std::vector<std::string>> rows;
+        for (unsigned i = 0; i < 100; ++i) {
+            char id[8];
+            snprintf(id, sizeof(id), "R%03u", i);
+            rows.push_back({ id, std::to_string(i) });
+        }
+        REQUIRE(table.AddRecords(rows));
+        for (unsigned i : deleted) REQUIRE(table.DeleteByFieldKey("ID", rows[i][0]));
+    }
+
+    std::vector<unsigned> Recnos(DBFCursor& cursor) {
+        std::vector<unsigned> out;
+        for (const DBFRecordView& row : cursor) {
+            (void)row;
+            out.push_back(cursor.Recno());
+        }
+        return out;
+    }
+}
+
+// The 25909 rows of KPJU.DBF in blocks of 1000, the last one short
+TEST(CursorWalksTheShippedTable) {
+    REQUIRE(Tests::CopySampleFiles({ "KPJU.DBF" }));
+    DBFManager table;
+    REQUIRE(table.Open("KPJU.DBF"));
+    std::vector<std::vector<std::string>> rows;
+    REQUIRE(table.GetAllRecords(rows));
+    REQUIRE(rows.size() == 25909);
+
+    DBFCursor cursor(table, 1000);
+    size_t seen = 0;
+    for (const DBFRecordView& row : cursor) {
+        REQUIRE(seen < rows.size());
+        CHECK(cursor.Recno() == seen + 1);
+        CHECK(cursor.Position() == table.PositionOfRecno(cursor.Recno()));
+        for (size_t f = 0; f < row.fieldCount(); ++f) CHECK(row.field(f) == rows[seen][f]);
+        seen++;
+    }
+    CHECK(!cursor.Failed());
+    CHECK(seen == rows.size());
+}
+
+// A batch of 7 puts whole blocks, block edges and both ends among the
+// deleted rows
+TEST(CursorSkipsDeletedRowsAndSeeks) {
+    DBFManager table;
+    std::vector<unsigned> deleted = { 0, 6, 7, 8, 9, 10, 11, 12, 13, 14, 99 };
+    CreateRows(table, deleted);
+
+    std::vector<unsigned> expected;
+    for (unsigned i = 0; i < 100; ++i) {
+        if (std::find(deleted.begin(), deleted.end(), i) == deleted.end()) expected.push_back(i + 1);
+    }
+    DBFCursor cursor(table, 7);
+    CHECK(Recnos(cursor) == expected);
+    CHECK(!cursor.Next());
+
+    // Seek takes a 0-based index; a deleted row there is passed over
+    cursor.Seek(6);
+    REQUIRE(cursor.Next());
+    CHECK(cursor.Recno() == 16);
+    CHECK(cursor.Current().field(cursor.FieldNumber("ID")) == "R015");
+
+    // Leaving the loop early and coming back goes on from the same row
+    cursor.Rewind();
+    for (const DBFRecordView& row : cursor) {
+        if (row.field(0) == "R003") break;
+    }
+    REQUIRE(cursor.Next());
+    CHECK(cursor.Current().field(0) == "R004");
+    CHECK(cursor.FieldNumber("qty") == 1);
+    CHECK(cursor.FieldNumber("NONE") == 2);
+}
+
+// Over a snapshot the cursor sees the rows as they were when it was taken
+TEST(CursorOverASnapshotIgnoresLaterWrites) {
+    DBFManager table;
+    CreateRows(table, {});
+    std::shared_ptr<DBFSnapshot> snapshot = table.OpenSnapshot();
+    REQUIRE(snapshot);
+
+    REQUIRE(table.DeleteByFieldKey("ID", "R050"));
+    REQUIRE(table.UpdateByFieldKey("ID", "R001", { { "QTY", "   7" } }));
+    REQUIRE(table.AddRecord({ "R100", "100" }));
+
+    DBFCursor cursor(*snapshot);
+    std::vector<unsigned> recnos;
+    for (const DBFRecordView& row : cursor) {
+        if (cursor.Recno() == 2) CHECK(row.field(1) == "1");
+        recnos.push_back(cursor.Recno());
+    }
+    CHECK(!cursor.Failed());
+    REQUIRE(recnos.size() == 100);
+    CHECK(recnos.back() == 100);
+
+    DBFCursor live(table);
+    CHECK(Recnos(live).size() == 100);
+}
@@ -0,0 +1,86 @@
+#include "TestSupport.h"
+#include "DBFScan.h"
+#include "DBFValue.h"
+#include <memory>
+#include <string>
+
+namespace {
+    // f.dbf: four sales rows keyed by KBRG
+    void CreateSales(DBFManager& table) {
+        REQUIRE(Tests::CreateTable("f.dbf", { Tests::Field("KBRG", 'C', 6), Tests::Field("TJUAL", 'D', 8),
+            Tests::Field("QTY", 'N', 10, 2), Tests::Field("NOTE", 'C', 20) }, table));
+        REQUIRE(table.AddRecords({
+            { "AG01", "20100801", "      5.00", "red apple" },
+            { "AG02", "20100715", "     12.50", "green" },
+            { "BX01", "20100901", "     -3.00", "RED box" },
+            { "AG03", "20100802", "    100.00", "" } }));
+    }
+
+    // KBRG of every row the compiled condition selects, in file order
+    std::string Matching(DBFManager& table, const std::shared_ptr<const ForExpression>& condition) {
+        DBFScanner scanner(table);
+        std::vector<long> positions;
+        if (!scanner.For(condition) || !scanner.Scan(positions)) return "<failed>";
+
+        std::string out;
+        std::vector<std::vector<std::string>> rows;
+        table.GetAllRecords(rows, 1);
+        for (long pos : positions) {
+            unsigned recno = table.RecnoOfPosition(pos);
+            out += (out.empty() ? "" : " ") + rows[recno - 1][0];
+        }
+        return out;
+    }
+
+    std::string Matching(DBFManager& table, const std::string& condition) {
+        auto expression = std::make_shared<ForExpression>();
+        if (!expression->Compile(condition, table.GetFields())) return "<not compiled>";
+        return Matching(table, expression);
+    }
+}
+
+TEST(ForConditionsSelectTheRightRows) {
+    DBFManager table;
+    CreateSales(table);
+
+    // Text compares as under SET EXACT OFF
+    CHECK(Matching(table, "kbrg='AG'.and.tjual>={^2010-08-01}") == "AG01 AG03");
+    CHECK(Matching(table, "qty>10.or.qty<0") == "AG02 BX01 AG03");
+    CHECK(Matching(table, "'red'$lower(note)") == "AG01 BX01");
+    CHECK(Matching(table, "empty(note)") == "AG03");
+    CHECK(Matching(table, "between(tjual, {08/01/2010}, {08/31/10})") == "AG01 AG03");
+    CHECK(Matching(table, "year(tjual)=2010.and.month(tjual)=9") == "BX01");
+    CHECK(Matching(table, ".not.left(kbrg,2)=='AG'") == "BX01");
+    CHECK(Matching(table, "tjual+31>{^2010-09-01}") == "BX01 AG03");
+}
+
+TEST(ForConditionsTakeMemoryVariables) {
+    DBFManager table;
+    CreateSales(table);
+
+    auto expression = std::make_shared<ForExpression>();
+    expression->SetNumber("limit", 12);
+    expression->SetText("prefix", "AG");
+    REQUIRE(expression->Compile("qty>=m.limit.and.kbrg=prefix", table.GetFields()));
+    CHECK(Matching(table, expression) == "AG02 AG03");
+}
+
+TEST(ForConditionsRejectBadSource) {
+    DBFManager table;
+    CreateSales(table);
+
+    ForExpression expression;
+    CHECK(!expression.Compile("kbrg=", table.GetFields()));
+    CHECK(!expression.Compile("nosuch=1", table.GetFields()));
+    CHECK(!expression.Compile("qty='text'", table.GetFields()));
+    CHECK(!expression.isCompiled());
+}
+
+// More digits than an int64_t holds go to strtod instead of overflowing
+TEST(LongNumbersParseWithoutOverflow) {
+    const char digits[] = "   12345678901234567890.5";
+    CHECK(ParseDBFNumber(digits, sizeof(digits) - 1) == 12345678901234567890.5);
+    const char money[] = "  -1234567.25";
+    CHECK(ParseDBFNumber(money, sizeof(money) - 1) == -1234567.25);
+    CHECK(ParseDBFNumber("          ", 10) == 0);
+}
@@ -0,0 +1,48 @@
+#include "TestSupport.h"
+#include "IDXReader.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+// BROK2.IDX is FoxPro's kbrg+DTOC(thilang,1) over the 583 rows of BROK.DBF:
+// every row is found again under the key built from its own bytes
+TEST(ShippedIndexFindsEveryRowOfItsTable) {
+    REQUIRE(Tests::CopySampleFiles({ "BROK.DBF", "BROK2.IDX" }));
+    DBFManager table;
+    REQUIRE(table.Open("BROK.DBF"));
+    REQUIRE(table.RecordCount() == 583);
+    IDXReader index;
+    REQUIRE(index.Open("BROK2.IDX"));
+    CHECK(index.GetKeyExpression() == "kbrg+DTOC(thilang,1)");
+    CHECK(index.GetKeyLength() == 17);
+    CHECK(!index.isUnique());
+
+    const FIELD_DESCRIPTOR& date = table.GetFields()[0];
+    const FIELD_DESCRIPTOR& kbrg = table.GetFields()[1];
+    std::map<std::string, std::vector<unsigned>> byItem;
+    std::vector<char> scratch;
+    for (unsigned recno = 1; recno <= table.RecordCount(); ++recno) {
+        const char* record = table.ReadRecordBlock(recno - 1, 1, scratch);
+        REQUIRE(record);
+        std::string item(record + kbrg.address, kbrg.length);
+        std::string key = item + std::string(record + date.address, date.length);
+
+        std::vector<unsigned> recnos;
+        REQUIRE(index.SeekAll(key, recnos));
+        CHECK(std::find(recnos.begin(), recnos.end(), recno) != recnos.end());
+        byItem[item].push_back(recno);
+    }
+
+    // A prefix run holds exactly the rows of that item
+    std::vector<unsigned> recnos;
+    for (const auto& item : byItem) {
+        REQUIRE(index.SeekPrefix(item.first, recnos));
+        std::sort(recnos.begin(), recnos.end());
+        CHECK(recnos == item.second);
+    }
+
+    unsigned recno;
+    CHECK(!index.Seek("NOSUCHKEY", recno));
+    CHECK(!index.SeekPrefix("~", recnos));
+}
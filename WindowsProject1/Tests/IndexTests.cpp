@@ -0,0 +1,159 @@
+#include "TestSupport.h"
+#include "DBFManager.h"
+#include "DBFTableManager.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    bool ReadHeader(const std::string& path, DBF_HEADER& out) {
+        std::ifstream file(path, std::ios::binary);
+        file.read(reinterpret_cast<char*>(&out), sizeof(out));
+        return (bool)file;
+    }
+
+    // Table t.dbf with rows A, B, C and a persistent index on ID
+    void CreateIndexedTable(DBFManager& table) {
+        REQUIRE(Tests::CreateTable("t.dbf", { Tests::Field("ID", 'C', 10), Tests::Field("QTY", 'N', 8) }, table));
+        REQUIRE(table.AddPersistentIndex("ID"));
+        REQUIRE(table.AddRecords({ { "A", "1" }, { "B", "2" }, { "C", "3" } }));
+    }
+}
+
+TEST(EveryWriteStampsTheHeader) {
+    DBFManager table;
+    CreateIndexedTable(table);
+
+    SYSTEMTIME today;
+    GetLocalTime(&today);
+    DBF_HEADER header;
+    REQUIRE(ReadHeader("t.dbf", header));
+    CHECK(header.last_update[0] == today.wYear - 1900);
+    CHECK(header.last_update[1] == today.wMonth);
+    CHECK(header.last_update[2] == today.wDay);
+
+    unsigned before = table.ChangeCount();
+    REQUIRE(table.UpdateByFieldKey("ID", "B", { { "QTY", "5" } }));
+    CHECK(table.ChangeCount() > before);
+    before = table.ChangeCount();
+    REQUIRE(table.DeleteByFieldKey("ID", "C"));
+    CHECK(table.ChangeCount() > before);
+
+    REQUIRE(ReadHeader("t.dbf", header));
+    CHECK(header.change_count == table.ChangeCount());
+}
+
+// The tree keeps a delete whose table write never reached the disk: the
+// record count and date still match, only the change count tells them apart
+TEST(TreeAheadOfItsTableIsRebuilt) {
+    {
+        DBFManager table;
+        CreateIndexedTable(table);
+        REQUIRE(Tests::SaveFiles({ "t.dbf" }, "before"));
+        REQUIRE(table.DeleteByFieldKey("ID", "A"));
+    }
+    REQUIRE(Tests::RestoreFiles({ "t.dbf" }, "before"));
+
+    DBFManager table;
+    REQUIRE(table.Open("t.dbf"));
+    REQUIRE(table.AddPersistentIndex("ID"));
+    std::vector<long> positions;
+    REQUIRE(table.FindByPersistentIndex("ID", "A", positions));
+    CHECK(positions.size() == 1);
+}
+
+// Same for an update that moved a key in the tree
+TEST(TreeAheadOfAnUpdateIsRebuilt) {
+    {
+        DBFManager table;
+        CreateIndexedTable(table);
+        REQUIRE(Tests::SaveFiles({ "t.dbf" }, "before"));
+        REQUIRE(table.UpdateByFieldKey("ID", "B", { { "ID", "Z" } }));
+    }
+    REQUIRE(Tests::RestoreFiles({ "t.dbf" }, "before"));
+
+    DBFManager table;
+    REQUIRE(table.Open("t.dbf"));
+    REQUIRE(table.AddPersistentIndex("ID"));
+    std::vector<long> positions;
+    REQUIRE(table.FindByPersistentIndex("ID", "B", positions));
+    CHECK(positions.size() == 1);
+    CHECK(!table.FindByPersistentIndex("ID", "Z", positions));
+}
+
+// A rolled-back append must not leave the tree stamped with the header the
+// journal wrote: an append without the tree would bring that stamp back
+TEST(RolledBackAppendLeavesTheTreeStale) {
+    {
+        DBFManager table;
+        CreateIndexedTable(table);
+        REQUIRE(table.BeginJournal());
+        REQUIRE(table.AddRecords({ { "X", "4" } }));
+        REQUIRE(table.RollbackJournal());
+    }
+    {
+        DBFManager table;
+        REQUIRE(table.Open("t.dbf"));
+        REQUIRE(table.AddRecords({ { "Y", "5" } }));
+    }
+
+    DBFManager table;
+    REQUIRE(table.Open("t.dbf"));
+    REQUIRE(table.AddPersistentIndex("ID"));
+    std::vector<long> positions;
+    CHECK(!table.FindByPersistentIndex("ID", "X", positions));
+    CHECK(table.FindByPersistentIndex("ID", "Y", positions));
+    CHECK(positions.size() == 1);
+}
+
+TEST(ReversedNumericRangeFindsNothing) {
+    DBFManager table;
+    CreateIndexedTable(table);
+
+    std::vector<long> positions;
+    CHECK(table.FindRange("QTY", "1", "2", positions));
+    CHECK(positions.size() == 2);
+    CHECK(!table.FindRange("QTY", "2", "1", positions));
+    CHECK(positions.empty());
+}
+
+TEST(DeleteFileForgetsTheTable) {
+    DBFManager table;
+    CreateIndexedTable(table);
+    REQUIRE(table.AddExpressionIndex("KEY", "ID"));
+    std::vector<long> positions;
+    REQUIRE(table.FindByPersistentIndex("ID", "A", positions));
+
+    REQUIRE(table.DeleteFile());
+    CHECK(!Tests::FileExists("t.dbf"));
+    CHECK(!Tests::FileExists("t.dbf.ID.bpt"));
+    CHECK(!table.HasPersistentIndex("ID"));
+    CHECK(!table.HasExpressionIndex("KEY"));
+    CHECK(table.FreeSlotCount() == 0);
+}
+
+TEST(KeyRangeTellsAnUnreadableIndexFromNoMatch) {
+    {
+        DBFManager table;
+        CreateIndexedTable(table);
+    }
+
+    std::vector<long> positions;
+    {
+        DBFTableManager table("t.dbf");
+        REQUIRE(table.AddExpressionIndex("KEY", "ID"));
+        CHECK(table.FindKeyRange("KEY", "X", "Z", positions));
+        CHECK(positions.empty());
+        CHECK(table.FindKeyRange("KEY", "C", "A", positions));
+        CHECK(positions.empty());
+        CHECK(!table.FindKeyRange("NONE", "A", "C", positions));
+    }
+
+    // The header still counts three rows the file no longer holds
+    DBF_HEADER header;
+    REQUIRE(ReadHeader("t.dbf", header));
+    std::filesystem::resize_file("t.dbf", header.header_size);
+    DBFTableManager truncated("t.dbf");
+    REQUIRE(truncated.AddExpressionIndex("KEY", "ID"));
+    CHECK(!truncated.FindKeyRange("KEY", "A", "C", positions));
+}
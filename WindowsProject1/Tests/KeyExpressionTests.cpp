@@ -0,0 +1,79 @@
+#include "TestSupport.h"
+#include "IDXReader.h"
+#include "KeyExpression.h"
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    // The key of the first row of table under expression
+    std::string FirstKey(DBFManager& table, const std::string& expression) {
+        KeyExpression key;
+        if (!key.Compile(expression, table.GetFields())) return "(not compiled)";
+        std::vector<char> scratch;
+        const char* record = table.ReadRecordBlock(0, 1, scratch);
+        if (!record) return "(not read)";
+        std::string out;
+        key.Extract(record, out);
+        return out;
+    }
+}
+
+// Each expression is compiled from the shipped .IDX header against its
+// table, and every row's key is where FoxPro put that row. (cus3 and cus4
+// were not open when cus.DBF got its last row, so they are left out.)
+TEST(ShippedIndexKeysAreBuiltFromTheirRows) {
+    const std::vector<std::pair<std::string, std::vector<std::string>>> tables = {
+        { "BROK.DBF", { "BROK1.IDX", "BROK2.IDX" } },
+        { "cus.DBF", { "cus1.IDX", "cus2.IDX" } },
+    };
+    for (const auto& files : tables) {
+        std::vector<std::string> copies = files.second;
+        copies.push_back(files.first);
+        REQUIRE(Tests::CopySampleFiles(copies));
+        DBFManager table;
+        REQUIRE(table.Open(files.first));
+        REQUIRE(table.RecordCount() > 0);
+
+        for (const std::string& file : files.second) {
+            IDXReader index;
+            REQUIRE(index.Open(file));
+            KeyExpression key;
+            REQUIRE(key.Compile(index.GetKeyExpression(), table.GetFields()));
+            CHECK(key.GetKeyLength() == index.GetKeyLength());
+
+            std::vector<char> scratch;
+            std::string bytes;
+            std::vector<unsigned> recnos;
+            for (unsigned recno = 1; recno <= table.RecordCount(); ++recno) {
+                const char* record = table.ReadRecordBlock(recno - 1, 1, scratch);
+                REQUIRE(record);
+                key.Extract(record, bytes);
+                REQUIRE(index.SeekAll(bytes, recnos));
+                CHECK(std::find(recnos.begin(), recnos.end(), recno) != recnos.end());
+            }
+        }
+    }
+}
+
+TEST(KeyFunctionsReadTheRecordBytes) {
+    DBFManager table;
+    REQUIRE(Tests::CreateTable("k.dbf", { Tests::Field("CODE", 'C', 6), Tests::Field("NAME", 'C', 10),
+        Tests::Field("DATE", 'D', 8), Tests::Field("AMT", 'N', 8, 2) }, table));
+    REQUIRE(table.AddRecord({ "ab1234", "mixed Case", "20240315", "   12.50" }));
+
+    CHECK(FirstKey(table, "UPPER(name)") == "MIXED CASE");
+    CHECK(FirstKey(table, "LEFT(code,2)+SUBSTR(code,3,2)+RIGHT(code,2)") == "ab1234");
+    CHECK(FirstKey(table, "k->code+'.'") == "ab1234.");
+    CHECK(FirstKey(table, "DTOC(date)") == "03/15/24");
+    CHECK(FirstKey(table, "DTOS(date)+STR(amt,10,1)") == "20240315      12.5");
+    CHECK(FirstKey(table, "STR(amt,1)") == "*");
+    CHECK(FirstKey(table, "amt") == IDXReader::EncodeNumericKey(12.5));
+
+    KeyExpression key;
+    CHECK(!key.Compile("nosuch", table.GetFields()));
+    CHECK(!key.Compile("STR(name)", table.GetFields()));
+    CHECK(!key.Compile("LEFT(code)", table.GetFields()));
+    CHECK(!key.Compile("code+", table.GetFields()));
+}
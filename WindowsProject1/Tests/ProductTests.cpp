@@ -0,0 +1,199 @@
+#include "TestSupport.h"
+#include "ProductDBManager.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+    const int DAYS = 28;
+
+    std::string Date(int day) {
+        char date[9];
+        snprintf(date, sizeof(date), "202401%02d", day);
+        return date;
+    }
+
+    void AddProducts(Product& products, int count) {
+        for (int p = 0; p < count; ++p) {
+            REQUIRE(products.AddProduct({ "P" + std::to_string(p), "Product", 1, 2, 0, "S1" }));
+        }
+    }
+
+    // Day d buys 10 at d + p and sells 4, so no sale outruns the layers.
+    // References are B<d> and S<d>.
+    void RecordDays(Product& products, int p) {
+        std::string id = "P" + std::to_string(p);
+        for (int day = 1; day <= DAYS; ++day) {
+            CHECK(products.RecordPurchase(id, Date(day), 10, day + p, "B" + std::to_string(day)));
+            CHECK(products.RecordSale(id, Date(day), 4, "S" + std::to_string(day)));
+        }
+    }
+
+    // What RecordDays(products, p) buys at
+    std::vector<double> Costs(int p) {
+        std::vector<double> costs;
+        for (int day = 1; day <= DAYS; ++day) costs.push_back(day + p);
+        return costs;
+    }
+
+    // The same FIFO worked out by hand, with sales up to saleDays only
+    double ExpectedCOGS(const std::vector<double>& costs, int saleDays = DAYS) {
+        std::deque<std::pair<int, double>> layers;
+        double cogs = 0;
+        for (int day = 1; day <= saleDays; ++day) {
+            layers.push_back({ 10, costs[day - 1] });
+            int left = 4;
+            while (left > 0) {
+                int taken = std::min(left, layers.front().first);
+                cogs += taken * layers.front().second;
+                left -= taken;
+                if ((layers.front().first -= taken) == 0) layers.pop_front();
+            }
+        }
+        return cogs;
+    }
+}
+
+TEST(ConcurrentMovementsKeepTheCostLayersExact) {
+    const int PRODUCTS = 8;
+    {
+        Product products;
+        AddProducts(products, PRODUCTS);
+
+        std::vector<std::thread> threads;
+        for (int p = 0; p < PRODUCTS; ++p) threads.emplace_back([&, p] { RecordDays(products, p); });
+        for (auto& thread : threads) thread.join();
+
+        for (int p = 0; p < PRODUCTS; ++p) {
+            CHECK(products.CalculateCOGS_FIFO("P" + std::to_string(p), Date(1), Date(DAYS)) == ExpectedCOGS(Costs(p)));
+        }
+    }
+
+    // The checkpoint written on the way out holds the same state
+    Product reopened;
+    for (int p = 0; p < PRODUCTS; ++p) {
+        CHECK(reopened.CalculateCOGS_FIFO("P" + std::to_string(p), Date(1), Date(DAYS)) == ExpectedCOGS(Costs(p)));
+    }
+}
+
+// Every movement is dated before the ones already applied, so each COGS
+// replays P0 while the other thread goes on recording
+TEST(ReplayDuringConcurrentMovementsCountsEachOnce) {
+    Product products;
+    AddProducts(products, 1);
+
+    std::atomic<bool> done(false);
+    std::thread recorder([&] {
+        for (int day = DAYS; day >= 1; --day) {
+            CHECK(products.RecordPurchase("P0", Date(day), 10, day));
+            CHECK(products.RecordSale("P0", Date(day), 4));
+        }
+        done = true;
+    });
+    while (!done) products.CalculateCOGS_FIFO("P0", Date(1), Date(DAYS));
+    recorder.join();
+
+    CHECK(products.CalculateCOGS_FIFO("P0", Date(1), Date(DAYS)) == ExpectedCOGS(Costs(0)));
+}
+
+// Average COGS reads a snapshot, so it never walks the movements while the
+// recording thread's transaction is changing them
+TEST(AverageCOGSDuringConcurrentMovements) {
+    Product products;
+    AddProducts(products, 1);
+
+    REQUIRE(products.RecordPurchase("P0", Date(1), 10, 1, "FIRST"));
+
+    std::atomic<bool> done(false);
+    std::thread recorder([&] {
+        RecordDays(products, 0);
+        done = true;
+    });
+    while (!done) CHECK(products.CalculateCOGS_Average("P0", Date(1), Date(DAYS)) >= 0);
+    recorder.join();
+
+    // The extra 10 units at 1 come on top of RecordDays' purchases
+    double purchased = 10;
+    for (double cost : Costs(0)) purchased += 10 * cost;
+    double average = purchased / (10 * (DAYS + 1));
+    CHECK(std::fabs(products.CalculateCOGS_Average("P0", Date(1), Date(DAYS)) - 4 * DAYS * average) < 1e-9);
+}
+
+// RecordMovement appends through the coordinator too, so it can run next
+// to purchases and sales that lead batches on the same table
+TEST(RecordMovementAlongsidePurchasesAndSales) {
+    Product products;
+    AddProducts(products, 2);
+
+    std::thread recorder([&] { RecordDays(products, 0); });
+    for (int day = 1; day <= DAYS; ++day) {
+        CHECK(products.RecordMovement({ Date(day), "P1", 10, (double)day, "PURCHASE", "M" + std::to_string(day) }));
+        CHECK(products.RecordMovement({ Date(day), "P1", -4, 0, "SALE", "M" + std::to_string(day) }));
+    }
+    recorder.join();
+
+    CHECK(products.CalculateCOGS_FIFO("P0", Date(1), Date(DAYS)) == ExpectedCOGS(Costs(0)));
+    CHECK(products.CalculateCOGS_FIFO("P1", Date(1), Date(DAYS)) == ExpectedCOGS(Costs(0)));
+}
+
+TEST(EditedMovementsRebuildTheCostLayers) {
+    std::vector<double> costs = Costs(0);
+    {
+        Product products;
+        AddProducts(products, 1);
+        RecordDays(products, 0);
+        CHECK(products.CalculateCOGS_FIFO("P0", Date(1), Date(DAYS)) == ExpectedCOGS(costs));
+    }
+
+    // Neither edit changes the record count, so only the table's stamp
+    // tells the checkpoint is out of date
+    {
+        DBFManager movements;
+        REQUIRE(movements.Open("inventory_movements.dbf"));
+        REQUIRE(movements.DeleteByFieldKey("REFERENCE", "S" + std::to_string(DAYS)));
+    }
+    {
+        Product products;
+        CHECK(products.CalculateCOGS_FIFO("P0", Date(1), Date(DAYS)) == ExpectedCOGS(costs, DAYS - 1));
+    }
+
+    {
+        DBFTableManager movements("inventory_movements.dbf");
+        for (const auto& field : DBFRecordLayout<Product::InventoryMovement>::Descriptors())
+            movements.AddFieldDescriptor(field);
+        REQUIRE(movements.UpdateRecord("REFERENCE", "B1", { { "UNITCOST", "100" } }));
+    }
+    costs[0] = 100;
+    Product products;
+    CHECK(products.CalculateCOGS_FIFO("P0", Date(1), Date(DAYS)) == ExpectedCOGS(costs, DAYS - 1));
+}
+
+TEST(BatchCOGSMatchesThePerProductCalculations) {
+    const int PRODUCTS = 3;
+    Product products;
+    AddProducts(products, PRODUCTS);
+    for (int p = 0; p < PRODUCTS; ++p) RecordDays(products, p);
+    // Dated before movements already applied, so P1 is replayed
+    REQUIRE(products.RecordPurchase("P1", Date(2), 5, 7, "LATE"));
+
+    for (unsigned threads : { 1u, 4u }) {
+        std::vector<Product::COGSResult> batch;
+        REQUIRE(products.CalculateCOGS_Batch(Date(5), Date(15), batch, {}, threads));
+        REQUIRE(batch.size() == PRODUCTS);
+        for (const auto& result : batch) {
+            CHECK(std::fabs(result.fifo - products.CalculateCOGS_FIFO(result.productId, Date(5), Date(15))) < 1e-9);
+            CHECK(std::fabs(result.average - products.CalculateCOGS_Average(result.productId, Date(5), Date(15))) < 1e-9);
+        }
+    }
+
+    std::vector<Product::COGSResult> one;
+    REQUIRE(products.CalculateCOGS_Batch(Date(1), Date(DAYS), one, { "P2", "NONE" }));
+    REQUIRE(one.size() == 2);
+    CHECK(one[0].productId == "NONE" && one[0].fifo == 0 && one[0].average == 0);
+    CHECK(one[1].fifo == ExpectedCOGS(Costs(2)));
+}
@@ -0,0 +1,99 @@
+#include "TestSupport.h"
+#include "DBFQueryPlanner.h"
+#include <filesystem>
+#include <string>
+
+namespace {
+    // q.dbf: 2000 rows, ID unique, GRP one of 20 groups, QTY 0..99
+    void CreateRows(DBFManager& table) {
+        REQUIRE(Tests::CreateTable("q.dbf", { Tests::Field("ID", 'C', 8), Tests::Field("GRP", 'C', 4),
+            Tests::Field("QTY", 'N', 8) }, table));
+        std::vector<std::vector<std::string>> rows;
+        for (int i = 0; i < 2000; ++i)
+            rows.push_back({ "ID" + std::to_string(i), "G" + std::to_string(i % 20), std::to_string(i % 100) });
+        REQUIRE(table.AddRecords(rows));
+    }
+
+    // Same conditions answered by reading every row
+    std::vector<long> ByScan(DBFManager& table, const std::string& group, int low, int high) {
+        std::vector<long> out;
+        std::vector<char> scratch;
+        for (unsigned i = 0; i < table.RecordCount(); ++i) {
+            const char* record = table.ReadRecordBlock(i, 1, scratch);
+            if (record[0] == '*') continue;
+            std::string grp(record + table.GetFields()[1].address, 4);
+            grp.erase(grp.find_last_not_of(' ') + 1);
+            int qty = atoi(std::string(record + table.GetFields()[2].address, 8).c_str());
+            if ((group.empty() || grp == group) && qty >= low && qty <= high) out.push_back(table.PositionOfRecno(i + 1));
+        }
+        return out;
+    }
+}
+
+TEST(PlannerRefusesReversedRanges) {
+    DBFManager table;
+    CreateRows(table);
+    DBFQueryPlanner planner(table);
+
+    CHECK(!planner.Between("QTY", "50", "10"));
+    CHECK(!planner.Between("GRP", "G9", "G1"));
+    CHECK(planner.Between("QTY", "10", "10"));
+}
+
+TEST(IndexPlanMatchesAFullScan) {
+    DBFManager table;
+    CreateRows(table);
+    REQUIRE(table.AddPersistentIndex("QTY"));
+    REQUIRE(table.DeleteByFieldKey("ID", "ID7"));
+
+    DBFQueryPlanner planner(table);
+    REQUIRE(planner.Between("QTY", "5", "7"));
+    DBFQueryPlanner::Plan plan;
+    REQUIRE(planner.Choose(plan));
+    REQUIRE(plan.candidates[plan.chosen].path == DBFQueryPlanner::PATH_INDEX);
+
+    std::vector<long> positions;
+    REQUIRE(planner.Execute(positions));
+    CHECK(positions == ByScan(table, "", 5, 7));
+    CHECK(positions.size() == 59);
+
+    // A second condition is tested on the rows the index returns
+    REQUIRE(planner.Equals("GRP", "G5"));
+    REQUIRE(planner.Execute(positions));
+    CHECK(positions == ByScan(table, "G5", 5, 7));
+}
+
+TEST(ScanPlanForUnselectiveConditions) {
+    DBFManager table;
+    CreateRows(table);
+
+    DBFQueryPlanner planner(table);
+    REQUIRE(planner.Between("QTY", "0", "90"));
+    DBFQueryPlanner::Plan plan;
+    REQUIRE(planner.Choose(plan));
+    CHECK(plan.candidates[plan.chosen].path == DBFQueryPlanner::PATH_FULL_SCAN);
+
+    std::vector<long> positions;
+    REQUIRE(planner.Execute(positions));
+    CHECK(positions == ByScan(table, "", 0, 90));
+}
+
+// A directory where the tree file belongs: the index plan is chosen but the
+// tree can be neither opened nor built, so the rows come from a scan
+TEST(UnreadableIndexFallsBackToAScan) {
+    DBFManager table;
+    CreateRows(table);
+    REQUIRE(std::filesystem::create_directory("q.dbf.QTY.bpt"));
+    REQUIRE(table.AddPersistentIndex("QTY"));
+
+    DBFQueryPlanner planner(table);
+    REQUIRE(planner.Between("QTY", "5", "7"));
+    DBFQueryPlanner::Plan plan;
+    REQUIRE(planner.Choose(plan));
+    REQUIRE(plan.candidates[plan.chosen].path == DBFQueryPlanner::PATH_INDEX);
+
+    std::vector<long> positions;
+    REQUIRE(planner.Execute(positions));
+    CHECK(positions == ByScan(table, "", 5, 7));
+    CHECK(positions.size() == 60);
+}
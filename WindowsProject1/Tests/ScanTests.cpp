@@ -0,0 +1,75 @@
+#include "TestSupport.h"
+#include "DBFColumnSnapshot.h"
+#include "DBFScan.h"
+#include <string>
+
+namespace {
+    // p.dbf with ITEM and QTY rows I0..I9 holding 0..9
+    void CreateRows(DBFManager& table) {
+        REQUIRE(Tests::CreateTable("p.dbf", { Tests::Field("ITEM", 'C', 10), Tests::Field("QTY", 'N', 8) }, table));
+        std::vector<std::vector<std::string>> rows;
+        for (int i = 0; i < 10; ++i) rows.push_back({ "I" + std::to_string(i), std::to_string(i) });
+        REQUIRE(table.AddRecords(rows));
+    }
+}
+
+// Parallel paths read snapshots of the last commit; inside a transaction
+// they must see its writes just as the serial ones do
+TEST(ParallelReadsSeeTheOpenTransaction) {
+    DBFManager table;
+    CreateRows(table);
+    REQUIRE(table.BeginJournal());
+    REQUIRE(table.UpdateByFieldKey("ITEM", "I0", { { "QTY", "50" } }));
+    REQUIRE(table.DeleteByFieldKey("ITEM", "I1"));
+    REQUIRE(table.AddRecord({ "I10", "60" }));
+
+    std::vector<std::vector<std::string>> serial, parallel;
+    REQUIRE(table.GetAllRecords(serial, 1));
+    REQUIRE(table.GetAllRecords(parallel, 4));
+    CHECK(serial.size() == 10);
+    CHECK(parallel == serial);
+
+    DBFScanner scanner(table);
+    REQUIRE(scanner.NotDeleted());
+    REQUIRE(scanner.For("QTY>=50"));
+    std::vector<long> expected, found;
+    REQUIRE(scanner.Scan(expected));
+    REQUIRE(scanner.ScanParallel(found, 4));
+    CHECK(expected.size() == 2);
+    CHECK(found == expected);
+
+    DBFColumnSnapshot columns;
+    REQUIRE(columns.Build(table, 4));
+    CHECK(columns.RowCount() == 10);
+
+    REQUIRE(table.RollbackJournal());
+    REQUIRE(table.GetAllRecords(parallel, 4));
+    CHECK(parallel.size() == 10);
+    CHECK(parallel[0][1] == "0");
+}
+
+// Numbers are right-justified, so their bytes don't sort by value
+TEST(BetweenComparesTextFieldsOnly) {
+    DBFManager table;
+    CreateRows(table);
+
+    DBFScanner scanner(table);
+    CHECK(!scanner.Between("QTY", "2", "4"));
+    REQUIRE(scanner.Between("ITEM", "I2", "I4"));
+    std::vector<long> found;
+    REQUIRE(scanner.Scan(found));
+    CHECK(found.size() == 3);
+    CHECK(found[0] == table.PositionOfRecno(3));
+}
+
+TEST(LocateStartsAtAZeroBasedIndex) {
+    DBFManager table;
+    CreateRows(table);
+
+    DBFScanner scanner(table);
+    REQUIRE(scanner.Equals("ITEM", "I3"));
+    long pos = 0;
+    REQUIRE(scanner.Locate(3, pos));
+    CHECK(pos == table.PositionOfRecno(4));
+    CHECK(!scanner.Locate(4, pos));
+}
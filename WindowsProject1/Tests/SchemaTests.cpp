@@ -0,0 +1,80 @@
+#include "TestSupport.h"
+#include "DBFTableManager.h"
+#include <map>
+#include <string>
+
+namespace {
+    struct Item {
+        std::string id;
+        double price;
+    };
+}
+
+template <>
+struct DBFSchema<Item> {
+    static constexpr auto fields = std::make_tuple(
+        MakeDBFField("ID", 'C', 10, 0, &Item::id),
+        MakeDBFField("PRICE", 'N', 6, 2, &Item::price));
+};
+
+namespace {
+    void OpenItems(DBFTableManager& table) {
+        for (const auto& desc : DBFRecordLayout<Item>::Descriptors()) table.AddFieldDescriptor(desc);
+        REQUIRE(table.CreateDB());
+    }
+}
+
+TEST(NumberTooWideForItsColumnIsStarredAndRefused) {
+    char record[DBFRecordLayout<Item>::RecordSize];
+    CHECK(DBFRecordLayout<Item>::Encode({ "A", 999.99 }, record));
+    CHECK(!DBFRecordLayout<Item>::Encode({ "A", 1000.5 }, record));
+    CHECK(std::string(record + DBFRecordLayout<Item>::Offset<1>(), 6) == "******");
+}
+
+TEST(TypedWritesFailOnOverflow) {
+    DBFTableManager table("items.dbf");
+    OpenItems(table);
+    REQUIRE(table.AddTypedRecord(Item{ "A", 12.5 }));
+
+    CHECK(!table.AddTypedRecord(Item{ "B", 123456.0 }));
+    CHECK(!table.AddTypedRecords(std::vector<Item>{ { "C", 1.0 }, { "D", -9999.0 } }));
+    CHECK(!table.UpdateTypedRecord("ID", "A", Item{ "A", 1e9 }));
+    CHECK(table.RecordCount() == 1);
+
+    Item stored;
+    REQUIRE(table.GetTypedRecord("ID", "A", stored));
+    CHECK(stored.price == 12.5);
+}
+
+// Rows given as field maps are encoded like the typed ones
+TEST(MapWritesAreRightJustifiedAndFailOnOverflow) {
+    DBFTableManager table("items.dbf");
+    OpenItems(table);
+    REQUIRE(table.AddRecord({ { "ID", "A" }, { "PRICE", "12.5" } }));
+    REQUIRE(table.AddRecords({ { { "ID", "B" }, { "PRICE", "3" } } }));
+
+    CHECK(!table.AddRecord({ { "ID", "C" }, { "PRICE", "123456" } }));
+    CHECK(!table.AddRecords({ { { "ID", "D" }, { "PRICE", "1" } }, { { "ID", "E" }, { "PRICE", "-9999" } } }));
+    CHECK(!table.UpdateRecord("ID", "A", { { "PRICE", "1e9" } }));
+    CHECK(table.RecordCount() == 2);
+
+    REQUIRE(table.UpdateRecord("ID", "B", { { "PRICE", "7.25" } }));
+    std::map<std::string, std::string> row;
+    REQUIRE(table.GetRecord("ID", "A", row));
+    CHECK(row["PRICE"] == " 12.50");
+    REQUIRE(table.GetRecord("ID", "B", row));
+    CHECK(row["PRICE"] == "  7.25");
+}
+
+// Wider than any fixed formatting buffer
+TEST(WideNumericColumnsKeepEveryDigit) {
+    DBFTableManager table("wide.dbf");
+    table.AddFieldDescriptor(Tests::Field("ID", 'C', 10));
+    table.AddFieldDescriptor(Tests::Field("TOTAL", 'N', 40, 2));
+    REQUIRE(table.CreateDB());
+    REQUIRE(table.AddRecord({ { "ID", "A" }, { "TOTAL", "1234567890123.5" } }));
+
+    std::map<std::string, std::string> row;
+    REQUIRE(table.GetRecord("ID", "A", row));
+    CHECK(row["TOTAL"] == std::string(24, ' ') + "1234567890123.50");
+}
@@ -0,0 +1,60 @@
+#include "TestSupport.h"
+#include "DBFSnapshot.h"
+#include <string>
+
+namespace {
+    // s.dbf with rows R0..R4
+    void CreateRows(DBFManager& table) {
+        REQUIRE(Tests::CreateTable("s.dbf", { Tests::Field("ID", 'C', 10) }, table));
+        REQUIRE(table.AddRecords({ { "R0" }, { "R1" }, { "R2" }, { "R3" }, { "R4" } }));
+    }
+
+    std::vector<std::string> Ids(DBFSnapshot& snapshot) {
+        std::vector<std::vector<std::string>> rows;
+        snapshot.GetAllRecords(rows);
+        std::vector<std::string> out;
+        for (auto& row : rows) out.push_back(row[0]);
+        return out;
+    }
+
+    const std::vector<std::string> ALL_ROWS = { "R0", "R1", "R2", "R3", "R4" };
+}
+
+TEST(SnapshotKeepsItsVersionWhileTheTableChanges) {
+    DBFManager table;
+    CreateRows(table);
+    auto snapshot = table.OpenSnapshot();
+    REQUIRE(snapshot);
+
+    REQUIRE(table.UpdateByFieldKey("ID", "R1", { { "ID", "X1" } }));
+    REQUIRE(table.DeleteByFieldKey("ID", "R2"));
+    REQUIRE(table.AddRecord({ "R5" }));
+
+    CHECK(Ids(*snapshot) == ALL_ROWS);
+    std::vector<std::string> row;
+    CHECK(snapshot->GetByFieldKey("ID", "R1", row));
+    CHECK(!snapshot->GetByFieldKey("ID", "X1", row));
+
+    // A new snapshot starts from the latest commit
+    auto latest = table.OpenSnapshot();
+    REQUIRE(latest);
+    CHECK((Ids(*latest) == std::vector<std::string>{ "R0", "X1", "R3", "R4", "R5" }));
+}
+
+// Compaction drops the deleted tail from the record count, but an older
+// snapshot still counts those slots; an append reusing them must not show
+TEST(AppendAfterCompactionKeepsSlotsAnOlderSnapshotReads) {
+    DBFManager table;
+    CreateRows(table);
+    REQUIRE(table.DeleteByFieldKey("ID", "R3"));
+    REQUIRE(table.DeleteByFieldKey("ID", "R4"));
+    auto snapshot = table.OpenSnapshot();
+    REQUIRE(snapshot);
+
+    bool done = false;
+    REQUIRE(table.CompactStep(10, done));
+    REQUIRE(table.RecordCount() == 3);
+    REQUIRE(table.AddRecords({ { "N1" }, { "N2" } }));
+
+    CHECK((Ids(*snapshot) == std::vector<std::string>{ "R0", "R1", "R2" }));
+}
@@ -0,0 +1,134 @@
+#include "TestSupport.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+    struct Entry {
+        const char* name;
+        Tests::TestFunction function;
+        bool benchmark;
+    };
+
+    std::vector<Entry>& Registry() {
+        static std::vector<Entry> entries;
+        return entries;
+    }
+
+    unsigned failures = 0;
+}
+
+Tests::Registrar::Registrar(const char* name, TestFunction function, bool benchmark) {
+    Registry().push_back({ name, function, benchmark });
+}
+
+void Tests::Fail(const char* file, int line, const std::string& what) {
+    failures++;
+    printf("    %s(%d): %s\n", file, line, what.c_str());
+}
+
+FIELD_DESCRIPTOR Tests::Field(const char* name, char type, unsigned char length, unsigned char decimal) {
+    FIELD_DESCRIPTOR field = {};
+    memcpy(field.name, name, std::min(strlen(name), sizeof(field.name) - 1));
+    field.type = type;
+    field.length = length;
+    field.decimal = decimal;
+    return field;
+}
+
+bool Tests::CreateTable(const std::string& path, const std::vector<FIELD_DESCRIPTOR>& fields, DBFManager& table) {
+    if (!table.CreateNew(path, fields)) return false;
+    return table.Open(path);
+}
+
+bool Tests::FileExists(const std::string& path) {
+    std::error_code error;
+    return fs::exists(path, error);
+}
+
+bool Tests::SaveFiles(const std::vector<std::string>& files, const std::string& directory) {
+    std::error_code error;
+    fs::create_directories(directory, error);
+    for (const std::string& file : files) {
+        fs::remove(fs::path(directory) / file, error);
+        if (!fs::exists(file)) continue;
+        if (!fs::copy_file(file, fs::path(directory) / file, error)) return false;
+    }
+    return true;
+}
+
+// Files missing from directory are removed, so the state is exactly the saved one
+bool Tests::RestoreFiles(const std::vector<std::string>& files, const std::string& directory) {
+    std::error_code error;
+    for (const std::string& file : files) {
+        fs::remove(file, error);
+        fs::path saved = fs::path(directory) / file;
+        if (!fs::exists(saved)) continue;
+        if (!fs::copy_file(saved, file, error)) return false;
+    }
+    return true;
+}
+
+bool Tests::CopySampleFiles(const std::vector<std::string>& files) {
+    fs::path samples = fs::path(__FILE__).parent_path().parent_path().parent_path() / "Gun";
+    std::error_code error;
+    for (const std::string& file : files) {
+        if (!fs::copy_file(samples / file, file, fs::copy_options::overwrite_existing, error)) return false;
+    }
+    return true;
+}
+
+double Tests::NowMilliseconds() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Usage: Tests [--bench] [name ...]
+// Runs every test (or the named ones) and returns the number that failed
+int main(int argc, char** argv) {
+    bool benchmarks = false;
+    std::vector<std::string> only;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--bench") == 0) benchmarks = true;
+        else only.push_back(argv[i]);
+    }
+
+    fs::path root = fs::temp_directory_path() / "dbf_tests";
+    fs::path home = fs::current_path();
+    unsigned run = 0, failed = 0;
+
+    for (const Entry& entry : Registry()) {
+        if (entry.benchmark != benchmarks) continue;
+        if (!only.empty() && std::find(only.begin(), only.end(), entry.name) == only.end()) continue;
+
+        std::error_code error;
+        fs::path scratch = root / entry.name;
+        fs::remove_all(scratch, error);
+        fs::create_directories(scratch);
+        fs::current_path(scratch);
+
+        printf("%s\n", entry.name);
+        unsigned before = failures;
+        try {
+            entry.function();
+        }
+        catch (const Tests::Abort&) {
+        }
+        catch (const std::exception& e) {
+            Tests::Fail(entry.name, 0, std::string("exception: ") + e.what());
+        }
+
+        fs::current_path(home);
+        fs::remove_all(scratch, error);
+        run++;
+        if (failures != before) failed++;
+    }
+
+    printf("%u run, %u failed\n", run, failed);
+    return (int)failed;
+}
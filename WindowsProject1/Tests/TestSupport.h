@@ -0,0 +1,78 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include "DBFManager.h"
+#include <string>
+#include <vector>
+
+// Small self-registering runner for the behaviour tests, with nothing to
+// install. Every test starts in its own empty scratch directory, so the
+// tables it creates by relative name never meet another test's files.
+//
+//     TEST(RollbackRestoresRows) {
+//         DBFManager table;
+//         REQUIRE(Tests::CreateTable("t.dbf", { Tests::Field("ID", 'C', 10) }, table));
+//         CHECK(table.RecordCount() == 0);
+//     }
+//
+// CHECK records a failure and goes on; REQUIRE ends the test. BENCHMARK
+// bodies only run when the runner is started with --bench.
+namespace Tests {
+    typedef void (*TestFunction)();
+
+    struct Registrar {
+        Registrar(const char* name, TestFunction function, bool benchmark);
+    };
+
+    // Thrown by REQUIRE; the runner catches it
+    struct Abort {};
+
+    void Fail(const char* file, int line, const std::string& what);
+
+    FIELD_DESCRIPTOR Field(const char* name, char type, unsigned char length, unsigned char decimal = 0);
+    // Creates path with fields and opens it into table
+    bool CreateTable(const std::string& path, const std::vector<FIELD_DESCRIPTOR>& fields, DBFManager& table);
+
+    bool FileExists(const std::string& path);
+    // Copies the named files into directory (created if needed), or back
+    bool SaveFiles(const std::vector<std::string>& files, const std::string& directory);
+    bool RestoreFiles(const std::vector<std::string>& files, const std::string& directory);
+    // Copies the named files of the shipped sample data (Gun) into the
+    // scratch directory, so tests can open them without touching the originals
+    bool CopySampleFiles(const std::vector<std::string>& files);
+
+    // Milliseconds taken by fn, the best of runs
+    template <typename Fn>
+    double TimeBest(unsigned runs, Fn fn);
+    double NowMilliseconds();
+}
+
+template <typename Fn>
+double Tests::TimeBest(unsigned runs, Fn fn) {
+    double best = 0;
+    for (unsigned i = 0; i < runs; ++i) {
+        double start = NowMilliseconds();
+        fn();
+        double taken = NowMilliseconds() - start;
+        if (i == 0 || taken < best) best = taken;
+    }
+    return best;
+}
+
+#define TEST(name) \
+    static void name(); \
+    static Tests::Registrar name##_registrar(#name, name, false); \
+    static void name()
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static Tests::Registrar name##_registrar(#name, name, true); \
+    static void name()
+
+#define CHECK(condition) \
+    do { if (!(condition)) Tests::Fail(__FILE__, __LINE__, #condition); } while (0)
+
+#define REQUIRE(condition) \
+    do { if (!(condition)) { Tests::Fail(__FILE__, __LINE__, #condition); throw Tests::Abort(); } } while (0)
+
+#endif
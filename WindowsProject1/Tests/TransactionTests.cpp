@@ -0,0 +1,176 @@
+#include "TestSupport.h"
+#include "TransactionCoordinator.h"
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    const std::vector<std::string> FILES = { "a.dbf", "a.dbf.jnl", "b.dbf", "b.dbf.jnl", "ab.mjl" };
+
+    std::unique_ptr<DBFTableManager> OpenTable(const std::string& file) {
+        auto table = std::make_unique<DBFTableManager>(file);
+        table->AddFieldDescriptor(Tests::Field("ID", 'C', 10));
+        table->AddFieldDescriptor(Tests::Field("QTY", 'N', 8));
+        return table;
+    }
+
+    std::map<std::string, std::string> Quantities(DBFTableManager& table) {
+        std::vector<std::map<std::string, std::string>> rows;
+        table.GetAllRecords(rows);
+        std::map<std::string, std::string> out;
+        for (auto& row : rows) {
+            std::string& qty = out[row["ID"]] = row["QTY"];
+            qty.erase(0, qty.find_first_not_of(' ')); // numbers are right-justified
+        }
+        return out;
+    }
+
+    // a gets a second row and b's row changes in one coordinated transaction.
+    // The files are copied to "crash" from inside the work, once both
+    // tables have been forced to disk but before the commit point, which is
+    // what a power cut at that moment leaves behind.
+    void RunAndCaptureCrash() {
+        auto a = OpenTable("a.dbf");
+        auto b = OpenTable("b.dbf");
+        REQUIRE(a->AddRecord({ { "ID", "A1" }, { "QTY", "1" } }));
+        REQUIRE(b->AddRecord({ { "ID", "B1" }, { "QTY", "1" } }));
+
+        TransactionCoordinator transactions("ab.mjl", { a.get(), b.get() });
+        bool ok = transactions.Execute([&] {
+            if (!a->AddRecord({ { "ID", "A2" }, { "QTY", "2" } }, true)) return false;
+            if (!b->UpdateRecord("ID", "B1", { { "QTY", "5" } }, true)) return false;
+            return a->SyncToDisk() && b->SyncToDisk() && Tests::SaveFiles(FILES, "crash");
+        });
+        REQUIRE(ok);
+        CHECK(!Tests::FileExists("ab.mjl"));
+        CHECK(!Tests::FileExists("a.dbf.jnl"));
+    }
+}
+
+TEST(CoordinatorCommitsBothTables) {
+    RunAndCaptureCrash();
+
+    auto a = OpenTable("a.dbf");
+    auto b = OpenTable("b.dbf");
+    CHECK(Quantities(*a).size() == 2);
+    CHECK(Quantities(*b)["B1"] == "5");
+}
+
+TEST(CrashBeforeCommitPointUndoesEveryTable) {
+    RunAndCaptureCrash();
+    REQUIRE(Tests::RestoreFiles(FILES, "crash"));
+    REQUIRE(Tests::FileExists("ab.mjl"));
+
+    // The master file is still there: both journals are played back
+    auto a = OpenTable("a.dbf");
+    auto b = OpenTable("b.dbf");
+    std::map<std::string, std::string> rowsA = Quantities(*a);
+    CHECK(rowsA.size() == 1);
+    CHECK(rowsA.count("A2") == 0);
+    CHECK(Quantities(*b)["B1"] == "1");
+    CHECK(!Tests::FileExists("a.dbf.jnl"));
+    CHECK(!Tests::FileExists("b.dbf.jnl"));
+}
+
+TEST(CrashAfterCommitPointKeepsEveryTable) {
+    RunAndCaptureCrash();
+    REQUIRE(Tests::RestoreFiles(FILES, "crash"));
+
+    // Master gone, journals left: the transaction had committed
+    remove("ab.mjl");
+    auto a = OpenTable("a.dbf");
+    auto b = OpenTable("b.dbf");
+    CHECK(Quantities(*a).size() == 2);
+    CHECK(Quantities(*b)["B1"] == "5");
+    CHECK(!Tests::FileExists("a.dbf.jnl"));
+    CHECK(!Tests::FileExists("b.dbf.jnl"));
+}
+
+TEST(FailedWorkLeavesNoTrace) {
+    auto a = OpenTable("a.dbf");
+    auto b = OpenTable("b.dbf");
+    REQUIRE(a->AddRecord({ { "ID", "A1" }, { "QTY", "1" } }));
+    REQUIRE(b->AddRecord({ { "ID", "B1" }, { "QTY", "1" } }));
+
+    TransactionCoordinator transactions("ab.mjl", { a.get(), b.get() });
+    bool ok = transactions.Execute([&] {
+        a->AddRecord({ { "ID", "A2" }, { "QTY", "2" } }, true);
+        b->UpdateRecord("ID", "B1", { { "QTY", "5" } }, true);
+        return false;
+    });
+    CHECK(!ok);
+    CHECK(Quantities(*a).size() == 1);
+    CHECK(Quantities(*b)["B1"] == "1");
+    CHECK(!Tests::FileExists("ab.mjl"));
+}
+
+// Callers queued behind a throwing one must still finish, and only the
+// thrower's row may be missing
+TEST(ThrowingWorkDoesNotStallOtherCallers) {
+    auto a = OpenTable("a.dbf");
+    auto b = OpenTable("b.dbf");
+    REQUIRE(a->CreateDB());
+    REQUIRE(b->CreateDB());
+
+    TransactionCoordinator transactions("ab.mjl", { a.get(), b.get() });
+    const int callers = 8;
+    std::vector<int> results(callers, -1);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < callers; ++i) {
+        threads.emplace_back([&, i] {
+            results[i] = transactions.Execute([&, i] {
+                if (i == 3) throw std::runtime_error("work failed");
+                return a->AddRecord({ { "ID", "A" + std::to_string(i) }, { "QTY", "1" } }, true);
+            });
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    for (int i = 0; i < callers; ++i) CHECK(results[i] == (i != 3));
+    auto rows = Quantities(*a);
+    CHECK(rows.size() == callers - 1);
+    CHECK(rows.find("A3") == rows.end());
+    CHECK(!Tests::FileExists("ab.mjl"));
+}
+
+TEST(SingleTableJournalRollsBackOnReopen) {
+    {
+        DBFManager table;
+        REQUIRE(Tests::CreateTable("t.dbf", { Tests::Field("ID", 'C', 10) }, table));
+        REQUIRE(table.AddRecord({ "ONE" }));
+        REQUIRE(table.BeginJournal());
+        REQUIRE(table.DeleteByFieldKey("ID", "ONE"));
+        REQUIRE(table.AddRecord({ "TWO" }));
+        REQUIRE(table.Sync());
+        REQUIRE(Tests::SaveFiles({ "t.dbf", "t.dbf.jnl" }, "crash"));
+    }
+    REQUIRE(Tests::RestoreFiles({ "t.dbf", "t.dbf.jnl" }, "crash"));
+
+    DBFManager table;
+    REQUIRE(table.Open("t.dbf"));
+    std::vector<std::vector<std::string>> rows;
+    REQUIRE(table.GetAllRecords(rows));
+    REQUIRE(rows.size() == 1);
+    CHECK(rows[0][0] == "ONE");
+    CHECK(!Tests::FileExists("t.dbf.jnl"));
+}
+
+// Inside a journal the pool holds the update back; a full read of the table
+// still sees it without forcing the page out
+TEST(BlockReadsInAJournalSeeHeldBackWrites) {
+    DBFManager table;
+    REQUIRE(Tests::CreateTable("t.dbf", { Tests::Field("ID", 'C', 10), Tests::Field("QTY", 'N', 8) }, table));
+    REQUIRE(table.AddRecords({ { "A", "1" }, { "B", "2" } }));
+    REQUIRE(table.BeginJournal());
+    REQUIRE(table.UpdateByFieldKey("ID", "B", { { "QTY", "5" } }));
+    REQUIRE(table.GetPagePoolStats().dirty_pages == 1);
+
+    std::vector<std::vector<std::string>> rows;
+    REQUIRE(table.GetAllRecords(rows));
+    REQUIRE(rows.size() == 2);
+    CHECK(rows[1][1] == "5");
+    CHECK(table.GetPagePoolStats().dirty_pages == 1);
+    REQUIRE(table.CommitJournal());
+}
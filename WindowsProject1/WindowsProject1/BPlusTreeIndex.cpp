@@ -0,0 +1,381 @@
+#include "BPlusTreeIndex.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const char BPT_MAGIC[8] = { 'D', 'B', 'F', 'B', 'P', 'T', '1', '\0' };
+    const unsigned BPT_NO_PAGE = 0; // page 0 is the header, never a node
+
+    BPT_NODE_HEADER* Node(std::vector<char>& page) {
+        return reinterpret_cast<BPT_NODE_HEADER*>(page.data());
+    }
+
+    char* Entries(std::vector<char>& page) {
+        return page.data() + sizeof(BPT_NODE_HEADER);
+    }
+
+    unsigned ReadU32(const char* bytes) {
+        unsigned value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    void WriteU32(char* bytes, unsigned value) {
+        memcpy(bytes, &value, sizeof(value));
+    }
+}
+
+bool BPlusTreeIndex::Open(const std::string& filepath) {
+    Close();
+    path = filepath;
+    index_file.open(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!index_file) return false;
+
+    index_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (index_file.gcount() != sizeof(header) || memcmp(header.magic, BPT_MAGIC, sizeof(BPT_MAGIC)) != 0 ||
+        header.key_length == 0 || header.key_length + 8u > PAGE_SIZE / 4) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+bool BPlusTreeIndex::Create(const std::string& filepath, unsigned short key_length) {
+    Close();
+    if (key_length == 0 || key_length + 8u > PAGE_SIZE / 4) return false;
+
+    path = filepath;
+    index_file.open(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    if (!index_file) return false;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BPT_MAGIC, sizeof(BPT_MAGIC));
+    header.key_length = key_length;
+    header.root_page = BPT_NO_PAGE;
+    header.page_count = 1;
+    return WriteHeader();
+}
+
+bool BPlusTreeIndex::ReadPage(unsigned page, std::vector<char>& buffer) {
+    if (page == BPT_NO_PAGE || page >= header.page_count) return false;
+
+    buffer.resize(PAGE_SIZE);
+    index_file.clear();
+    index_file.seekg((std::streamoff)page * PAGE_SIZE);
+    index_file.read(buffer.data(), PAGE_SIZE);
+    return index_file.gcount() == PAGE_SIZE;
+}
+
+bool BPlusTreeIndex::WritePage(unsigned page, const std::vector<char>& buffer) {
+    index_file.clear();
+    index_file.seekp((std::streamoff)page * PAGE_SIZE);
+    index_file.write(buffer.data(), PAGE_SIZE);
+    return (bool)index_file;
+}
+
+bool BPlusTreeIndex::WriteHeader() {
+    std::vector<char> page(PAGE_SIZE, 0);
+    memcpy(page.data(), &header, sizeof(header));
+    if (!WritePage(0, page)) return false;
+    index_file.flush();
+    return (bool)index_file;
+}
+
+unsigned BPlusTreeIndex::AllocatePage() {
+    return header.page_count++;
+}
+
+bool BPlusTreeIndex::IsSyncedWith(unsigned num_records, const unsigned char last_update[3], unsigned changes) const {
+    return header.synced_records == num_records && memcmp(header.synced_update, last_update, 3) == 0 &&
+        header.synced_changes == changes;
+}
+
+bool BPlusTreeIndex::SetSynced(unsigned num_records, const unsigned char last_update[3], unsigned changes) {
+    header.synced_records = num_records;
+    memcpy(header.synced_update, last_update, 3);
+    header.synced_changes = changes;
+    return WriteHeader();
+}
+
+int BPlusTreeIndex::Compare(const char* entry, const std::string& key, unsigned recno) const {
+    int result = memcmp(entry, key.data(), header.key_length);
+    if (result != 0) return result;
+
+    unsigned entry_recno = ReadU32(entry + header.key_length);
+    return entry_recno < recno ? -1 : (entry_recno > recno ? 1 : 0);
+}
+
+bool BPlusTreeIndex::FindLeaf(const std::string& key, unsigned recno, std::vector<char>& leaf, unsigned& page,
+    std::vector<std::pair<unsigned, unsigned>>* path) {
+    const unsigned entry_size = header.key_length + 8;
+    page = header.root_page;
+
+    for (;;) {
+        if (!ReadPage(page, leaf)) return false;
+        BPT_NODE_HEADER* node = Node(leaf);
+        if (node->is_leaf) return true;
+
+        // Separator i is the smallest entry of child i + 1
+        unsigned slot = 0;
+        const char* entries = Entries(leaf);
+        while (slot < node->count && Compare(entries + slot * entry_size, key, recno) <= 0) ++slot;
+
+        if (path) path->push_back({ page, slot });
+        page = slot == 0 ? node->link : ReadU32(entries + (slot - 1) * entry_size + header.key_length + 4);
+    }
+}
+
+bool BPlusTreeIndex::Insert(const std::string& key, unsigned recno) {
+    if (!isOpen() || key.size() != header.key_length) return false;
+    const unsigned entry_size = header.key_length + 4;
+
+    std::vector<char> leaf;
+    if (header.root_page == BPT_NO_PAGE) {
+        header.root_page = AllocatePage();
+        leaf.assign(PAGE_SIZE, 0);
+        Node(leaf)->is_leaf = 1;
+        if (!WritePage(header.root_page, leaf)) return false;
+    }
+
+    std::vector<std::pair<unsigned, unsigned>> path;
+    unsigned page;
+    if (!FindLeaf(key, recno, leaf, page, &path)) return false;
+
+    BPT_NODE_HEADER* node = Node(leaf);
+    char* entries = Entries(leaf);
+    unsigned slot = 0;
+    while (slot < node->count) {
+        int cmp = Compare(entries + slot * entry_size, key, recno);
+        if (cmp == 0) return true; // already indexed
+        if (cmp > 0) break;
+        ++slot;
+    }
+
+    // Build the new entry list in a scratch buffer, then split if it overflows
+    std::vector<char> merged((node->count + 1) * entry_size);
+    memcpy(merged.data(), entries, slot * entry_size);
+    memcpy(merged.data() + slot * entry_size, key.data(), header.key_length);
+    WriteU32(merged.data() + slot * entry_size + header.key_length, recno);
+    memcpy(merged.data() + (slot + 1) * entry_size, entries + slot * entry_size, (node->count - slot) * entry_size);
+    unsigned total = node->count + 1;
+    header.entry_count++;
+
+    if (total <= LeafCapacity()) {
+        memcpy(entries, merged.data(), merged.size());
+        node->count = (unsigned short)total;
+        return WritePage(page, leaf) && WriteHeader();
+    }
+
+    unsigned left_count = total / 2;
+    unsigned right_page = AllocatePage();
+    std::vector<char> right(PAGE_SIZE, 0);
+    Node(right)->is_leaf = 1;
+    Node(right)->count = (unsigned short)(total - left_count);
+    Node(right)->link = node->link;
+    memcpy(Entries(right), merged.data() + left_count * entry_size, (total - left_count) * entry_size);
+
+    node->count = (unsigned short)left_count;
+    node->link = right_page;
+    memcpy(entries, merged.data(), left_count * entry_size);
+
+    if (!WritePage(page, leaf) || !WritePage(right_page, right)) return false;
+
+    std::string separator(Entries(right), entry_size);
+    return InsertIntoParent(path, page, separator, right_page) && WriteHeader();
+}
+
+bool BPlusTreeIndex::InsertIntoParent(std::vector<std::pair<unsigned, unsigned>>& path, unsigned left_page,
+    const std::string& separator, unsigned child_page) {
+    const unsigned entry_size = header.key_length + 8;
+
+    if (path.empty()) {
+        // Root split: grow the tree by one level
+        std::vector<char> root(PAGE_SIZE, 0);
+        Node(root)->is_leaf = 0;
+        Node(root)->count = 1;
+        Node(root)->link = left_page;
+        memcpy(Entries(root), separator.data(), separator.size());
+        WriteU32(Entries(root) + separator.size(), child_page);
+        header.root_page = AllocatePage();
+        return WritePage(header.root_page, root);
+    }
+
+    unsigned page = path.back().first;
+    unsigned slot = path.back().second;
+    path.pop_back();
+
+    std::vector<char> parent;
+    if (!ReadPage(page, parent)) return false;
+    BPT_NODE_HEADER* node = Node(parent);
+    char* entries = Entries(parent);
+
+    std::vector<char> merged((node->count + 1) * entry_size);
+    memcpy(merged.data(), entries, slot * entry_size);
+    memcpy(merged.data() + slot * entry_size, separator.data(), separator.size());
+    WriteU32(merged.data() + slot * entry_size + separator.size(), child_page);
+    memcpy(merged.data() + (slot + 1) * entry_size, entries + slot * entry_size, (node->count - slot) * entry_size);
+    unsigned total = node->count + 1;
+
+    if (total <= InteriorCapacity()) {
+        memcpy(entries, merged.data(), merged.size());
+        node->count = (unsigned short)total;
+        return WritePage(page, parent);
+    }
+
+    // The middle separator moves up; its child becomes the right node's leftmost
+    unsigned middle = total / 2;
+    const char* up = merged.data() + middle * entry_size;
+    unsigned right_page = AllocatePage();
+    std::vector<char> right(PAGE_SIZE, 0);
+    Node(right)->is_leaf = 0;
+    Node(right)->count = (unsigned short)(total - middle - 1);
+    Node(right)->link = ReadU32(up + header.key_length + 4);
+    memcpy(Entries(right), up + entry_size, (total - middle - 1) * entry_size);
+
+    node->count = (unsigned short)middle;
+    memcpy(entries, merged.data(), middle * entry_size);
+
+    if (!WritePage(page, parent) || !WritePage(right_page, right)) return false;
+
+    std::string promoted(up, header.key_length + 4);
+    return InsertIntoParent(path, page, promoted, right_page);
+}
+
+bool BPlusTreeIndex::Erase(const std::string& key, unsigned recno) {
+    if (!isOpen() || key.size() != header.key_length || header.root_page == BPT_NO_PAGE) return false;
+    const unsigned entry_size = header.key_length + 4;
+
+    std::vector<char> leaf;
+    unsigned page;
+    if (!FindLeaf(key, recno, leaf, page, nullptr)) return false;
+
+    BPT_NODE_HEADER* node = Node(leaf);
+    char* entries = Entries(leaf);
+    for (unsigned slot = 0; slot < node->count; ++slot) {
+        if (Compare(entries + slot * entry_size, key, recno) != 0) continue;
+
+        memmove(entries + slot * entry_size, entries + (slot + 1) * entry_size, (node->count - slot - 1) * entry_size);
+        node->count--;
+        header.entry_count--;
+        return WritePage(page, leaf) && WriteHeader();
+    }
+    return false;
+}
+
+bool BPlusTreeIndex::BulkLoad(std::vector<Entry>& entries) {
+    if (!Create(path, header.key_length)) return false;
+
+    std::sort(entries.begin(), entries.end());
+    const unsigned entry_size = header.key_length + 4;
+
+    // Fill leaves to about 85% so the first inserts do not split every page
+    unsigned leaf_fill = std::max(1u, LeafCapacity() * 85 / 100);
+    std::vector<std::pair<std::string, unsigned>> level; // (first entry bytes, page)
+    std::vector<char> page(PAGE_SIZE);
+
+    for (size_t first = 0; first < entries.size(); first += leaf_fill) {
+        size_t count = std::min<size_t>(leaf_fill, entries.size() - first);
+        unsigned page_no = AllocatePage();
+
+        std::fill(page.begin(), page.end(), 0);
+        Node(page)->is_leaf = 1;
+        Node(page)->count = (unsigned short)count;
+        Node(page)->link = first + count < entries.size() ? page_no + 1 : BPT_NO_PAGE;
+        for (size_t i = 0; i < count; ++i) {
+            const Entry& entry = entries[first + i];
+            char* slot = Entries(page) + i * entry_size;
+            memcpy(slot, entry.first.data(), header.key_length);
+            WriteU32(slot + header.key_length, entry.second);
+        }
+        if (!WritePage(page_no, page)) return false;
+        level.push_back({ std::string(Entries(page), entry_size), page_no });
+    }
+
+    // Stack interior levels until a single root remains
+    unsigned fanout = InteriorCapacity() + 1;
+    while (level.size() > 1) {
+        std::vector<std::pair<std::string, unsigned>> parents;
+        for (size_t first = 0; first < level.size(); first += fanout) {
+            size_t count = std::min<size_t>(fanout, level.size() - first);
+            unsigned page_no = AllocatePage();
+
+            std::fill(page.begin(), page.end(), 0);
+            Node(page)->is_leaf = 0;
+            Node(page)->count = (unsigned short)(count - 1);
+            Node(page)->link = level[first].second;
+            for (size_t i = 1; i < count; ++i) {
+                char* slot = Entries(page) + (i - 1) * (entry_size + 4);
+                memcpy(slot, level[first + i].first.data(), entry_size);
+                WriteU32(slot + entry_size, level[first + i].second);
+            }
+            if (!WritePage(page_no, page)) return false;
+            parents.push_back({ level[first].first, page_no });
+        }
+        level.swap(parents);
+    }
+
+    header.root_page = level.empty() ? BPT_NO_PAGE : level[0].second;
+    header.entry_count = (unsigned)entries.size();
+    return WriteHeader();
+}
+
+template <typename Accept>
+bool BPlusTreeIndex::ScanFrom(const std::string& start, std::vector<unsigned>& out, size_t limit, Accept accept) {
+    out.clear();
+    if (!isOpen() || header.root_page == BPT_NO_PAGE) return false;
+    const unsigned entry_size = header.key_length + 4;
+
+    std::vector<char> leaf;
+    unsigned page;
+    if (!FindLeaf(start, 0, leaf, page, nullptr)) return false;
+
+    unsigned slot = 0;
+    while (slot < Node(leaf)->count && Compare(Entries(leaf) + slot * entry_size, start, 0) < 0) ++slot;
+
+    while (out.size() < limit) {
+        if (slot == Node(leaf)->count) {
+            unsigned next = Node(leaf)->link;
+            if (next == BPT_NO_PAGE || !ReadPage(next, leaf)) break;
+            slot = 0;
+            continue;
+        }
+
+        const char* entry = Entries(leaf) + slot * entry_size;
+        if (!accept(entry)) break;
+        out.push_back(ReadU32(entry + header.key_length));
+        ++slot;
+    }
+    return !out.empty();
+}
+
+bool BPlusTreeIndex::Find(const std::string& key, std::vector<unsigned>& out, size_t limit) {
+    if (key.size() > header.key_length) return false;
+
+    std::string padded = key;
+    padded.resize(header.key_length, ' ');
+    return ScanFrom(padded, out, limit, [&](const char* entry) {
+        return memcmp(entry, padded.data(), header.key_length) == 0;
+    });
+}
+
+bool BPlusTreeIndex::FindPrefix(const std::string& prefix, std::vector<unsigned>& out, size_t limit) {
+    if (prefix.size() > header.key_length) return false;
+
+    // '\0' padding sorts before every key that starts with the prefix
+    std::string start = prefix;
+    start.resize(header.key_length, '\0');
+    return ScanFrom(start, out, limit, [&](const char* entry) {
+        return memcmp(entry, prefix.data(), prefix.size()) == 0;
+    });
+}
+
+bool BPlusTreeIndex::FindRange(const std::string& low, const std::string& high, std::vector<unsigned>& out) {
+    if (low.size() > header.key_length || high.size() > header.key_length) return false;
+
+    std::string start = low, end = high;
+    start.resize(header.key_length, ' ');
+    end.resize(header.key_length, ' ');
+    return ScanFrom(start, out, SIZE_MAX, [&](const char* entry) {
+        return memcmp(entry, end.data(), header.key_length) <= 0;
+    });
+}
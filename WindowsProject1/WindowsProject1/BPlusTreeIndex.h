@@ -0,0 +1,90 @@
+#ifndef BPLUS_TREE_INDEX_H
+#define BPLUS_TREE_INDEX_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#pragma pack(push, 1)
+struct BPT_HEADER {
+    char magic[8];                  // "DBFBPT1"
+    unsigned short key_length;
+    unsigned short reserved;
+    unsigned int root_page;
+    unsigned int page_count;
+    unsigned int entry_count;
+    unsigned int synced_records;    // DBF num_records when last brought up to date
+    unsigned char synced_update[3]; // DBF last_update at the same moment
+    unsigned int synced_changes;    // DBF change_count at the same moment
+    char unused[1];
+};
+
+struct BPT_NODE_HEADER {
+    unsigned short is_leaf;
+    unsigned short count;
+    unsigned int link;              // leaf: next leaf, interior: leftmost child
+};
+#pragma pack(pop)
+
+// Disk-resident B+tree mapping fixed-width keys to 1-based record numbers.
+// Entries are ordered by (key, recno), so duplicate keys are allowed and a
+// specific row can be removed. Pages are read on demand and written through
+// on every change; Open only reads the header page.
+// Leaves are never merged on erase: an emptied leaf stays in the chain and
+// the next BulkLoad (after a Pack) compacts the file again.
+class BPlusTreeIndex {
+public:
+    static const unsigned PAGE_SIZE = 4096;
+    typedef std::pair<std::string, unsigned> Entry;
+
+    BPlusTreeIndex() = default;
+    ~BPlusTreeIndex() { Close(); }
+
+    bool Open(const std::string& filepath);
+    bool Create(const std::string& filepath, unsigned short key_length);
+    void Close() { if (index_file.is_open()) index_file.close(); }
+    bool isOpen() const { return index_file.is_open(); }
+
+    // Replaces the whole tree with entries (sorted here)
+    bool BulkLoad(std::vector<Entry>& entries);
+    bool Insert(const std::string& key, unsigned recno);
+    bool Erase(const std::string& key, unsigned recno);
+
+    bool Find(const std::string& key, std::vector<unsigned>& out, size_t limit = SIZE_MAX);
+    bool FindPrefix(const std::string& prefix, std::vector<unsigned>& out, size_t limit = SIZE_MAX);
+    bool FindRange(const std::string& low, const std::string& high, std::vector<unsigned>& out);
+
+    unsigned short GetKeyLength() const { return header.key_length; }
+    unsigned GetEntryCount() const { return header.entry_count; }
+
+    // Staleness stamp checked against the table header at load time
+    bool IsSyncedWith(unsigned num_records, const unsigned char last_update[3], unsigned changes) const;
+    bool SetSynced(unsigned num_records, const unsigned char last_update[3], unsigned changes);
+
+private:
+    std::fstream index_file;
+    BPT_HEADER header;
+    std::string path;
+
+    unsigned LeafCapacity() const { return (PAGE_SIZE - sizeof(BPT_NODE_HEADER)) / (header.key_length + 4); }
+    unsigned InteriorCapacity() const { return (PAGE_SIZE - sizeof(BPT_NODE_HEADER)) / (header.key_length + 8); }
+
+    bool ReadPage(unsigned page, std::vector<char>& buffer);
+    bool WritePage(unsigned page, const std::vector<char>& buffer);
+    bool WriteHeader();
+    unsigned AllocatePage();
+
+    int Compare(const char* entry, const std::string& key, unsigned recno) const;
+    bool FindLeaf(const std::string& key, unsigned recno, std::vector<char>& leaf, unsigned& page,
+        std::vector<std::pair<unsigned, unsigned>>* path);
+    bool InsertIntoParent(std::vector<std::pair<unsigned, unsigned>>& path, unsigned left_page,
+        const std::string& separator, unsigned child_page);
+
+    // Walks leaves from the first entry >= (start, 0) while accept returns true
+    template <typename Accept>
+    bool ScanFrom(const std::string& start, std::vector<unsigned>& out, size_t limit, Accept accept);
+};
+
+#endif
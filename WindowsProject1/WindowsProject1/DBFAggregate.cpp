@@ -0,0 +1,222 @@
+#include "DBFAggregate.h"
+#include "DBFParallelScan.h"
+#include "DBFValue.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+    const unsigned AGGREGATE_BATCH = 1024; // records per block, multiple of 64
+}
+
+const FIELD_DESCRIPTOR* DBFAggregator::FindField(const std::string& fieldName) const {
+    for (const auto& field : table.GetFields()) {
+        if (_strnicmp(field.name, fieldName.c_str(), sizeof(field.name)) == 0) return &field;
+    }
+    return nullptr;
+}
+
+bool DBFAggregator::GroupBy(const std::string& fieldName, unsigned length) {
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field || length > field->length) return false;
+
+    if (length == 0) length = field->length;
+    key_parts.push_back({ field->address, length });
+    key_length += length;
+    return true;
+}
+
+bool DBFAggregator::Add(Function function, const std::string& fieldName) {
+    if (function == AGG_COUNT) {
+        aggregates.push_back({ function, 0, 0 });
+        return true;
+    }
+
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field || (field->type != 'N' && field->type != 'F')) return false;
+    aggregates.push_back({ function, field->address, field->length });
+    return true;
+}
+
+bool DBFAggregator::For(const std::string& condition) {
+    DBFScanner filter(table);
+    if (!filter.For(condition)) return false;
+    predicates.insert(predicates.end(), filter.GetPredicates().begin(), filter.GetPredicates().end());
+    return true;
+}
+
+void DBFAggregator::Clear() {
+    key_parts.clear();
+    key_length = 0;
+    aggregates.clear();
+    predicates.clear();
+}
+
+// The caller's conditions after the deleted-row test
+std::vector<DBFScanner::Predicate> DBFAggregator::Filter() const {
+    std::vector<DBFScanner::Predicate> filter;
+    filter.push_back({ DBFScanner::PRED_NOT_DELETED, 0, 1, "", "" });
+    filter.insert(filter.end(), predicates.begin(), predicates.end());
+    return filter;
+}
+
+uint32_t DBFAggregator::GroupTable::Find(const std::string& key, size_t aggregates) {
+    auto found = slots.find(key);
+    if (found != slots.end()) return found->second;
+
+    uint32_t slot = (uint32_t)keys.size();
+    slots.emplace(key, slot);
+    keys.push_back(key);
+    rows.push_back(0);
+    const double infinity = std::numeric_limits<double>::infinity();
+    accumulators.resize(accumulators.size() + aggregates, { 0, infinity, -infinity });
+    return slot;
+}
+
+void DBFAggregator::GroupTable::Merge(const GroupTable& other, size_t aggregates) {
+    for (uint32_t from = 0; from < other.keys.size(); ++from) {
+        uint32_t to = Find(other.keys[from], aggregates);
+
+        const Accumulator* source = other.accumulators.data() + (size_t)from * aggregates;
+        Accumulator* target = accumulators.data() + (size_t)to * aggregates;
+        for (size_t i = 0; i < aggregates; ++i) {
+            target[i].sum += source[i].sum;
+            target[i].min = std::min(target[i].min, source[i].min);
+            target[i].max = std::max(target[i].max, source[i].max);
+        }
+        rows[to] += other.rows[from];
+    }
+}
+
+void DBFAggregator::AggregateBlock(const std::vector<DBFScanner::Predicate>& filter, const char* block,
+    unsigned count, GroupTable& groups) const {
+    unsigned record_size = table.RecordSize();
+    uint64_t selection[AGGREGATE_BATCH / 64];
+    unsigned words = (count + 63) / 64;
+    for (unsigned w = 0; w < words; ++w) selection[w] = ~0ull;
+    if (count % 64) selection[words - 1] = (1ull << (count % 64)) - 1;
+    DBFScanner::EvaluateBlock(filter, block, count, record_size, selection);
+
+    // Pass 1: the selected rows and their group slots. Neighbouring rows
+    // often share a group, so the last key is checked before hashing.
+    unsigned selected_rows[AGGREGATE_BATCH];
+    uint32_t slots[AGGREGATE_BATCH];
+    unsigned selected = 0;
+    std::string key(key_length, ' '), last_key;
+    uint32_t last_slot = 0;
+    bool have_last = false;
+
+    for (unsigned row = 0; row < count; ++row) {
+        if (!(selection[row / 64] & (1ull << (row % 64)))) continue;
+        const char* record = block + (size_t)row * record_size;
+
+        uint32_t slot = 0;
+        if (!key_parts.empty()) {
+            char* out = &key[0];
+            for (const KeyPart& part : key_parts) {
+                memcpy(out, record + part.offset, part.length);
+                out += part.length;
+            }
+            if (!have_last || key != last_key) {
+                last_slot = groups.Find(key, aggregates.size());
+                last_key = key;
+                have_last = true;
+            }
+            slot = last_slot;
+        }
+        else if (groups.keys.empty()) groups.Find(key, aggregates.size());
+
+        selected_rows[selected] = row;
+        slots[selected] = slot;
+        selected++;
+        groups.rows[slot]++;
+    }
+
+    // Pass 2: one column at a time over the selected rows
+    size_t stride = aggregates.size();
+    for (size_t a = 0; a < aggregates.size(); ++a) {
+        const Aggregate& agg = aggregates[a];
+        if (agg.function == AGG_COUNT) continue;
+
+        for (unsigned i = 0; i < selected; ++i) {
+            double value = ParseDBFNumber(block + (size_t)selected_rows[i] * record_size + agg.offset, agg.length);
+            Accumulator& acc = groups.accumulators[(size_t)slots[i] * stride + a];
+            acc.sum += value;
+            acc.min = std::min(acc.min, value);
+            acc.max = std::max(acc.max, value);
+        }
+    }
+}
+
+bool DBFAggregator::Run(std::vector<Group>& out, unsigned threads) {
+    out.clear();
+    if (!table.isOpen()) return false;
+
+    std::vector<DBFScanner::Predicate> filter = Filter();
+    unsigned record_size = table.RecordSize();
+    GroupTable groups;
+
+    if (threads != 1) {
+        // One group table per chunk, merged in chunk order so sums add up
+        // the same way every run
+        DBFParallelScan scan(table, threads);
+        bool ok = scan.Reduce(
+            [&](unsigned, unsigned count, const char* records, GroupTable& part) {
+                for (unsigned done = 0; done < count; done += AGGREGATE_BATCH) {
+                    AggregateBlock(filter, records + (size_t)done * record_size,
+                        std::min(AGGREGATE_BATCH, count - done), part);
+                }
+                return true;
+            },
+            [&](GroupTable& result, const GroupTable& part) { result.Merge(part, aggregates.size()); },
+            groups);
+        if (!ok) return false;
+    }
+    else {
+        unsigned total = table.RecordCount();
+        std::vector<char> scratch;
+        for (unsigned first = 0; first < total; first += AGGREGATE_BATCH) {
+            unsigned count = std::min(AGGREGATE_BATCH, total - first);
+            const char* block = table.ReadRecordBlock(first, count, scratch);
+            if (!block) return false;
+            AggregateBlock(filter, block, count, groups);
+        }
+    }
+    if (key_parts.empty() && groups.keys.empty()) groups.Find(std::string(), aggregates.size());
+
+    // Key byte order: C fields sort as text, D fields by date
+    std::vector<uint32_t> order(groups.keys.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(),
+        [&](uint32_t a, uint32_t b) { return groups.keys[a] < groups.keys[b]; });
+
+    out.reserve(order.size());
+    for (uint32_t slot : order) {
+        Group group;
+        group.rows = groups.rows[slot];
+
+        const std::string& key = groups.keys[slot];
+        size_t at = 0;
+        for (const KeyPart& part : key_parts) {
+            std::string value = key.substr(at, part.length);
+            value.erase(value.find_last_not_of(" \t") + 1);
+            group.keys.push_back(std::move(value));
+            at += part.length;
+        }
+
+        const Accumulator* acc = groups.accumulators.data() + (size_t)slot * aggregates.size();
+        for (size_t a = 0; a < aggregates.size(); ++a) {
+            double value = 0;
+            switch (aggregates[a].function) {
+            case AGG_COUNT: value = (double)group.rows; break;
+            case AGG_SUM:   value = acc[a].sum; break;
+            case AGG_MIN:   value = group.rows ? acc[a].min : 0; break;
+            case AGG_MAX:   value = group.rows ? acc[a].max : 0; break;
+            case AGG_AVG:   value = group.rows ? acc[a].sum / group.rows : 0; break;
+            }
+            group.values.push_back(value);
+        }
+        out.push_back(std::move(group));
+    }
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef DBF_AGGREGATE_H
+#define DBF_AGGREGATE_H
+
+#include "DBFManager.h"
+#include "DBFScan.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// sum/count/min/max/avg ... for <filter> with optional grouping, straight
+// from the raw record bytes:
+//
+//     DBFAggregator agg(kpju);
+//     agg.GroupBy("KBRG");
+//     agg.GroupBy("TJUAL", 6);                     // YYYYMM of the date
+//     agg.Add(DBFAggregator::AGG_SUM, "TOTB");
+//     agg.Add(DBFAggregator::AGG_COUNT);
+//     agg.Run(groups);
+//
+// Records are read a block at a time. The filter runs over the whole block
+// first (DBFScanner::EvaluateBlock), then every selected row is given its
+// group slot, and each aggregate walks its column for the block. Groups
+// live in a hash table keyed by the group bytes exactly as stored, so the
+// cost does not depend on how many groups there are. Deleted rows never
+// count; blank numbers count as 0, as in xBase.
+class DBFAggregator {
+public:
+    enum Function {
+        AGG_COUNT,  // rows in the group, no field
+        AGG_SUM,
+        AGG_MIN,
+        AGG_MAX,
+        AGG_AVG
+    };
+
+    explicit DBFAggregator(DBFManager& table) : table(table) {}
+
+    // Builders return false when the field does not exist or does not fit.
+    // GroupBy keys on the first length bytes of the field (0 = all of it).
+    bool GroupBy(const std::string& fieldName, unsigned length = 0);
+    // SUM/MIN/MAX/AVG take an 'N' or 'F' field
+    bool Add(Function function, const std::string& fieldName = "");
+    // Only rows matching the scanner's conditions are aggregated; the
+    // scanner must have been built on the same table
+    void Where(const DBFScanner& filter) { predicates = filter.GetPredicates(); }
+    // sum ... for <condition>: adds a compiled xBase condition to the filter
+    bool For(const std::string& condition);
+    void Clear();
+
+    struct Group {
+        std::vector<std::string> keys;  // one per GroupBy, trailing blanks dropped
+        unsigned long rows;
+        std::vector<double> values;     // one per Add, in the order added
+    };
+
+    // Groups come out in key byte order (one group without GroupBy, even
+    // when no row matched). threads other than 1 aggregate chunks on that
+    // many threads (0 = every core). Groups, COUNT, MIN and MAX come out the
+    // same; SUM and AVG add per chunk and then chunk by chunk, so they repeat
+    // exactly for any thread count but may differ from threads = 1 in the
+    // last bits.
+    bool Run(std::vector<Group>& out, unsigned threads = 1);
+
+private:
+    struct KeyPart {
+        unsigned offset;
+        unsigned length;
+    };
+    struct Aggregate {
+        Function function;
+        unsigned offset;
+        unsigned length;
+    };
+    struct Accumulator {
+        double sum;
+        double min;
+        double max;
+    };
+
+    // Groups found so far: the key bytes, row count and one accumulator per
+    // aggregate for each group slot
+    struct GroupTable {
+        std::unordered_map<std::string, uint32_t> slots;
+        std::vector<std::string> keys;
+        std::vector<unsigned long> rows;
+        std::vector<Accumulator> accumulators;  // slot * aggregates + i
+
+        uint32_t Find(const std::string& key, size_t aggregates);
+        void Merge(const GroupTable& other, size_t aggregates);
+    };
+
+    DBFManager& table;
+    std::vector<KeyPart> key_parts;
+    unsigned key_length = 0;
+    std::vector<Aggregate> aggregates;
+    std::vector<DBFScanner::Predicate> predicates;
+
+    const FIELD_DESCRIPTOR* FindField(const std::string& fieldName) const;
+    std::vector<DBFScanner::Predicate> Filter() const;
+    void AggregateBlock(const std::vector<DBFScanner::Predicate>& filter, const char* block,
+        unsigned count, GroupTable& groups) const;
+};
+
+#endif
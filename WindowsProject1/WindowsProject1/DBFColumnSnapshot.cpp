@@ -0,0 +1,177 @@
+#include "DBFColumnSnapshot.h"
+#include "DBFParallelScan.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    const unsigned SNAPSHOT_BATCH = 1024; // records read per block
+
+    double ParseNumber(const char* raw, size_t length) {
+        char buffer[64];
+        if (length >= sizeof(buffer)) length = sizeof(buffer) - 1;
+        memcpy(buffer, raw, length);
+        buffer[length] = '\0';
+        return atof(buffer);
+    }
+}
+
+std::string_view DBFColumnSnapshot::Column::text(size_t row) const {
+    std::string_view value(bytes.data() + row * length, length);
+    size_t end = value.find_last_not_of(" \t");
+    return end == std::string_view::npos ? std::string_view() : value.substr(0, end + 1);
+}
+
+int32_t DBFColumnSnapshot::ParseDate(const char* raw, size_t length) {
+    if (length < 8) return 0;
+
+    int32_t value = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        if (raw[i] < '0' || raw[i] > '9') return 0; // blank or damaged date
+        value = value * 10 + (raw[i] - '0');
+    }
+    return value;
+}
+
+void DBFColumnSnapshot::Clear() {
+    columns.clear();
+    positions.clear();
+}
+
+bool DBFColumnSnapshot::Build(DBFManager& table, unsigned threads) {
+    Clear();
+    if (!table.isOpen()) return false;
+
+    const std::vector<FIELD_DESCRIPTOR>& fields = table.GetFields();
+    unsigned total = table.RecordCount();
+    unsigned short record_size = table.RecordSize();
+
+    if (threads != 1) {
+        // Each chunk fills its own snapshot; they are appended in file order
+        InitColumns(fields, 0);
+        DBFParallelScan scan(table, threads);
+        bool ok = scan.Reduce(
+            [&](unsigned first, unsigned count, const char* records, DBFColumnSnapshot& part) {
+                part.InitColumns(fields, count);
+                part.AppendBlock(fields, records, count, record_size, table.PositionOfRecno(first + 1));
+                return true;
+            },
+            [](DBFColumnSnapshot& result, DBFColumnSnapshot& part) { result.Append(part); },
+            *this);
+        if (!ok) Clear();
+        return ok;
+    }
+
+    InitColumns(fields, total);
+    std::vector<char> scratch;
+    for (unsigned first = 0; first < total; first += SNAPSHOT_BATCH) {
+        unsigned count = std::min(SNAPSHOT_BATCH, total - first);
+        const char* block = table.ReadRecordBlock(first, count, scratch);
+        if (!block) {
+            Clear();
+            return false;
+        }
+        AppendBlock(fields, block, count, record_size, table.PositionOfRecno(first + 1));
+    }
+    return true;
+}
+
+void DBFColumnSnapshot::InitColumns(const std::vector<FIELD_DESCRIPTOR>& fields, unsigned rows) {
+    columns.resize(fields.size());
+    for (size_t f = 0; f < fields.size(); ++f) {
+        Column& column = columns[f];
+        column.name = fields[f].name;
+        column.type = fields[f].type;
+        column.length = fields[f].length;
+        column.decimal = fields[f].decimal;
+
+        if (column.isNumeric()) column.numbers.reserve(rows);
+        else if (column.isDate()) column.dates.reserve(rows);
+        else column.bytes.reserve((size_t)rows * column.length);
+    }
+    positions.reserve(rows);
+}
+
+void DBFColumnSnapshot::AppendBlock(const std::vector<FIELD_DESCRIPTOR>& fields, const char* block,
+    unsigned count, unsigned short record_size, long first_pos) {
+    for (unsigned i = 0; i < count; ++i) {
+        const char* record = block + (size_t)i * record_size;
+        if (record[0] == '*') continue; // Skip deleted
+
+        positions.push_back(first_pos + (long)i * record_size);
+        for (size_t f = 0; f < fields.size(); ++f) {
+            Column& column = columns[f];
+            const char* raw = record + fields[f].address;
+
+            if (column.isNumeric()) column.numbers.push_back(ParseNumber(raw, column.length));
+            else if (column.isDate()) column.dates.push_back(ParseDate(raw, column.length));
+            else column.bytes.insert(column.bytes.end(), raw, raw + column.length);
+        }
+    }
+}
+
+void DBFColumnSnapshot::Append(DBFColumnSnapshot& part) {
+    positions.insert(positions.end(), part.positions.begin(), part.positions.end());
+    for (size_t f = 0; f < columns.size(); ++f) {
+        Column& column = columns[f];
+        Column& from = part.columns[f];
+        column.numbers.insert(column.numbers.end(), from.numbers.begin(), from.numbers.end());
+        column.dates.insert(column.dates.end(), from.dates.begin(), from.dates.end());
+        column.bytes.insert(column.bytes.end(), from.bytes.begin(), from.bytes.end());
+    }
+    part.Clear();
+}
+
+const DBFColumnSnapshot::Column* DBFColumnSnapshot::GetColumn(const std::string& name) const {
+    for (const auto& column : columns) {
+        if (_stricmp(column.name.c_str(), name.c_str()) == 0) return &column;
+    }
+    return nullptr;
+}
+
+double DBFColumnSnapshot::Sum(const std::string& valueColumn) const {
+    const Column* value = GetColumn(valueColumn);
+    if (!value || !value->isNumeric()) return 0;
+
+    double total = 0;
+    for (double number : value->numbers) total += number;
+    return total;
+}
+
+double DBFColumnSnapshot::SumByDateRange(const std::string& valueColumn, const std::string& dateColumn,
+    int32_t from, int32_t to) const {
+    const Column* value = GetColumn(valueColumn);
+    const Column* date = GetColumn(dateColumn);
+    if (!value || !date || !value->isNumeric() || !date->isDate()) return 0;
+
+    const double* numbers = value->numbers.data();
+    const int32_t* dates = date->dates.data();
+    size_t rows = RowCount();
+
+    double total = 0;
+    for (size_t row = 0; row < rows; ++row) {
+        if (dates[row] >= from && dates[row] <= to) total += numbers[row];
+    }
+    return total;
+}
+
+double DBFColumnSnapshot::SumByText(const std::string& valueColumn, const std::string& keyColumn,
+    const std::string& key) const {
+    const Column* value = GetColumn(valueColumn);
+    const Column* text = GetColumn(keyColumn);
+    if (!value || !text || !value->isNumeric() || text->isNumeric() || text->isDate()) return 0;
+    if (key.size() > text->length) return 0;
+
+    // Compare against the key blank-padded to the column width, like the file stores it
+    std::string padded = key;
+    padded.resize(text->length, ' ');
+
+    const double* numbers = value->numbers.data();
+    const char* bytes = text->bytes.data();
+    size_t rows = RowCount();
+
+    double total = 0;
+    for (size_t row = 0; row < rows; ++row) {
+        if (memcmp(bytes + row * text->length, padded.data(), text->length) == 0) total += numbers[row];
+    }
+    return total;
+}
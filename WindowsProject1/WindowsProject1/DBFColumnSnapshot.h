@@ -0,0 +1,64 @@
+#ifndef DBF_COLUMN_SNAPSHOT_H
+#define DBF_COLUMN_SNAPSHOT_H
+
+#include "DBFManager.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only columnar copy of the live rows of a DBF table.
+// 'N'/'F' fields are parsed once into doubles, 'D' fields become YYYYMMDD
+// integers (0 when blank) and everything else is kept as a fixed-width
+// byte column, so report aggregates scan flat arrays instead of strings.
+class DBFColumnSnapshot {
+public:
+    struct Column {
+        std::string name;
+        char type;
+        unsigned char length;
+        unsigned char decimal;
+
+        std::vector<double> numbers;    // 'N' / 'F'
+        std::vector<int32_t> dates;     // 'D'
+        std::vector<char> bytes;        // 'C' and the rest, length bytes per row
+
+        bool isNumeric() const { return type == 'N' || type == 'F'; }
+        bool isDate() const { return type == 'D'; }
+
+        // Blank-trimmed text of a byte column
+        std::string_view text(size_t row) const;
+    };
+
+    // threads other than 1 parse the table on that many threads (0 = every
+    // core, see DBFParallelScan.h); the snapshot comes out the same
+    bool Build(DBFManager& table, unsigned threads = 1);
+    void Clear();
+
+    size_t RowCount() const { return positions.size(); }
+    long RowPosition(size_t row) const { return positions[row]; }
+    const Column* GetColumn(const std::string& name) const;
+
+    // sum <value> for <date> >= from .and. <date> <= to
+    double SumByDateRange(const std::string& valueColumn, const std::string& dateColumn,
+        int32_t from, int32_t to) const;
+
+    // sum <value> for <key> = key (trailing blanks ignored)
+    double SumByText(const std::string& valueColumn, const std::string& keyColumn,
+        const std::string& key) const;
+
+    double Sum(const std::string& valueColumn) const;
+
+    static int32_t ParseDate(const char* raw, size_t length);
+
+private:
+    std::vector<Column> columns;
+    std::vector<long> positions; // file offset of each snapshot row
+
+    void InitColumns(const std::vector<FIELD_DESCRIPTOR>& fields, unsigned rows);
+    void AppendBlock(const std::vector<FIELD_DESCRIPTOR>& fields, const char* block, unsigned count,
+        unsigned short record_size, long first_pos);
+    void Append(DBFColumnSnapshot& part);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "DBFCursor.h"
+#include "DBFSnapshot.h"
+#include <algorithm>
+
+DBFCursor::DBFCursor(DBFManager& source, unsigned batch_records)
+    : table(&source), fields(&source.GetFields()), header_size(source.GetHeaderSize()),
+      record_size(source.RecordSize()), batch(std::max(1u, batch_records)),
+      records(source.isOpen() ? source.RecordCount() : 0) {
+    failed = !source.isOpen();
+}
+
+DBFCursor::DBFCursor(DBFSnapshot& source, unsigned batch_records)
+    : snapshot(&source), fields(&source.GetFields()), header_size(source.GetHeaderSize()),
+      record_size(source.RecordSize()), batch(std::max(1u, batch_records)),
+      records(source.isOpen() ? source.RecordCount() : 0) {
+    failed = !source.isOpen();
+}
+
+size_t DBFCursor::FieldNumber(const std::string& fieldName) const {
+    for (size_t i = 0; i < fields->size(); ++i) {
+        if (_strnicmp((*fields)[i].name, fieldName.c_str(), sizeof((*fields)[i].name)) == 0) return i;
+    }
+    return fields->size();
+}
+
+bool DBFCursor::ReadBlock(unsigned first) {
+    unsigned count = std::min(batch, records - first);
+    block = table ? table->ReadRecordBlock(first, count, scratch)
+                  : snapshot->ReadRecordBlock(first, count, scratch);
+    if (!block) {
+        failed = true;
+        block_count = 0;
+        return false;
+    }
+    block_first = first;
+    block_count = count;
+    return true;
+}
+
+bool DBFCursor::Next() {
+    if (failed) return false;
+
+    // next_record is 1-based, so it is also the index of the record after it
+    for (unsigned index = next_record; index < records; ++index) {
+        if (index >= block_first + block_count && !ReadBlock(index)) return false;
+
+        const char* record = block + (size_t)(index - block_first) * record_size;
+        if (record[0] == '*') continue; // Skip deleted
+        next_record = index + 1;
+        current = DBFRecordView(record, fields);
+        return true;
+    }
+    next_record = records + 1;
+    return false;
+}
+
+void DBFCursor::Seek(unsigned first) {
+    block = nullptr;
+    block_first = block_count = 0;
+    next_record = std::min(first, records);
+    current = DBFRecordView();
+}
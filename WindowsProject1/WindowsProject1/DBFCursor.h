@@ -0,0 +1,93 @@
+#ifndef DBF_CURSOR_H
+#define DBF_CURSOR_H
+
+#include "DBFManager.h"
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Forward cursor over the live records of a table, in file order:
+//
+//     for (const DBFRecordView& row : DBFCursor(table)) { ... break; ... }
+//
+// Records are read one block of batch records at a time (a pointer into the
+// mapping when the table is mapped), so memory stays the same whatever the
+// table size, and a loop left early reads nothing past its last block.
+// Deleted rows are skipped. A view is only valid until the cursor moves on.
+//
+// Over a DBFManager the table must not be written while the cursor walks
+// it; over a DBFSnapshot it may be, and the cursor sees the snapshot.
+class DBFCursor {
+public:
+    static const unsigned DEFAULT_BATCH = 256; // records per block read
+
+    explicit DBFCursor(DBFManager& table, unsigned batch = DEFAULT_BATCH);
+    explicit DBFCursor(DBFSnapshot& snapshot, unsigned batch = DEFAULT_BATCH);
+
+    // Moves to the next live record; false at the end or on a read error
+    bool Next();
+    void Rewind() { Seek(0); }
+    // Next() continues at record index first (0-based), deleted or not
+    void Seek(unsigned first);
+
+    const DBFRecordView& Current() const { return current; }
+    unsigned Recno() const { return next_record; }
+    long Position() const { return header_size + (long)(next_record - 1) * record_size; }
+    // Set when a block could not be read; the walk stopped early
+    bool Failed() const { return failed; }
+
+    const std::vector<FIELD_DESCRIPTOR>& GetFields() const { return *fields; }
+    // Field number for DBFRecordView::field, GetFields().size() if absent
+    size_t FieldNumber(const std::string& fieldName) const;
+
+    class iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef DBFRecordView value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const DBFRecordView* pointer;
+        typedef const DBFRecordView& reference;
+
+        iterator() = default;
+        explicit iterator(DBFCursor* owner) : cursor(owner) {
+            if (cursor && !cursor->Next()) cursor = nullptr;
+        }
+
+        reference operator*() const { return cursor->Current(); }
+        pointer operator->() const { return &cursor->Current(); }
+        iterator& operator++() {
+            if (!cursor->Next()) cursor = nullptr;
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return cursor == other.cursor; }
+        bool operator!=(const iterator& other) const { return cursor != other.cursor; }
+
+    private:
+        DBFCursor* cursor = nullptr;
+    };
+
+    // Single pass: begin() continues from wherever the cursor stands
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+private:
+    DBFManager* table = nullptr;
+    DBFSnapshot* snapshot = nullptr;
+    const std::vector<FIELD_DESCRIPTOR>* fields;
+    unsigned short header_size;
+    unsigned short record_size;
+    unsigned batch;
+    unsigned records;          // record count when the cursor was made
+
+    std::vector<char> scratch;
+    const char* block = nullptr;
+    unsigned block_first = 0;  // record index of block[0]
+    unsigned block_count = 0;
+    unsigned next_record = 0;  // record number of Current(), 0 before the first
+    bool failed = false;
+    DBFRecordView current;
+
+    bool ReadBlock(unsigned first);
+};
+
+#endif
@@ -1,10 +1,22 @@
 #include "DBFManager.h"
+#include "DBFParallelScan.h"
+#include "DBFSnapshot.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 bool DBFManager::Open(const std::string& filepath) {
+	close();
 	filename = filepath;
 	dbf_file.open(filename, std::ios::binary | std::ios::in | std::ios::out);
 	if (!dbf_file) return false;
 
+	// A journal left by a crash means an unfinished transaction: undo it
+	if (!RecoverJournal()) {
+		dbf_file.close();
+		return false;
+	}
+
     //read header
 	dbf_file.read(reinterpret_cast<char*>(&header), sizeof(header));
 
@@ -14,51 +26,374 @@ bool DBFManager::Open(const std::string& filepath) {
 	dbf_file.read(reinterpret_cast<char*>(fields.data()), field_count * sizeof(FIELD_DESCRIPTOR));
 
 	UpdateFieldAddresses();
-	BuildIndices();
+	page_pool.Attach(&dbf_file, header.header_size);
+	page_pool.SetWriteBarrier([this] { return SyncJournal(); });
+	versions = std::make_shared<DBFVersionStore>(filename, header, fields);
+
+	// No eager index build: each field index is built by its first lookup
+	// and persistent indexes load on first use
+	field_indices.clear();
+	row_cache.Clear();
+	ForgetFreeSlots();
+
+	// Expression indexes follow the new field layout or go away
+	for (auto it = expression_indices.begin(); it != expression_indices.end();) {
+		ExpressionIndex& index = it->second;
+		index.keys.clear();
+		index.built = false;
+		if (index.expression.Compile(index.expression.GetSource(), fields)) ++it;
+		else it = expression_indices.erase(it);
+	}
 	return true;
 }
 
+void DBFManager::close() {
+    // An unfinished transaction never survives close
+    if (InJournal()) RollbackJournal();
+
+    if (dbf_file.is_open()) {
+        page_pool.Flush();
+        dbf_file.close();
+    }
+    page_pool.Detach();
+    versions.reset(); // snapshots still open keep their own reference
+    UnmapFile();
+
+    // Keep the registrations, drop the loaded trees
+    for (auto& index : persistent_indices) index.second.reset();
+    ForgetFreeSlots();
+}
+
+bool DBFManager::OpenMapped(const std::string& filepath) {
+    close();
+    filename = filepath;
+
+    map_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (map_file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(map_file, &size) || size.QuadPart < (LONGLONG)sizeof(DBF_HEADER)) {
+        UnmapFile();
+        return false;
+    }
+
+    map_handle = CreateFileMappingA(map_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!map_handle) {
+        UnmapFile();
+        return false;
+    }
+
+    mapped_data = static_cast<const char*>(MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0));
+    mapped_size = (size_t)size.QuadPart;
+    if (!mapped_data || !ReadHeader(mapped_data, mapped_size)) {
+        UnmapFile();
+        return false;
+    }
+    return true;
+}
+
+bool DBFManager::ReadHeader(const char* data, size_t size) {
+    memcpy(&header, data, sizeof(header));
+    if (header.header_size > size || header.header_size < sizeof(header) + 1 || header.record_size == 0)
+        return false;
+
+    int field_count = (header.header_size - sizeof(header) - 1) / sizeof(FIELD_DESCRIPTOR);
+    fields.resize(field_count);
+    memcpy(fields.data(), data + sizeof(header), field_count * sizeof(FIELD_DESCRIPTOR));
+    UpdateFieldAddresses();
+
+    // Never trust num_records past the end of a truncated file
+    size_t available = (size - header.header_size) / header.record_size;
+    mapped_records = (unsigned)std::min<size_t>(header.num_records, available);
+    return true;
+}
+
+void DBFManager::UnmapFile() {
+    if (mapped_data) UnmapViewOfFile(mapped_data);
+    if (map_handle) CloseHandle(map_handle);
+    if (map_file != INVALID_HANDLE_VALUE) CloseHandle(map_file);
+    mapped_data = nullptr;
+    map_handle = nullptr;
+    map_file = INVALID_HANDLE_VALUE;
+    mapped_size = 0;
+    mapped_records = 0;
+}
+
+bool DBFManager::GetRecordView(unsigned index, DBFRecordView& out) const {
+    if (!mapped_data || index >= mapped_records) return false;
+    out = DBFRecordView(mapped_data + header.header_size + (size_t)index * header.record_size, &fields);
+    return true;
+}
+
+const char* DBFManager::ReadRecordBlock(unsigned first, unsigned count, std::vector<char>& scratch) {
+    if (!isOpen() || count == 0 || first + count > RecordCount()) return nullptr;
+
+    size_t offset = header.header_size + (size_t)first * header.record_size;
+    if (isMapped()) return mapped_data + offset;
+
+    // Block reads go around the pool, picking up the writes it still holds
+    scratch.resize((size_t)count * header.record_size);
+    if (!page_pool.ReadThrough((long)offset, scratch.data(), scratch.size())) return nullptr;
+    return scratch.data();
+}
+
 void DBFManager::BuildIndices() {
     field_indices.clear();
-    position_to_fields.clear();
+    row_cache.Clear();
 
-    if (!dbf_file.is_open()) return;
+    if (!isOpen()) return;
+    row_cache.Reset(fields.size());
 
     // Initialize indices for all fields
+    std::vector<FieldIndex*> indexes;
     for (const auto& field : fields) {
-        field_indices[field.name] = FieldIndex();
+        FieldIndex& index = field_indices[field.name];
+        indexes.push_back(&index);
+        index.text_index.clear();
+        index.numeric_index.clear();
+        index.built = true;
+        index.builds++;
     }
 
-    dbf_file.seekg(header.header_size);
-    char* record = new char[header.record_size];
+    const unsigned batch = 1024;
+    std::vector<char> scratch;
+    for (unsigned first = 0; first < RecordCount(); first += batch) {
+        unsigned count = std::min(batch, RecordCount() - first);
+        const char* block = ReadRecordBlock(first, count, scratch);
+        if (!block) break;
 
-    for (unsigned i = 0; i < header.num_records; ++i) {
-        long pos = dbf_file.tellg();
-        dbf_file.read(record, header.record_size);
+        for (unsigned i = 0; i < count; ++i) {
+            const char* record = block + (size_t)i * header.record_size;
+            if (record[0] == '*') continue; // Skip deleted
 
-        if (record[0] == '*') continue; // Skip deleted
+            long pos = header.header_size + (long)(first + i) * header.record_size;
+            for (size_t f = 0; f < fields.size(); ++f) IndexRecord(*indexes[f], fields[f], record, pos);
+            row_cache.AddRow(pos, record, fields);
+        }
+    }
+    row_cache.ShrinkToFit();
+}
 
-        std::map<std::string, std::shared_ptr<DBFValue>> field_values;
+DBFManager::FieldIndex* DBFManager::EnsureFieldIndex(const FIELD_DESCRIPTOR& field) {
+    FieldIndex& index = field_indices[field.name];
+    if (index.built) return &index;
+
+    // Scan only this field's bytes; other columns are never decoded
+    index.text_index.clear();
+    index.numeric_index.clear();
+
+    const unsigned batch = 1024;
+    std::vector<char> scratch;
+    for (unsigned first = 0; first < RecordCount(); first += batch) {
+        unsigned count = std::min(batch, RecordCount() - first);
+        const char* block = ReadRecordBlock(first, count, scratch);
+        if (!block) return nullptr;
+
+        for (unsigned i = 0; i < count; ++i) {
+            const char* record = block + (size_t)i * header.record_size;
+            if (record[0] == '*') continue; // Skip deleted
+            IndexRecord(index, field, record, header.header_size + (long)(first + i) * header.record_size);
+        }
+    }
 
-        for (const auto& field : fields) {
-            std::string raw_value(record + field.address, field.length);
-            raw_value.erase(raw_value.find_last_not_of(" \t") + 1);
+    index.built = true;
+    index.builds++;
+    return &index;
+}
 
-            if (field.type == 'N' || field.type == 'F') {
-                double num_val = atof(raw_value.c_str());
-                field_values[field.name] = std::make_shared<DBFNumericValue>(num_val);
-                field_indices[field.name].numeric_index[num_val] = pos;
-            }
-            else {
-                field_values[field.name] = std::make_shared<DBFStringValue>(raw_value);
-                field_indices[field.name].text_index[raw_value] = pos;
-            }
+void DBFManager::IndexRecord(FieldIndex& index, const FIELD_DESCRIPTOR& field, const char* record, long pos) {
+    std::string value(record + field.address, field.length);
+    value.erase(value.find_last_not_of(" \t") + 1);
+
+    if (field.type == 'N' || field.type == 'F') index.numeric_index.emplace(atof(value.c_str()), pos);
+    else index.text_index.emplace(value, pos);
+}
+
+void DBFManager::UnindexField(FieldIndex& index, const FIELD_DESCRIPTOR& field, const char* record, long pos) {
+    std::string value(record + field.address, field.length);
+    value.erase(value.find_last_not_of(" \t") + 1);
+
+    // Drop only this row's entry among the duplicates
+    if (field.type == 'N' || field.type == 'F') {
+        auto range = index.numeric_index.equal_range(atof(value.c_str()));
+        for (auto entry = range.first; entry != range.second; ++entry) {
+            if (entry->second != pos) continue;
+            index.numeric_index.erase(entry);
+            break;
+        }
+    }
+    else {
+        auto range = index.text_index.equal_range(value);
+        for (auto entry = range.first; entry != range.second; ++entry) {
+            if (entry->second != pos) continue;
+            index.text_index.erase(entry);
+            break;
         }
+    }
+}
 
-        position_to_fields[pos] = field_values;
+void DBFManager::UnindexExpression(ExpressionIndex& index, const std::string& key, long pos) {
+    auto range = index.keys.equal_range(key);
+    for (auto entry = range.first; entry != range.second; ++entry) {
+        if (entry->second != pos) continue;
+        index.keys.erase(entry);
+        break;
     }
+}
 
-    delete[] record;
+void DBFManager::UnindexRecord(const char* record, long pos) {
+    for (const auto& field : fields) {
+        auto it = field_indices.find(field.name);
+        if (it == field_indices.end() || !it->second.built) continue;
+        UnindexField(it->second, field, record, pos);
+    }
+
+    std::string key;
+    for (auto& index : expression_indices) {
+        if (!index.second.built) continue;
+        index.second.expression.Extract(record, key);
+        UnindexExpression(index.second, key, pos);
+    }
+}
+
+void DBFManager::InvalidateFieldIndices() {
+    // Counters survive so GetIndexStats still shows which indexes get used
+    for (auto& index : field_indices) {
+        index.second.text_index.clear();
+        index.second.numeric_index.clear();
+        index.second.built = false;
+    }
+    for (auto& index : expression_indices) {
+        index.second.keys.clear();
+        index.second.built = false;
+    }
+    row_cache.Clear();
+}
+
+DBFManager::ExpressionIndex* DBFManager::EnsureExpressionIndex(const std::string& tag) {
+    auto it = expression_indices.find(tag);
+    if (it == expression_indices.end()) return nullptr;
+
+    ExpressionIndex& index = it->second;
+    if (index.built) {
+        index.lookups++;
+        return &index;
+    }
+
+    index.keys.clear();
+    const unsigned batch = 1024;
+    std::vector<char> scratch;
+    std::string key;
+    for (unsigned first = 0; first < RecordCount(); first += batch) {
+        unsigned count = std::min(batch, RecordCount() - first);
+        const char* block = ReadRecordBlock(first, count, scratch);
+        if (!block) return nullptr;
+
+        for (unsigned i = 0; i < count; ++i) {
+            const char* record = block + (size_t)i * header.record_size;
+            if (record[0] == '*') continue; // Skip deleted
+            index.expression.Extract(record, key);
+            index.keys.emplace(key, header.header_size + (long)(first + i) * header.record_size);
+        }
+    }
+
+    index.built = true;
+    index.builds++;
+    index.lookups++;
+    return &index;
+}
+
+bool DBFManager::AddExpressionIndex(const std::string& tag, const std::string& expression) {
+    if (!isOpen()) return false;
+
+    ExpressionIndex index;
+    if (!index.expression.Compile(expression, fields)) return false;
+    expression_indices[tag] = std::move(index);
+    return true;
+}
+
+bool DBFManager::FindExpression(const std::string& tag, const std::string& key, std::vector<long>& positions) {
+    positions.clear();
+    ExpressionIndex* index = EnsureExpressionIndex(tag);
+    if (!index || key.size() > index->expression.GetKeyLength()) return false;
+
+    std::string padded = key;
+    padded.resize(index->expression.GetKeyLength(), ' ');
+    auto range = index->keys.equal_range(padded);
+    for (auto it = range.first; it != range.second; ++it) positions.push_back(it->second);
+    return !positions.empty();
+}
+
+bool DBFManager::FindExpressionPrefix(const std::string& tag, const std::string& prefix, std::vector<long>& positions) {
+    positions.clear();
+    ExpressionIndex* index = EnsureExpressionIndex(tag);
+    if (!index || prefix.empty()) return false;
+
+    for (auto it = index->keys.lower_bound(prefix); it != index->keys.end(); ++it) {
+        if (it->first.compare(0, prefix.size(), prefix) != 0) break;
+        positions.push_back(it->second);
+    }
+    return !positions.empty();
+}
+
+bool DBFManager::FindExpressionRange(const std::string& tag, const std::string& low, const std::string& high,
+    std::vector<long>& positions) {
+    positions.clear();
+    ExpressionIndex* index = EnsureExpressionIndex(tag);
+    if (!index) return false;
+
+    std::string from = low, to = high;
+    from.resize(index->expression.GetKeyLength(), ' ');
+    to.resize(index->expression.GetKeyLength(), ' ');
+    if (from > to) return true;
+
+    auto last = index->keys.upper_bound(to);
+    for (auto it = index->keys.lower_bound(from); it != last; ++it) positions.push_back(it->second);
+    return true;
+}
+
+bool DBFManager::FindInFieldIndex(const FIELD_DESCRIPTOR& field, const std::string& text_key, double numeric_key, long& out_pos) {
+    FieldIndex* index = EnsureFieldIndex(field);
+    if (!index) return false;
+    index->lookups++;
+
+    if (field.type == 'N' || field.type == 'F') {
+        double key = std::isnan(numeric_key) ? atof(text_key.c_str()) : numeric_key;
+        auto it = index->numeric_index.lower_bound(key);
+        if (it == index->numeric_index.end() || it->first != key) return false;
+        out_pos = it->second;
+        return true;
+    }
+
+    std::string key = text_key;
+    if (key.empty() && !std::isnan(numeric_key)) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%g", numeric_key);
+        key = buffer;
+    }
+    key.erase(key.find_last_not_of(" \t") + 1);
+
+    auto it = index->text_index.lower_bound(key);
+    if (it == index->text_index.end() || it->first != key) return false;
+    out_pos = it->second;
+    return true;
+}
+
+std::vector<DBFManager::FieldIndexStats> DBFManager::GetIndexStats() const {
+    std::vector<FieldIndexStats> stats;
+    for (const auto& field : fields) {
+        auto it = field_indices.find(field.name);
+        if (it == field_indices.end()) {
+            stats.push_back({ field.name, false, 0, 0, 0 });
+            continue;
+        }
+
+        const FieldIndex& index = it->second;
+        size_t keys = index.text_index.size() + index.numeric_index.size();
+        stats.push_back({ field.name, index.built, keys, index.lookups, index.builds });
+    }
+    return stats;
 }
 
 void DBFManager::UpdateFieldAddresses() {
@@ -69,27 +404,20 @@ void DBFManager::UpdateFieldAddresses() {
 	}
 }
 
-// Helper method to get record position by either key type
+// Helper method to get record position by either key type (first field)
 bool DBFManager::GetRecordPosition(double numeric_key, const std::string& text_key, long& out_pos) {
-    // Try numeric index first if provided
-    if (!std::isnan(numeric_key)) {
-        auto num_it = numeric_index.find(numeric_key);
-        if (num_it != numeric_index.end()) {
-            out_pos = num_it->second;
-            return true;
-        }
-    }
-
-    // Fall back to text index if provided
-    if (!text_key.empty()) {
-        auto text_it = text_index.find(text_key);
-        if (text_it != text_index.end()) {
-            out_pos = text_it->second;
-            return true;
-        }
+    if (fields.empty()) return false;
+
+    // Key field backed by an on-disk index
+    if (HasPersistentIndex(fields[0].name)) {
+        std::vector<long> positions;
+        std::string key = !text_key.empty() ? text_key : std::to_string(numeric_key);
+        if (!FindByPersistentIndex(fields[0].name, key, positions)) return false;
+        out_pos = positions[0];
+        return true;
     }
 
-    return false;
+    return FindInFieldIndex(fields[0], text_key, numeric_key, out_pos);
 }
 
 // Public methods using the common helper
@@ -98,8 +426,7 @@ bool DBFManager::GetByTextKey(const std::string& key, std::vector<std::string>&
     if (!GetRecordPosition(std::numeric_limits<double>::quiet_NaN(), key, pos))
         return false;
 
-    dbf_file.seekg(pos);
-    return ReadCurrentRecord(out);
+    return ReadRecordAt(pos, out);
 }
 
 bool DBFManager::GetByNumericKey(double key, std::vector<std::string>& out) {
@@ -107,8 +434,284 @@ bool DBFManager::GetByNumericKey(double key, std::vector<std::string>& out) {
     if (!GetRecordPosition(key, "", pos))
         return false;
 
-    dbf_file.seekg(pos);
-    return ReadCurrentRecord(out);
+    return ReadRecordAt(pos, out);
+}
+
+bool DBFManager::OpenIndex(const std::string& tag, const std::string& idxpath) {
+    auto reader = std::make_unique<IDXReader>();
+    if (!reader->Open(idxpath)) return false;
+
+    idx_files[tag] = std::move(reader);
+    return true;
+}
+
+bool DBFManager::SeekIndex(const std::string& tag, const std::string& key, std::vector<std::string>& out) {
+    auto it = idx_files.find(tag);
+    if (it == idx_files.end()) return false;
+
+    unsigned recno;
+    if (!it->second->Seek(key, recno) || recno == 0 || recno > RecordCount())
+        return false;
+
+    return ReadRecordAt(PositionOfRecno(recno), out);
+}
+
+bool DBFManager::SeekIndexPrefix(const std::string& tag, const std::string& prefix, std::vector<long>& positions) {
+    positions.clear();
+    auto it = idx_files.find(tag);
+    if (it == idx_files.end()) return false;
+
+    std::vector<unsigned> recnos;
+    if (!it->second->SeekPrefix(prefix, recnos)) return false;
+
+    positions.reserve(recnos.size());
+    for (unsigned recno : recnos) {
+        if (recno > 0 && recno <= RecordCount())
+            positions.push_back(PositionOfRecno(recno));
+    }
+    return !positions.empty();
+}
+
+const FIELD_DESCRIPTOR* DBFManager::FindField(const std::string& fieldName) const {
+    for (const auto& field : fields) {
+        if (_strnicmp(field.name, fieldName.c_str(), sizeof(field.name)) == 0) return &field;
+    }
+    return nullptr;
+}
+
+std::string DBFManager::EncodeIndexKey(const FIELD_DESCRIPTOR& field, const char* raw) {
+    if (field.type == 'N' || field.type == 'F') {
+        std::string value(raw, field.length);
+        return IDXReader::EncodeNumericKey(atof(value.c_str()));
+    }
+    return std::string(raw, field.length);
+}
+
+bool DBFManager::AddPersistentIndex(const std::string& fieldName) {
+    if (fieldName.empty()) return false;
+    if (isOpen() && !FindField(fieldName)) return false;
+
+    persistent_indices.emplace(fieldName, nullptr);
+    return true;
+}
+
+BPlusTreeIndex* DBFManager::LoadPersistentIndex(const std::string& fieldName) {
+    auto it = persistent_indices.find(fieldName);
+    if (it == persistent_indices.end() || !isOpen()) return nullptr;
+    if (it->second) return it->second.get();
+
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field) return nullptr;
+
+    std::string path = filename + "." + fieldName + ".bpt";
+    unsigned short key_length = (field->type == 'N' || field->type == 'F') ? 8 : field->length;
+
+    auto tree = std::make_unique<BPlusTreeIndex>();
+    bool usable = tree->Open(path) && tree->GetKeyLength() == key_length &&
+        tree->IsSyncedWith(header.num_records, header.last_update, header.change_count);
+
+    if (!usable) {
+        // Missing, foreign or out of date: rebuild it once from the table
+        if (!tree->Create(path, key_length) || !RebuildPersistentIndex(*field, *tree)) return nullptr;
+    }
+    if (InJournal()) MarkTreeUnsynced(*tree);
+
+    it->second = std::move(tree);
+    return it->second.get();
+}
+
+bool DBFManager::RebuildPersistentIndex(const FIELD_DESCRIPTOR& field, BPlusTreeIndex& tree) {
+    std::vector<BPlusTreeIndex::Entry> entries;
+    entries.reserve(RecordCount());
+
+    const unsigned batch = 1024;
+    std::vector<char> scratch;
+    for (unsigned first = 0; first < RecordCount(); first += batch) {
+        unsigned count = std::min(batch, RecordCount() - first);
+        const char* block = ReadRecordBlock(first, count, scratch);
+        if (!block) return false;
+
+        for (unsigned i = 0; i < count; ++i) {
+            const char* record = block + (size_t)i * header.record_size;
+            if (record[0] == '*') continue; // Skip deleted
+            entries.push_back({ EncodeIndexKey(field, record + field.address), first + i + 1 });
+        }
+    }
+
+    return tree.BulkLoad(entries) && tree.SetSynced(header.num_records, header.last_update, header.change_count);
+}
+
+bool DBFManager::FindByPersistentIndex(const std::string& fieldName, const std::string& key, std::vector<long>& positions) {
+    positions.clear();
+    BPlusTreeIndex* tree = LoadPersistentIndex(fieldName);
+    if (!tree) return false;
+
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    std::string lookup = key;
+    if (field->type == 'N' || field->type == 'F')
+        lookup = IDXReader::EncodeNumericKey(atof(key.c_str()));
+
+    std::vector<unsigned> recnos;
+    if (!tree->Find(lookup, recnos)) return false;
+
+    for (unsigned recno : recnos) positions.push_back(PositionOfRecno(recno));
+    return true;
+}
+
+bool DBFManager::FindFirstByFieldKey(const std::string& fieldName, const std::string& key, long& out_pos) {
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field) return false;
+
+    if (HasPersistentIndex(fieldName)) {
+        std::vector<long> positions;
+        if (!FindByPersistentIndex(fieldName, key, positions)) return false;
+        out_pos = positions[0];
+        return true;
+    }
+    return FindInFieldIndex(*field, key, std::numeric_limits<double>::quiet_NaN(), out_pos);
+}
+
+bool DBFManager::GetByFieldKey(const std::string& fieldName, const std::string& key, std::vector<std::string>& out) {
+    long pos;
+    if (!FindFirstByFieldKey(fieldName, key, pos)) return false;
+    return ReadRecordAt(pos, out);
+}
+
+const char* DBFManager::GetRawByFieldKey(const std::string& fieldName, const std::string& key) {
+    long pos;
+    if (!FindFirstByFieldKey(fieldName, key, pos)) return nullptr;
+    if (isMapped()) return mapped_data + pos;
+
+    record_buffer.resize(header.record_size);
+    if (!ReadRawRecordAt(pos, record_buffer.data())) return nullptr;
+    return record_buffer.data();
+}
+
+bool DBFManager::DeleteByFieldKey(const std::string& fieldName, const std::string& key) {
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field) return false;
+
+    long pos;
+    if (HasPersistentIndex(fieldName)) {
+        std::vector<long> positions;
+        if (!FindByPersistentIndex(fieldName, key, positions)) return false;
+        pos = positions[0];
+    }
+    else if (!FindInFieldIndex(*field, key, std::numeric_limits<double>::quiet_NaN(), pos)) {
+        return false;
+    }
+
+    return DeleteRecordAtPosition(pos);
+}
+
+bool DBFManager::FindAll(const std::string& fieldName, const std::string& key, std::vector<long>& positions) {
+    positions.clear();
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field) return false;
+
+    if (HasPersistentIndex(fieldName)) return FindByPersistentIndex(fieldName, key, positions);
+
+    FieldIndex* index = EnsureFieldIndex(*field);
+    if (!index) return false;
+    index->lookups++;
+
+    if (field->type == 'N' || field->type == 'F') {
+        auto range = index->numeric_index.equal_range(atof(key.c_str()));
+        for (auto it = range.first; it != range.second; ++it) positions.push_back(it->second);
+    }
+    else {
+        std::string trimmed = key;
+        trimmed.erase(trimmed.find_last_not_of(" \t") + 1);
+        auto range = index->text_index.equal_range(trimmed);
+        for (auto it = range.first; it != range.second; ++it) positions.push_back(it->second);
+    }
+    return !positions.empty();
+}
+
+bool DBFManager::FindRange(const std::string& fieldName, const std::string& low, const std::string& high,
+    std::vector<long>& positions) {
+    positions.clear();
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field) return false;
+    bool numeric = field->type == 'N' || field->type == 'F';
+
+    if (HasPersistentIndex(fieldName)) {
+        BPlusTreeIndex* tree = LoadPersistentIndex(fieldName);
+        std::vector<unsigned> recnos;
+        if (!tree) return false;
+
+        bool found = numeric
+            ? tree->FindRange(IDXReader::EncodeNumericKey(atof(low.c_str())), IDXReader::EncodeNumericKey(atof(high.c_str())), recnos)
+            : tree->FindRange(low, high, recnos);
+        for (unsigned recno : recnos) positions.push_back(PositionOfRecno(recno));
+        return found;
+    }
+
+    FieldIndex* index = EnsureFieldIndex(*field);
+    if (!index) return false;
+    index->lookups++;
+
+    if (numeric) {
+        // A reversed range would walk from low to the end of the index
+        if (atof(low.c_str()) > atof(high.c_str())) return false;
+
+        auto first = index->numeric_index.lower_bound(atof(low.c_str()));
+        auto last = index->numeric_index.upper_bound(atof(high.c_str()));
+        for (auto it = first; it != last; ++it) positions.push_back(it->second);
+    }
+    else {
+        std::string from = low, to = high;
+        from.erase(from.find_last_not_of(" \t") + 1);
+        to.erase(to.find_last_not_of(" \t") + 1);
+        if (from > to) return false;
+
+        auto first = index->text_index.lower_bound(from);
+        auto last = index->text_index.upper_bound(to);
+        for (auto it = first; it != last; ++it) positions.push_back(it->second);
+    }
+    return !positions.empty();
+}
+
+bool DBFManager::FindPrefix(const std::string& fieldName, const std::string& prefix, std::vector<long>& positions) {
+    positions.clear();
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field || field->type == 'N' || field->type == 'F' || prefix.empty()) return false;
+
+    if (HasPersistentIndex(fieldName)) {
+        BPlusTreeIndex* tree = LoadPersistentIndex(fieldName);
+        std::vector<unsigned> recnos;
+        if (!tree || !tree->FindPrefix(prefix, recnos)) return false;
+
+        for (unsigned recno : recnos) positions.push_back(PositionOfRecno(recno));
+        return true;
+    }
+
+    FieldIndex* index = EnsureFieldIndex(*field);
+    if (!index) return false;
+    index->lookups++;
+
+    for (auto it = index->text_index.lower_bound(prefix); it != index->text_index.end(); ++it) {
+        if (it->first.compare(0, prefix.size(), prefix) != 0) break;
+        positions.push_back(it->second);
+    }
+    return !positions.empty();
+}
+
+bool DBFManager::PrepareIndex(const std::string& fieldName) {
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field) return false;
+    if (HasPersistentIndex(fieldName)) return LoadPersistentIndex(fieldName) != nullptr;
+    return EnsureFieldIndex(*field) != nullptr;
+}
+
+bool DBFManager::ReadRawRecordAt(long pos, char* record) {
+    if (isMapped()) {
+        if ((size_t)pos + header.record_size > mapped_size) return false;
+        memcpy(record, mapped_data + pos, header.record_size);
+        return true;
+    }
+
+    return page_pool.Read(pos, record, header.record_size);
 }
 
 bool DBFManager::DeleteRecordByTextKey(const std::string& key) {
@@ -116,7 +719,7 @@ bool DBFManager::DeleteRecordByTextKey(const std::string& key) {
     if (!GetRecordPosition(std::numeric_limits<double>::quiet_NaN(), key, pos))
         return false;
 
-    return DeleteRecordAtPosition(pos, key, atof(key.c_str()));
+    return DeleteRecordAtPosition(pos);
 }
 
 bool DBFManager::DeleteRecordByNumericKey(double key) {
@@ -124,60 +727,399 @@ bool DBFManager::DeleteRecordByNumericKey(double key) {
     if (!GetRecordPosition(key, "", pos))
         return false;
 
-    // Need to get text key for full deletion
-    auto pos_it = position_to_key_map.find(pos);
-    std::string text_key = (pos_it != position_to_key_map.end()) ? pos_it->second.first : "";
-
-    return DeleteRecordAtPosition(pos, text_key, key);
+    return DeleteRecordAtPosition(pos);
 }
 
 // Common deletion method
-bool DBFManager::DeleteRecordAtPosition(long pos, const std::string& text_key, double numeric_key) {
+bool DBFManager::DeleteRecordAtPosition(long pos) {
+    if (isMapped()) return false; // mapping is read-only
+
+    // The row's keys are needed to take it out of every index
+    record_buffer.resize(header.record_size);
+    if (!ReadRawRecordAt(pos, record_buffer.data()) || record_buffer[0] == '*') return false;
+    if (!KeepBeforeImage(pos, record_buffer.data())) return false;
+
+    for (const auto& index : persistent_indices) {
+        BPlusTreeIndex* tree = LoadPersistentIndex(index.first);
+        if (!tree) continue;
+        const FIELD_DESCRIPTOR* field = FindField(index.first);
+        UnsyncTree(*tree);
+        tree->Erase(EncodeIndexKey(*field, record_buffer.data() + field->address), RecnoOfPosition(pos));
+    }
+    UnindexRecord(record_buffer.data(), pos);
+
     // Mark record as deleted
-    dbf_file.seekp(pos);
     const char delete_flag = '*';
-    dbf_file.write(&delete_flag, 1);
-    dbf_file.flush();
+    header.rewrite_count++;
+    if (!page_pool.Write(pos, &delete_flag, 1) || !FinishWrite()) return false;
+
+    row_cache.Erase(pos);
+    if (free_slots_scanned) free_slots.insert(pos);
+    return StampTrees();
+}
 
-    // Update all indices
-    if (!text_key.empty())
-        text_index.erase(text_key);
+bool DBFManager::UpdateByFieldKey(const std::string& fieldName, const std::string& key,
+    const std::map<std::string, std::string>& values) {
+    long pos;
+    if (isMapped() || !FindFirstByFieldKey(fieldName, key, pos)) return false;
+
+    record_buffer.resize(header.record_size);
+    if (!ReadRawRecordAt(pos, record_buffer.data()) || record_buffer[0] == '*') return false;
+
+    // Unnamed fields keep their stored bytes
+    std::vector<char> updated(record_buffer);
+    for (const auto& value : values) {
+        const FIELD_DESCRIPTOR* field = FindField(value.first);
+        if (!field) return false;
+        size_t n = std::min<size_t>(value.second.size(), field->length);
+        memcpy(updated.data() + field->address, value.second.data(), n);
+        memset(updated.data() + field->address + n, ' ', field->length - n);
+    }
+    return UpdateRecordAtPosition(pos, record_buffer.data(), updated.data());
+}
 
-    if (!std::isnan(numeric_key))
-        numeric_index.erase(numeric_key);
+bool DBFManager::UpdateRawByFieldKey(const std::string& fieldName, const std::string& key, const char* record) {
+    long pos;
+    if (isMapped() || !FindFirstByFieldKey(fieldName, key, pos)) return false;
 
-    position_to_key_map.erase(pos);
-    return true;
+    record_buffer.resize(header.record_size);
+    if (!ReadRawRecordAt(pos, record_buffer.data()) || record_buffer[0] == '*') return false;
+    return UpdateRecordAtPosition(pos, record_buffer.data(), record);
 }
 
-bool DBFManager::AddRecord(const std::vector<std::string>& values) {
-    if (values.size() != fields.size()) return false;
+// Rewrites the live slot at pos from before to after. Only the byte span of
+// the fields that differ is written, and only indexes over those fields are
+// patched; the row keeps its position and record number.
+bool DBFManager::UpdateRecordAtPosition(long pos, const char* before, const char* after) {
+    std::vector<bool> changed(fields.size(), false);
+    unsigned first_byte = header.record_size, end_byte = 0;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        const FIELD_DESCRIPTOR& field = fields[i];
+        if (memcmp(before + field.address, after + field.address, field.length) == 0) continue;
+        changed[i] = true;
+        first_byte = std::min<unsigned>(first_byte, field.address);
+        end_byte = std::max<unsigned>(end_byte, field.address + field.length);
+    }
+    if (end_byte == 0) return true; // nothing to write
 
-    dbf_file.seekp(0, std::ios::end);
-    long pos = dbf_file.tellp();
+    if (!KeepBeforeImage(pos, before)) return false;
+    // Every tree is restamped after the write, so each is checked against
+    // the stamp it was built for while that is still the header's
+    for (auto& index : persistent_indices) LoadPersistentIndex(index.first);
 
-    //write deletion flag
-    char flag = ' ';
-    dbf_file.write(&flag, 1);
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (!changed[i]) continue;
+        const FIELD_DESCRIPTOR& field = fields[i];
 
-    //write fields
+        auto it = field_indices.find(field.name);
+        if (it != field_indices.end() && it->second.built) {
+            UnindexField(it->second, field, before, pos);
+            IndexRecord(it->second, field, after, pos);
+        }
+
+        if (HasPersistentIndex(field.name)) {
+            BPlusTreeIndex* tree = LoadPersistentIndex(field.name);
+            if (tree) {
+                unsigned recno = RecnoOfPosition(pos);
+                UnsyncTree(*tree);
+                tree->Erase(EncodeIndexKey(field, before + field.address), recno);
+                tree->Insert(EncodeIndexKey(field, after + field.address), recno);
+            }
+        }
+    }
+
+    std::string old_key, new_key;
+    for (auto& index : expression_indices) {
+        if (!index.second.built) continue;
+        index.second.expression.Extract(before, old_key);
+        index.second.expression.Extract(after, new_key);
+        if (old_key == new_key) continue;
+        UnindexExpression(index.second, old_key, pos);
+        index.second.keys.emplace(new_key, pos);
+    }
+
+    header.rewrite_count++;
+    if (!page_pool.Write(pos + first_byte, after + first_byte, end_byte - first_byte) || !FinishWrite())
+        return false;
+
+    row_cache.UpdateRow(pos, after, fields);
+    return StampTrees();
+}
+
+bool DBFManager::AddRecord(const std::vector<std::string>& values) {
+    if (isMapped() || values.size() != fields.size()) return false;
+
+    //build the record
+    record_buffer.assign(header.record_size, ' ');
     for (size_t i = 0; i < fields.size(); i++) {
-        std::string value = values[i];
-        value.resize(fields[i].length, ' ');
-        dbf_file.write(value.c_str(), fields[i].length);
+        memcpy(record_buffer.data() + fields[i].address, values[i].data(),
+            std::min<size_t>(values[i].size(), fields[i].length));
+    }
+    return AppendRecords(record_buffer.data(), 1);
+}
+
+bool DBFManager::AddRecords(const std::vector<std::vector<std::string>>& rows) {
+    if (isMapped() || !isOpen()) return false;
+
+    // Format every row into one buffer, then append them in one go
+    std::vector<char> records(rows.size() * header.record_size, ' ');
+    char* record = records.data();
+    for (const auto& values : rows) {
+        if (values.size() != fields.size()) return false;
+        for (size_t i = 0; i < fields.size(); i++) {
+            memcpy(record + fields[i].address, values[i].data(),
+                std::min<size_t>(values[i].size(), fields[i].length));
+        }
+        record += header.record_size;
+    }
+    return AppendRecords(records.data(), rows.size());
+}
+
+bool DBFManager::AddRawRecord(const char* record) {
+    return AddRawRecords(record, 1);
+}
+
+bool DBFManager::AddRawRecords(const char* records, size_t count) {
+    if (isMapped() || !isOpen()) return false;
+    if (count == 0) return true;
+
+    return AppendRecords(records, count);
+}
+
+// Appends count consecutive records with one write and one header update,
+// then brings every index up to date. With slot reuse on, the first records
+// refill deleted slots instead.
+bool DBFManager::AppendRecords(const char* records, size_t count) {
+    size_t reused = 0;
+    if (reuse_deleted_slots) {
+        if (!free_slots_scanned) ScanFreeSlots();
+        reused = std::min(count, free_slots.size());
+    }
+
+    // Inserting a large batch page by page costs more than one rebuild, so
+    // such batches just leave the trees stale for their next use (the record
+    // count changes, so they are seen as stale).
+    // Otherwise trees are loaded (and validated) against the pre-append header.
+    bool rebuild_trees = count - reused > BULK_TREE_REBUILD;
+    for (auto& index : persistent_indices) {
+        if (rebuild_trees) index.second.reset();
+        else LoadPersistentIndex(index.first);
+    }
+
+    for (size_t i = 0; i < reused; ++i) {
+        if (!FillSlot(*free_slots.begin(), records)) return false;
+        records += header.record_size;
     }
+    count -= reused;
+    if (count == 0) return true;
+
+    // A compaction may have cut the table short under an older snapshot:
+    // slots past the end it still reads are kept before being reused
+    unsigned visible = versions ? std::min<unsigned>(versions->VisibleRecords(), header.num_records + (unsigned)count) : 0;
+    std::vector<char> before(header.record_size);
+    for (unsigned recno = header.num_records + 1; recno <= visible; ++recno) {
+        long pos = PositionOfRecno(recno);
+        if (!ReadRawRecordAt(pos, before.data()) || !KeepBeforeImage(pos, before.data())) return false;
+    }
+
+    // Append right after the last record, overwriting any 0x1A end marker.
+    // One direct write; pooled pages over the old tail are dropped first.
+    long first_pos = PositionOfRecno(header.num_records + 1);
+    if (!page_pool.ReleaseFrom(first_pos) || !SyncJournal()) return false;
+    dbf_file.clear();
+    dbf_file.seekp(first_pos);
+    dbf_file.write(records, (std::streamsize)count * header.record_size);
     dbf_file.flush();
+    if (!dbf_file) return false;
+
+    //update the field indexes that have been built so far
+    std::vector<std::pair<const FIELD_DESCRIPTOR*, FieldIndex*>> built;
+    for (const auto& field : fields) {
+        auto it = field_indices.find(field.name);
+        if (it != field_indices.end() && it->second.built) built.emplace_back(&field, &it->second);
+    }
+    std::string key;
+    for (size_t i = 0; i < count; ++i) {
+        const char* record = records + i * header.record_size;
+        long pos = first_pos + (long)i * header.record_size;
+
+        for (const auto& index : built) IndexRecord(*index.second, *index.first, record, pos);
+        for (auto& index : expression_indices) {
+            if (!index.second.built) continue;
+            index.second.expression.Extract(record, key);
+            index.second.keys.emplace(key, pos);
+        }
+        row_cache.UpdateRow(pos, record, fields);
+    }
+
+    unsigned first_recno = header.num_records + 1;
+    header.num_records += (unsigned)count;
+    if (!UpdateHeader()) return false;
 
-    //update indices
-    text_index[values[0]] = pos;
-    numeric_index[atof(values[0].c_str())] = pos;
-    position_to_key_map[pos] = { values[0], atof(values[0].c_str()) };
+    for (auto& index : persistent_indices) {
+        if (!index.second) continue;
+        const FIELD_DESCRIPTOR* field = FindField(index.first);
+        for (size_t i = 0; i < count; ++i) {
+            const char* record = records + i * header.record_size;
+            index.second->Insert(EncodeIndexKey(*field, record + field->address), first_recno + (unsigned)i);
+        }
+    }
+    if (!StampTrees()) return false;
+    if (!InJournal()) PublishVersion();
+    return true;
+}
+
+bool DBFManager::KeepBeforeImage(long pos, const char* before) {
+    if (!JournalSlot(pos, before)) return false;
+    if (versions) versions->Retain(pos, before);
+    return true;
+}
 
-    header.num_records++;
-    UpdateHeader();
+bool DBFManager::FinishWrite() {
+    if (InJournal()) return UpdateHeader();
+    if (!page_pool.Flush() || !UpdateHeader()) return false;
+    PublishVersion();
     return true;
 }
 
+void DBFManager::PublishVersion() {
+    if (versions) versions->Publish(header.num_records, header.rewrite_count);
+}
+
+std::shared_ptr<DBFSnapshot> DBFManager::OpenSnapshot() const {
+    if (!versions) return nullptr;
+    auto snapshot = std::make_shared<DBFSnapshot>(versions);
+    return snapshot->isOpen() ? snapshot : nullptr;
+}
+
+void DBFManager::ScanFreeSlots() {
+    free_slots.clear();
+
+    const unsigned batch = 1024;
+    std::vector<char> scratch;
+    for (unsigned first = 0; first < RecordCount(); first += batch) {
+        unsigned count = std::min(batch, RecordCount() - first);
+        const char* block = ReadRecordBlock(first, count, scratch);
+        if (!block) return; // stays unscanned
+
+        for (unsigned i = 0; i < count; ++i) {
+            if (block[(size_t)i * header.record_size] == '*') free_slots.insert(PositionOfRecno(first + i + 1));
+        }
+    }
+    free_slots_scanned = true;
+}
+
+size_t DBFManager::FreeSlotCount() {
+    if (!free_slots_scanned && isOpen()) ScanFreeSlots();
+    return free_slots.size();
+}
+
+// Writes a live record into the deleted slot at pos and indexes it there.
+// Persistent trees are updated only if loaded; callers load them first.
+bool DBFManager::FillSlot(long pos, const char* record) {
+    std::vector<char> before(header.record_size);
+    if (!ReadRawRecordAt(pos, before.data()) || before[0] != '*') return false;
+    if (!KeepBeforeImage(pos, before.data())) return false;
+
+    for (auto& index : persistent_indices) {
+        if (index.second) UnsyncTree(*index.second);
+    }
+    header.rewrite_count++;
+    if (!page_pool.Write(pos, record, header.record_size) || !FinishWrite()) return false;
+    free_slots.erase(pos);
+
+    for (const auto& field : fields) {
+        auto it = field_indices.find(field.name);
+        if (it != field_indices.end() && it->second.built) IndexRecord(it->second, field, record, pos);
+    }
+    std::string key;
+    for (auto& index : expression_indices) {
+        if (!index.second.built) continue;
+        index.second.expression.Extract(record, key);
+        index.second.keys.emplace(key, pos);
+    }
+    for (auto& index : persistent_indices) {
+        if (!index.second) continue;
+        const FIELD_DESCRIPTOR* field = FindField(index.first);
+        index.second->Insert(EncodeIndexKey(*field, record + field->address), RecnoOfPosition(pos));
+    }
+
+    row_cache.UpdateRow(pos, record, fields);
+    return StampTrees();
+}
+
+bool DBFManager::CompactStep(unsigned max_moves, bool& done) {
+    done = false;
+    if (isMapped() || !isOpen() || InJournal()) return false;
+    if (!free_slots_scanned) ScanFreeSlots();
+    if (!free_slots_scanned) return false;
+
+    // Moves touch every tree, so all of them are loaded up front
+    for (auto& index : persistent_indices) LoadPersistentIndex(index.first);
+    if (!BeginJournal()) return false;
+
+    std::vector<char> moving(header.record_size);
+    unsigned moves = 0;
+    bool ok = true;
+    while (ok) {
+        // Deleted rows at the end just drop off the record count
+        while (!free_slots.empty() && *free_slots.rbegin() == PositionOfRecno(header.num_records)) {
+            free_slots.erase(std::prev(free_slots.end()));
+            header.num_records--;
+        }
+        if (free_slots.empty() || moves == max_moves) break;
+
+        // The first live row past the lowest hole slides down into it. Only
+        // holes lie between the two, so rows keep their order in the file,
+        // which FIFO costing and other readers in file order rely on.
+        long to = *free_slots.begin();
+        long from = to + header.record_size;
+        while (free_slots.count(from)) from += header.record_size;
+        ok = ReadRawRecordAt(from, moving.data()) && FillSlot(to, moving.data()) &&
+            DeleteRecordAtPosition(from);
+        moves++;
+    }
+
+    if (ok) {
+        ok = UpdateHeader();
+        dbf_file.flush();
+        ok = ok && (bool)dbf_file;
+    }
+    if (!ok) {
+        RollbackJournal();
+        return false;
+    }
+    if (!CommitJournal()) return false;
+
+    done = free_slots.empty();
+    // Only once committed is the dropped tail cut off
+    return TruncateToRecords();
+}
+
+// Cuts the file right after the last record and restores the 0x1A end marker
+bool DBFManager::TruncateToRecords() {
+    // Older snapshots may still read the dropped tail; leave it for now
+    if (versions && versions->HasReaders()) return true;
+
+    long end = PositionOfRecno(header.num_records + 1);
+    const char eof_marker = 0x1A;
+    if (!page_pool.ReleaseFrom(end)) return false;
+    dbf_file.clear();
+    dbf_file.seekp(end);
+    dbf_file.write(&eof_marker, 1);
+    dbf_file.flush();
+    if (!dbf_file) return false;
+
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    size.QuadPart = end + 1;
+    bool truncated = SetFilePointerEx(file, size, nullptr, FILE_BEGIN) && SetEndOfFile(file);
+    CloseHandle(file);
+    return truncated;
+}
+
 bool DBFManager::CreateNew(const std::string& filepath, const std::vector<FIELD_DESCRIPTOR>& new_fields) {
     filename = filepath;
     dbf_file.open(filename, std::ios::binary | std::ios::out);
@@ -215,39 +1157,267 @@ bool DBFManager::DeleteFile() {
 
     if (remove(filename.c_str()) != 0) return false;
 
+    // The table's trees go with it; a new table of the same name starts bare
+    for (const auto& index : persistent_indices) remove((filename + "." + index.first + ".bpt").c_str());
+    persistent_indices.clear();
+
     filename.clear();
     memset(&header, 0, sizeof(header));
     fields.clear();
-    text_index.clear();
-    numeric_index.clear();
+    field_indices.clear();
+    expression_indices.clear();
+    row_cache.Clear();
+    versions.reset();
+    ForgetFreeSlots();
+    return true;
 }
 
-void DBFManager::UpdateHeader() {
-    dbf_file.seekp(0);
-    dbf_file.write(reinterpret_cast<char*>(&header), sizeof(header));
+namespace {
+    const char JOURNAL_MAGIC[8] = "DBFJNL1";
+    // Stamp no table can have: a tree carrying it is rebuilt on next load
+    const unsigned UNSYNCED_RECORDS = 0xFFFFFFFFu;
 }
 
-bool DBFManager::ReadCurrentRecord(std::vector<std::string>& out) {
-    out.clear();
-    char* record = new char[header.record_size];
-    dbf_file.read(record, header.record_size);
+void DBFManager::MarkTreeUnsynced(BPlusTreeIndex& tree) {
+    const unsigned char never[3] = { 0, 0, 0 };
+    tree.SetSynced(UNSYNCED_RECORDS, never, 0);
+}
+
+bool DBFManager::StampTrees() {
+    if (InJournal()) return true; // CommitJournal stamps them
+
+    bool ok = true;
+    for (auto& index : persistent_indices) {
+        if (index.second) ok = index.second->SetSynced(header.num_records, header.last_update, header.change_count) && ok;
+    }
+    return ok;
+}
 
-    if (dbf_file.gcount() != header.record_size) {
-        delete[] record;
+bool DBFManager::BeginJournal(const std::string& masterJournal) {
+    if (!dbf_file.is_open() || InJournal()) return false;
+
+    journal_file.open(filename + ".jnl", std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    if (!journal_file.is_open()) return false;
+
+    uint16_t master_length = (uint16_t)masterJournal.size();
+    journal_file.write(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    journal_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    journal_file.write(reinterpret_cast<const char*>(&master_length), sizeof(master_length));
+    journal_file.write(masterJournal.data(), master_length);
+    journal_file.flush();
+    if (!journal_file) {
+        journal_file.close();
+        remove((filename + ".jnl").c_str());
         return false;
     }
+    journaled_slots.clear();
+    journal_unsynced = true;
+
+    // Trees change along with the table; until commit they must not look current
+    for (auto& index : persistent_indices) {
+        if (index.second) MarkTreeUnsynced(*index.second);
+    }
+    return true;
+}
+
+bool DBFManager::JournalSlot(long pos, const char* before) {
+    if (!InJournal() || !journaled_slots.insert(pos).second) return true;
+
+    int32_t offset = (int32_t)pos;
+    uint16_t length = header.record_size;
+    journal_file.clear();
+    journal_file.seekp(0, std::ios::end);
+    journal_file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    journal_file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    journal_file.write(before, length);
+    journal_file.flush();
+    journal_unsynced = true;
+    return (bool)journal_file;
+}
+
+// Before-images reach the disk before any byte they protect can
+bool DBFManager::SyncJournal() {
+    if (!InJournal() || !journal_unsynced) return true;
+
+    journal_file.flush();
+    if (!journal_file || !SyncFile(filename + ".jnl")) return false;
+    journal_unsynced = false;
+    return true;
+}
+
+bool DBFManager::CommitJournal() {
+    if (!InJournal()) return false;
+
+    // Pages held back during the transaction reach the table first
+    if (!page_pool.Flush()) return false;
+
+    // Removing the journal is the commit point
+    journal_file.close();
+    journaled_slots.clear();
+    if (remove((filename + ".jnl").c_str()) != 0) return false;
+
+    for (auto& index : persistent_indices) {
+        if (index.second) index.second->SetSynced(header.num_records, header.last_update, header.change_count);
+    }
+    PublishVersion();
+    return true;
+}
+
+bool DBFManager::Sync() {
+    if (!dbf_file.is_open()) return false;
+    if (!SyncJournal() || !page_pool.Flush()) return false;
+    return SyncFile(filename);
+}
+
+// fstream only reaches the OS cache; flush that through a second handle
+bool DBFManager::SyncFile(const std::string& path) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    bool synced = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+    return synced;
+}
+
+bool DBFManager::RollbackJournal() {
+    if (!InJournal()) return false;
+
+    // Dirty pages only hold this transaction's writes: they are just dropped
+    page_pool.Discard();
+    dbf_file.flush();
+    bool restored = ApplyJournal(journal_file) && SyncFile(filename);
+    journal_file.close();
+    journaled_slots.clear();
+    if (!restored) return false; // keep the journal for recovery at next Open
+    remove((filename + ".jnl").c_str());
+
+    // Header and rows are back as they were; everything derived is rebuilt
+    dbf_file.clear();
+    dbf_file.seekg(0);
+    dbf_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    for (auto& index : persistent_indices) index.second.reset();
+    InvalidateFieldIndices();
+    ForgetFreeSlots();
+    PublishVersion();
+    return true;
+}
+
+bool DBFManager::RecoverJournal() {
+    std::fstream journal(filename + ".jnl", std::ios::binary | std::ios::in);
+    if (!journal.is_open()) return true;
+
+    // Part of a multi-table transaction whose master is gone: it committed
+    DBF_HEADER saved;
+    std::string master;
+    bool committed = ReadJournalHeader(journal, saved, master) && !master.empty() &&
+        !std::ifstream(master).is_open();
+
+    // The restored table is on the disk before the journal goes
+    bool restored = committed || (ApplyJournal(journal) && SyncFile(filename));
+    journal.close();
+
+    // Open reads the header next
+    dbf_file.clear();
+    dbf_file.seekg(0);
+    return restored && remove((filename + ".jnl").c_str()) == 0;
+}
+
+// Writes the before-images and the saved header back into the table. A
+// torn last entry was never followed by its data write, so it is skipped.
+bool DBFManager::ReadJournalHeader(std::fstream& journal, DBF_HEADER& saved, std::string& master) {
+    char magic[sizeof(JOURNAL_MAGIC)];
+    uint16_t master_length = 0;
+    journal.clear();
+    journal.seekg(0);
+    journal.read(magic, sizeof(magic));
+    journal.read(reinterpret_cast<char*>(&saved), sizeof(saved));
+    journal.read(reinterpret_cast<char*>(&master_length), sizeof(master_length));
+    if (!journal || memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0) return false;
+
+    master.resize(master_length);
+    journal.read(&master[0], master_length);
+    return (bool)journal;
+}
+
+bool DBFManager::ApplyJournal(std::fstream& journal) {
+    DBF_HEADER saved;
+    std::string master;
+    if (!ReadJournalHeader(journal, saved, master))
+        return true; // torn at BeginJournal, before any change to the table
+
+    std::vector<char> image;
+    for (;;) {
+        int32_t offset;
+        uint16_t length;
+        journal.read(reinterpret_cast<char*>(&offset), sizeof(offset));
+        journal.read(reinterpret_cast<char*>(&length), sizeof(length));
+        if (!journal) break;
+
+        image.resize(length);
+        journal.read(image.data(), length);
+        if (!journal) break;
+
+        dbf_file.clear();
+        dbf_file.seekp(offset);
+        dbf_file.write(image.data(), length);
+    }
+
+    // Rows appended since begin fall outside the restored count
+    dbf_file.clear();
+    dbf_file.seekp(0);
+    dbf_file.write(reinterpret_cast<const char*>(&saved), sizeof(saved));
+    dbf_file.flush();
+    return (bool)dbf_file;
+}
+
+void DBFManager::StampHeader() {
+    SYSTEMTIME today;
+    GetLocalTime(&today);
+    header.last_update[0] = (unsigned char)(today.wYear - 1900);
+    header.last_update[1] = (unsigned char)today.wMonth;
+    header.last_update[2] = (unsigned char)today.wDay;
+    header.change_count++;
+}
+
+bool DBFManager::UpdateHeader() {
+    if (!SyncJournal()) return false;
+
+    StampHeader();
+    dbf_file.clear();
+    dbf_file.seekp(0);
+    dbf_file.write(reinterpret_cast<char*>(&header), sizeof(header));
+    dbf_file.flush();
+    return (bool)dbf_file;
+}
+
+bool DBFManager::ReadRecordAt(long pos, std::vector<std::string>& out) {
+    if (isMapped()) {
+        out.clear();
+        if (pos < header.header_size || (size_t)pos + header.record_size > mapped_size) return false;
+        DecodeRecord(mapped_data + pos, out);
+        return true;
+    }
+
+    out.clear();
+    record_buffer.resize(header.record_size);
+    if (!ReadRawRecordAt(pos, record_buffer.data())) return false;
+    DecodeRecord(record_buffer.data(), out);
+    return true;
+}
 
+void DBFManager::DecodeRecord(const char* record, std::vector<std::string>& out) const {
+    out.reserve(fields.size());
     for (const auto& field : fields) {
         std::string value(record + field.address, field.length);
         value.erase(value.find_last_not_of(" \t") + 1);
         out.push_back(value);
     }
-
-    delete[] record;
-    return true;
 }
 
 bool DBFManager::Pack() {
+    if (isMapped() || InJournal()) return false; // a rewrite cannot be journaled
+    if (versions && versions->HasReaders()) return false; // snapshots read the old layout
+
     std::string tempfile = filename + ".tmp";
     std::fstream temp(tempfile, std::ios::binary | std::ios::out);
     if (!temp) return false;
@@ -263,21 +1433,16 @@ bool DBFManager::Pack() {
     temp.write(&terminator, 1);
 
     // Copy only active records
+    page_pool.Flush();
     dbf_file.seekg(header.header_size);
     char* record = new char[header.record_size];
     unsigned new_count = 0;
 
-    // Map to track old positions to new positions
-    std::map<long, long> position_map;
-
     for (unsigned i = 0; i < header.num_records; ++i) {
-        long current_pos = dbf_file.tellg();
         dbf_file.read(record, header.record_size);
 
         if (record[0] != '*') {
-            long new_record_pos = temp.tellp();
             temp.write(record, header.record_size);
-            position_map[current_pos] = new_record_pos;
             new_count++;
         }
     }
@@ -285,6 +1450,8 @@ bool DBFManager::Pack() {
 
     // Update record count
     header.num_records = new_count;
+    header.rewrite_count++;
+    StampHeader();
     temp.seekp(0);
     temp.write(reinterpret_cast<char*>(&header), sizeof(header));
     temp.close();
@@ -298,45 +1465,74 @@ bool DBFManager::Pack() {
     // Reopen the file
     dbf_file.open(filename, std::ios::binary | std::ios::in | std::ios::out);
     if (!dbf_file.is_open()) return false;
+    page_pool.Attach(&dbf_file, header.header_size);
 
-    // Update indices with new positions
-    for (const auto& pos_pair : position_map) {
-        long old_pos = pos_pair.first;
-        long new_pos = pos_pair.second;
-
-        if (position_to_key_map.count(old_pos)) {
-            auto keys = position_to_key_map[old_pos];
-            text_index[keys.first] = new_pos;
-            numeric_index[keys.second] = new_pos;
-            position_to_key_map[new_pos] = keys;
-            position_to_key_map.erase(old_pos);
-        }
-    }
+    // Record numbers moved: persistent indexes see the new stamp as stale
+    // and rebuild on their next use
+    for (auto& index : persistent_indices) index.second.reset();
+
+    // Positions moved: field indexes rebuild on their next lookup
+    InvalidateFieldIndices();
+    ForgetFreeSlots();
+    versions = std::make_shared<DBFVersionStore>(filename, header, fields);
 
     return true;
 }
 
-bool DBFManager::GetAllRecords(std::vector<std::vector<std::string>>& out) {
-    if (!dbf_file.is_open()) return false;
-
-    dbf_file.seekg(header.header_size);
-    char* record = new char[header.record_size];
+bool DBFManager::GetAllRecords(std::vector<std::vector<std::string>>& out, unsigned threads) {
+    if (!isOpen()) return false;
     out.clear();
 
-    for (unsigned i = 0; i < header.num_records; ++i) {
-        long pos = dbf_file.tellg();  // Save position before reading
-        dbf_file.read(record, header.record_size);
-        if (record[0] == '*') continue; // Skip deleted records
+    if (threads != 1) {
+        typedef std::vector<std::vector<std::string>> Rows;
+        DBFParallelScan scan(*this, threads);
+        return scan.Reduce(
+            [&](unsigned, unsigned count, const char* records, Rows& rows) {
+                for (unsigned i = 0; i < count; ++i) {
+                    const char* record = records + (size_t)i * header.record_size;
+                    if (record[0] == '*') continue; // Skip deleted records
+
+                    rows.emplace_back();
+                    DecodeRecord(record, rows.back());
+                }
+                return true;
+            },
+            [](Rows& result, Rows& rows) {
+                result.insert(result.end(), std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
+            },
+            out);
+    }
+
+    if (isMapped()) {
+        DBFRecordView view;
+        out.reserve(mapped_records);
+        for (unsigned i = 0; i < mapped_records; ++i) {
+            GetRecordView(i, view);
+            if (view.isDeleted()) continue; // Skip deleted records
 
-        std::vector<std::string> current_record;
-        for (const auto& desc : this->fields) {  // Use the class member fields
-            std::string field(record + desc.address, desc.length);
-            field.erase(field.find_last_not_of(" \t") + 1);
-            current_record.push_back(field);
+            std::vector<std::string> current_record;
+            DecodeRecord(view.raw(), current_record);
+            out.push_back(std::move(current_record));
+        }
+        return true;
+    }
+
+    const unsigned batch = 1024;
+    std::vector<char> scratch;
+    for (unsigned first = 0; first < header.num_records; first += batch) {
+        unsigned count = std::min(batch, header.num_records - first);
+        const char* block = ReadRecordBlock(first, count, scratch);
+        if (!block) return false;
+
+        for (unsigned i = 0; i < count; ++i) {
+            const char* record = block + (size_t)i * header.record_size;
+            if (record[0] == '*') continue; // Skip deleted records
+
+            std::vector<std::string> current_record;
+            DecodeRecord(record, current_record);
+            out.push_back(std::move(current_record));
         }
-        out.push_back(current_record);
     }
 
-    delete[] record;
     return true;
-}
\ No newline at end of file
+}
@@ -3,11 +3,18 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <set>
 #include <algorithm>
 #include <Windows.h> 
-#include "DBFValue.h"
+#include "DBFPagePool.h"
+#include "DBFRowCache.h"
+#include "IDXReader.h"
+#include "BPlusTreeIndex.h"
+#include "KeyExpression.h"
 
 
 #pragma pack(push, 1)
@@ -17,7 +24,10 @@ struct DBF_HEADER {
     unsigned int num_records;
     unsigned short header_size;
     unsigned short record_size;
-    char reserved[20];
+    char reserved[4];
+    unsigned int change_count;    // bumped by every write (bytes 16-19, unused by dBASE III+)
+    unsigned int rewrite_count;   // bumped by writes to rows already there (bytes 20-23)
+    char reserved_tail[8];
 };
 
 struct FIELD_DESCRIPTOR {
@@ -30,57 +40,344 @@ struct FIELD_DESCRIPTOR {
 };
 #pragma pack(pop)
 
+class DBFVersionStore;
+class DBFSnapshot;
+
+// Zero-copy view of one fixed-width record. Points straight into the
+// table's mapping, so it is only valid while the DBFManager stays open.
+class DBFRecordView {
+    const char* data = nullptr;
+    const std::vector<FIELD_DESCRIPTOR>* fields = nullptr;
+public:
+    DBFRecordView() = default;
+    DBFRecordView(const char* record, const std::vector<FIELD_DESCRIPTOR>* descs)
+        : data(record), fields(descs) {}
+
+    bool isDeleted() const { return data[0] == '*'; }
+    const char* raw() const { return data; }
+    size_t fieldCount() const { return fields->size(); }
+
+    // Field bytes exactly as stored, blank padding included
+    std::string_view rawField(size_t i) const {
+        const FIELD_DESCRIPTOR& desc = (*fields)[i];
+        return std::string_view(data + desc.address, desc.length);
+    }
+
+    // Field bytes with trailing blanks dropped, same as GetAllRecords
+    std::string_view field(size_t i) const {
+        std::string_view value = rawField(i);
+        size_t end = value.find_last_not_of(" \t");
+        return end == std::string_view::npos ? std::string_view() : value.substr(0, end + 1);
+    }
+};
+
 class DBFManager {
     std::fstream dbf_file;
     DBF_HEADER header;
     std::vector<FIELD_DESCRIPTOR> fields;
     std::string filename;
 
-    // Index structures
-    std::map<std::string, long> text_index;
-    std::map<double, long> numeric_index;
-    std::map<long, std::pair<std::string, double>> position_to_key_map;
+    // Read-only mapping used by OpenMapped
+    HANDLE map_file = INVALID_HANDLE_VALUE;
+    HANDLE map_handle = nullptr;
+    const char* mapped_data = nullptr;
+    size_t mapped_size = 0;
+    unsigned mapped_records = 0;
+
+    // Scratch record for stream reads, reused instead of new[] per call
+    std::vector<char> record_buffer;
+
+    // Record-area pages of the open table. Slot reads and in-place writes
+    // go through it; bulk scans and appends use the stream directly.
+    DBFPagePool page_pool;
+    // Outside a transaction every write is written back at once; inside
+    // one, dirty pages wait for CommitJournal. Either way the header is
+    // restamped (see UpdateHeader).
+    bool FinishWrite();
+
+    // Before-images and committed version for snapshot readers
+    std::shared_ptr<DBFVersionStore> versions;
+    // Journals the slot and keeps it for snapshots before it is overwritten
+    bool KeepBeforeImage(long pos, const char* before);
+    void PublishVersion();
 
-    void UpdateHeader();
-    bool ReadCurrentRecord(std::vector<std::string>& out);
+    // Stamps the header with today's date and the next change count, then
+    // writes it. Every write ends here, so trees and other derived files
+    // stamped with an older header know they are out of date.
+    bool UpdateHeader();
+    void StampHeader();
+    bool ReadRecordAt(long pos, std::vector<std::string>& out);
+    void DecodeRecord(const char* record, std::vector<std::string>& out) const;
+    bool ReadHeader(const char* data, size_t size);
+    void UnmapFile();
 
+    // Multi-valued: every row keeps its entry, equal keys stay in file order
     struct FieldIndex {
-        std::map<std::string, long> text_index;
-        std::map<double, long> numeric_index;
+        std::multimap<std::string, long> text_index;
+        std::multimap<double, long> numeric_index;
+        bool built = false;
+        unsigned long lookups = 0;  // key lookups served
+        unsigned long builds = 0;   // table scans spent building it
     };
 
+    // Per-field indexes, each built by the first lookup on that field
     std::map<std::string, FieldIndex> field_indices;
-    std::map<long, std::map<std::string, std::shared_ptr<DBFValue>>> position_to_fields;
+    // Decoded rows, filled only by BuildIndices
+    DBFRowCache row_cache;
 
-    bool DeleteRecordAtPosition(long pos, const std::string& text_key, double numeric_key);
+    // Existing FoxPro .IDX files attached with OpenIndex, by tag name
+    std::map<std::string, std::unique_ptr<IDXReader>> idx_files;
+
+    // On-disk B+tree indexes stored next to the table as <file>.<FIELD>.bpt.
+    // Registered fields map to nullptr until the tree is first needed.
+    std::map<std::string, std::unique_ptr<BPlusTreeIndex>> persistent_indices;
+
+    // Composite indexes on a compiled key expression, by tag. Keys are the
+    // fixed-width expression bytes; built on first lookup like field indexes.
+    struct ExpressionIndex {
+        KeyExpression expression;
+        std::multimap<std::string, long> keys;
+        bool built = false;
+        unsigned long lookups = 0;
+        unsigned long builds = 0;
+    };
+    std::map<std::string, ExpressionIndex> expression_indices;
+
+    BPlusTreeIndex* LoadPersistentIndex(const std::string& fieldName);
+    bool RebuildPersistentIndex(const FIELD_DESCRIPTOR& field, BPlusTreeIndex& tree);
+    const FIELD_DESCRIPTOR* FindField(const std::string& fieldName) const;
+    static std::string EncodeIndexKey(const FIELD_DESCRIPTOR& field, const char* raw);
+
+    FieldIndex* EnsureFieldIndex(const FIELD_DESCRIPTOR& field);
+    bool FindInFieldIndex(const FIELD_DESCRIPTOR& field, const std::string& text_key, double numeric_key, long& out_pos);
+    void IndexRecord(FieldIndex& index, const FIELD_DESCRIPTOR& field, const char* record, long pos);
+    void UnindexRecord(const char* record, long pos);
+    void UnindexField(FieldIndex& index, const FIELD_DESCRIPTOR& field, const char* record, long pos);
+    void InvalidateFieldIndices();
+    ExpressionIndex* EnsureExpressionIndex(const std::string& tag);
+    static void UnindexExpression(ExpressionIndex& index, const std::string& key, long pos);
+
+    // Undo journal of the running transaction, <file>.jnl: the header as it
+    // was at BeginJournal, then one before-image per record slot changed in
+    // place. The journal is forced to disk before any write to the table
+    // file (the page pool's write barrier), so no change can be on the
+    // disk without the image that undoes it.
+    std::fstream journal_file;
+    std::set<long> journaled_slots;
+    bool journal_unsynced = false;
+    bool SyncJournal();
+    bool JournalSlot(long pos, const char* before);
+    bool RecoverJournal();
+    bool ApplyJournal(std::fstream& journal);
+    static bool ReadJournalHeader(std::fstream& journal, DBF_HEADER& saved, std::string& master);
+    void MarkTreeUnsynced(BPlusTreeIndex& tree);
+    // Outside a journal a tree is changed before the table write it mirrors.
+    // It carries the unsynced stamp until StampTrees runs after that write,
+    // so a crash in between rebuilds it instead of trusting it.
+    void UnsyncTree(BPlusTreeIndex& tree) { if (!InJournal()) MarkTreeUnsynced(tree); }
+    bool StampTrees();
+
+    // Deleted ('*') slots, lowest position first. Filled by one table scan
+    // the first time they are needed, then kept current by deletes.
+    std::set<long> free_slots;
+    bool free_slots_scanned = false;
+    bool reuse_deleted_slots = false;
+    void ScanFreeSlots();
+    void ForgetFreeSlots() { free_slots.clear(); free_slots_scanned = false; }
+    bool FillSlot(long pos, const char* record);
+    bool TruncateToRecords();
+
+    bool DeleteRecordAtPosition(long pos);
+    bool UpdateRecordAtPosition(long pos, const char* before, const char* after);
+    bool FindFirstByFieldKey(const std::string& fieldName, const std::string& key, long& out_pos);
+    bool AppendRecords(const char* records, size_t count);
+    // Appends larger than this leave persistent trees to rebuild on next use
+    static const size_t BULK_TREE_REBUILD = 256;
     bool GetRecordPosition(double numeric_key, const std::string& text_key, long& out_pos);
 
     public:
         //constructor destructor
         DBFManager() = default;
-        ~DBFManager() { if (dbf_file.is_open()) dbf_file.close(); }
+        DBFManager(const DBFManager&) = delete;
+        DBFManager& operator=(const DBFManager&) = delete;
+        ~DBFManager() { close(); }
 
         //check open
-        bool isOpen() const { return dbf_file.is_open(); }
+        bool isOpen() const { return dbf_file.is_open() || mapped_data != nullptr; }
+        bool isMapped() const { return mapped_data != nullptr; }
 
         bool Open(const std::string& filepath);
-        void close() { if (dbf_file.is_open()) dbf_file.close(); }
+        void close();
+
+        // Read-only open that maps the whole file instead of streaming it.
+        // Records are handed out as views into the mapping; no indices are
+        // built until BuildIndices is called explicitly.
+        bool OpenMapped(const std::string& filepath);
 
+        //zero-copy access (mapped mode only)
+        unsigned RecordCount() const { return isMapped() ? mapped_records : header.num_records; }
+        const std::vector<FIELD_DESCRIPTOR>& GetFields() const { return fields; }
+        bool GetRecordView(unsigned index, DBFRecordView& out) const;
+        unsigned short RecordSize() const { return header.record_size; }
+        unsigned short GetHeaderSize() const { return header.header_size; }
+        // Changes with every write (see UpdateHeader); files derived from the
+        // table keep it to tell whether they are still current
+        unsigned ChangeCount() const { return header.change_count; }
+        // Changes with every delete, update, refilled slot and pack, but not
+        // with appends: a reader that has taken in the first n rows only
+        // needs the rows past n while this stays the same
+        unsigned RewriteCount() const { return header.rewrite_count; }
+
+        // Returns count contiguous raw records starting at index first. Points
+        // into the mapping when mapped, otherwise reads them into scratch.
+        const char* ReadRecordBlock(unsigned first, unsigned count, std::vector<char>& scratch);
+        // Copies the RecordSize() bytes of the record at pos into record,
+        // through the page pool: the read for single rows found by key
+        bool ReadRawRecordAt(long pos, char* record);
+
+        // Builds every field index in one pass. Lookups build the index of
+        // the field they need on their own, so this is rarely worth calling.
         void BuildIndices();
 
+        struct FieldIndexStats {
+            std::string field;
+            bool built;
+            size_t keys;
+            unsigned long lookups;
+            unsigned long builds;
+        };
+        std::vector<FieldIndexStats> GetIndexStats() const;
+
+        // Rows decoded by the last BuildIndices (empty otherwise)
+        const DBFRowCache& GetRowCache() const { return row_cache; }
+
         //record manipulation
         bool GetByTextKey(const std::string& key, std::vector<std::string>& out);
         bool GetByNumericKey(double key, std::vector<std::string>& out);
         bool DeleteRecordByTextKey(const std::string& key);
         bool DeleteRecordByNumericKey(double key);
         bool AddRecord(const std::vector<std::string>& values);
+        // Bulk append: one write, one header update, one pass over the indexes
+        bool AddRecords(const std::vector<std::vector<std::string>>& rows);
+
+        // seek through an existing .IDX instead of rebuilding an index
+        bool OpenIndex(const std::string& tag, const std::string& idxpath);
+        void CloseIndex(const std::string& tag) { idx_files.erase(tag); }
+        bool SeekIndex(const std::string& tag, const std::string& key, std::vector<std::string>& out);
+        bool SeekIndexPrefix(const std::string& tag, const std::string& prefix, std::vector<long>& positions);
+        long PositionOfRecno(unsigned recno) const {
+            return header.header_size + (long)(recno - 1) * header.record_size;
+        }
+        unsigned RecnoOfPosition(long pos) const {
+            return (unsigned)((pos - header.header_size) / header.record_size) + 1;
+        }
+
+        // Keep an on-disk index for fieldName. The tree loads on first use
+        // and is rebuilt from the table only when it is missing or stale.
+        bool AddPersistentIndex(const std::string& fieldName);
+        bool HasPersistentIndex(const std::string& fieldName) const {
+            return persistent_indices.count(fieldName) != 0;
+        }
+        bool FindByPersistentIndex(const std::string& fieldName, const std::string& key, std::vector<long>& positions);
+
+        // Lookup/delete on any field: persistent index when registered,
+        // otherwise that field's in-memory index, built on first use
+        bool GetByFieldKey(const std::string& fieldName, const std::string& key, std::vector<std::string>& out);
+        bool DeleteByFieldKey(const std::string& fieldName, const std::string& key);
+
+        // Rewrites the first matching row where it lies instead of deleting
+        // and appending it. Named fields take the given values (stored as for
+        // AddRecord), the rest keep their bytes, and only indexes over fields
+        // that actually changed are touched.
+        bool UpdateByFieldKey(const std::string& fieldName, const std::string& key,
+            const std::map<std::string, std::string>& values);
+        // Same with a whole encoded record of RecordSize() bytes
+        bool UpdateRawByFieldKey(const std::string& fieldName, const std::string& key, const char* record);
+
+        // Record bytes for typed access (see DBFSchema.h). The pointer is to
+        // an internal buffer or the mapping, valid until the next read.
+        const char* GetRawByFieldKey(const std::string& fieldName, const std::string& key);
+        // Appends encoded records of RecordSize() bytes each
+        bool AddRawRecord(const char* record);
+        bool AddRawRecords(const char* records, size_t count);
+
+        // Secondary index walks returning record positions in key order.
+        // Numeric fields compare as numbers, other fields as trimmed text.
+        bool FindAll(const std::string& fieldName, const std::string& key, std::vector<long>& positions);
+        bool FindRange(const std::string& fieldName, const std::string& low, const std::string& high,
+            std::vector<long>& positions);
+        // seek left(x, n): every row whose field starts with prefix (text fields)
+        bool FindPrefix(const std::string& fieldName, const std::string& prefix, std::vector<long>& positions);
+        // Loads (or builds) the index the calls above use for fieldName:
+        // false when the field is missing or the index can't be had. After
+        // it, those calls returning false only means nothing matched.
+        bool PrepareIndex(const std::string& fieldName);
+
+        // Index on an xBase key expression such as kbrg+DTOC(tjual,1).
+        // Registered on an open table; recompiled whenever it is reopened.
+        bool AddExpressionIndex(const std::string& tag, const std::string& expression);
+        void DropExpressionIndex(const std::string& tag) { expression_indices.erase(tag); }
+        bool HasExpressionIndex(const std::string& tag) const { return expression_indices.count(tag) != 0; }
+        // Keys are given as the expression would produce them: exact keys and
+        // range bounds are blank-padded to the key length, prefixes are not
+        bool FindExpression(const std::string& tag, const std::string& key, std::vector<long>& positions);
+        bool FindExpressionPrefix(const std::string& tag, const std::string& prefix, std::vector<long>& positions);
+        // Unlike the two above, true with no positions when nothing lies in
+        // [low, high]; false only when the index is missing or can't be built
+        bool FindExpressionRange(const std::string& tag, const std::string& low, const std::string& high,
+            std::vector<long>& positions);
+
+        // Transactions by undo journal: cost follows the slots touched, not
+        // the table size. Commit removes the journal; rollback, close() and
+        // the next Open after a crash write the before-images back.
+        // A journal begun with a master journal path belongs to a multi-table
+        // transaction: after a crash it is undone only if that master file
+        // still exists (see TransactionCoordinator).
+        bool BeginJournal(const std::string& masterJournal = "");
+        bool CommitJournal();
+        bool RollbackJournal();
+        bool InJournal() const { return journal_file.is_open(); }
+
+        // Pushes table and journal writes through to the disk itself
+        bool Sync();
+        // Same for any file: its writes cached by the OS reach the disk
+        static bool SyncFile(const std::string& path);
+
+        // Read-only view of the last committed state for another thread (see
+        // DBFSnapshot.h). May be called from any thread while the table stays
+        // open; this object itself is still used by one writer thread only.
+        std::shared_ptr<DBFSnapshot> OpenSnapshot() const;
+
+        // Memory budget of the record page pool (0 turns it off). Kept
+        // across Open; hot rows looked up by key are then read from memory.
+        bool SetPagePoolBudget(size_t bytes, size_t pageSize = DBFPagePool::DEFAULT_PAGE_SIZE) {
+            return page_pool.Configure(bytes, pageSize);
+        }
+        DBFPagePool::Stats GetPagePoolStats() const { return page_pool.GetStats(); }
+
+        // Appends refill deleted slots, lowest first, before growing the
+        // file. Off by default: plain xBase appends keep rows in insertion
+        // order, which readers such as FIFO costing rely on.
+        void ReuseDeletedSlots(bool reuse) { reuse_deleted_slots = reuse; }
+        size_t FreeSlotCount();
+
+        // Online compaction: slides at most max_moves live rows down into the
+        // lowest deleted slots and cuts off the deleted tail. Rows keep their
+        // order in the file, but a table with early holes moves most of its
+        // rows. Each step is its own journaled transaction, so the table stays
+        // open for reads and writes between steps; done is set once no
+        // deleted slot is left. Moved rows get new positions and record
+        // numbers, so positions found before a step are stale after it.
+        bool CompactStep(unsigned max_moves, bool& done);
 
         bool CreateNew(const std::string& filepath, const std::vector<FIELD_DESCRIPTOR>& new_fields);
         bool DeleteFile();
 
         void UpdateFieldAddresses();
         bool Pack();
-        bool GetAllRecords(std::vector<std::vector<std::string>>& out);
+        // threads other than 1 decode on that many threads (0 = every core);
+        // rows still come out in file order
+        bool GetAllRecords(std::vector<std::vector<std::string>>& out, unsigned threads = 1);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include "DBFPagePool.h"
+#include <algorithm>
+#include <cstring>
+
+bool DBFPagePool::Configure(size_t budget_bytes, size_t new_page_size) {
+    if (new_page_size == 0) return false;
+    bool flushed = !file || Flush();
+    Discard();
+
+    page_size = new_page_size;
+    max_pages = budget_bytes / page_size;
+    return flushed;
+}
+
+void DBFPagePool::Attach(std::fstream* table_file, long record_base) {
+    Discard();
+    file = table_file;
+    base = record_base;
+}
+
+void DBFPagePool::Detach() {
+    Discard();
+    file = nullptr;
+}
+
+bool DBFPagePool::Read(long offset, char* out, size_t length) {
+    if (!file) return false;
+
+    if (!isEnabled() || offset < base) {
+        file->clear();
+        file->seekg(offset);
+        file->read(out, length);
+        return (size_t)file->gcount() == length;
+    }
+
+    while (length > 0) {
+        Page* page = LoadPage((offset - base) / (long)page_size);
+        if (!page) return false;
+
+        size_t in = (size_t)(offset - page->first);
+        size_t n = std::min(length, page_size - in);
+        if (in + n > page->valid) return false;
+
+        memcpy(out, page->data.data() + in, n);
+        out += n;
+        offset += (long)n;
+        length -= n;
+    }
+    return true;
+}
+
+bool DBFPagePool::ReadThrough(long offset, char* out, size_t length) {
+    if (!file) return false;
+
+    file->clear();
+    file->seekg(offset);
+    file->read(out, length);
+    if ((size_t)file->gcount() != length) return false;
+
+    long end = offset + (long)length;
+    for (const auto& page : frames) {
+        if (!page.dirty) continue;
+        long from = std::max(offset, page.first);
+        long to = std::min(end, page.first + (long)page.valid);
+        if (from < to) memcpy(out + (from - offset), page.data.data() + (from - page.first), (size_t)(to - from));
+    }
+    return true;
+}
+
+bool DBFPagePool::Write(long offset, const char* data, size_t length) {
+    if (!file) return false;
+
+    if (!isEnabled() || offset < base) {
+        if (barrier && !barrier()) return false;
+        file->clear();
+        file->seekp(offset);
+        file->write(data, length);
+        return (bool)*file;
+    }
+
+    while (length > 0) {
+        Page* page = LoadPage((offset - base) / (long)page_size);
+        if (!page) return false;
+
+        size_t in = (size_t)(offset - page->first);
+        size_t n = std::min(length, page_size - in);
+        if (in + n > page->valid) return false;
+
+        memcpy(page->data.data() + in, data, n);
+        page->dirty = true;
+        data += n;
+        offset += (long)n;
+        length -= n;
+    }
+    return true;
+}
+
+bool DBFPagePool::Flush() {
+    if (!file) return false;
+
+    // In file order, so write-back is one forward sweep
+    std::vector<Page*> dirty;
+    for (auto& page : frames) {
+        if (page.dirty) dirty.push_back(&page);
+    }
+    std::sort(dirty.begin(), dirty.end(), [](const Page* a, const Page* b) { return a->first < b->first; });
+
+    bool ok = true;
+    for (Page* page : dirty) ok = WriteBack(*page) && ok;
+    file->flush();
+    return ok && (bool)*file;
+}
+
+bool DBFPagePool::ReleaseFrom(long offset) {
+    long first_page = offset < base ? 0 : (offset - base) / (long)page_size;
+
+    bool ok = true;
+    for (size_t frame = 0; frame < frames.size(); ++frame) {
+        Page& page = frames[frame];
+        if (page.first < 0 || (page.first - base) / (long)page_size < first_page) continue;
+        if (page.dirty) ok = WriteBack(page) && ok;
+        DropFrame(frame);
+    }
+    return ok;
+}
+
+void DBFPagePool::Discard() {
+    frames.clear();
+    resident.clear();
+    hand = 0;
+}
+
+DBFPagePool::Stats DBFPagePool::GetStats() const {
+    Stats out = stats;
+    out.resident_pages = resident.size();
+    out.dirty_pages = std::count_if(frames.begin(), frames.end(), [](const Page& page) { return page.dirty; });
+    out.budget = max_pages * page_size;
+    out.page_size = page_size;
+    return out;
+}
+
+DBFPagePool::Page* DBFPagePool::LoadPage(long page_number) {
+    auto it = resident.find(page_number);
+    if (it != resident.end()) {
+        stats.hits++;
+        Page& page = frames[it->second];
+        page.referenced = true;
+        return &page;
+    }
+
+    stats.misses++;
+    size_t frame = ChooseFrame();
+    if (frame == frames.size()) return nullptr;
+
+    Page& page = frames[frame];
+    page.first = base + page_number * (long)page_size;
+    page.data.resize(page_size);
+    file->clear();
+    file->seekg(page.first);
+    file->read(page.data.data(), page_size);
+    page.valid = (size_t)file->gcount();
+    file->clear(); // a short last page sets eof
+    page.dirty = false;
+    page.referenced = true;
+
+    resident[page_number] = frame;
+    return &page;
+}
+
+// A free frame if there is one, otherwise the CLOCK victim (written back
+// first when dirty). Returns frames.size() when no frame can be had.
+size_t DBFPagePool::ChooseFrame() {
+    for (size_t frame = 0; frame < frames.size(); ++frame) {
+        if (frames[frame].first < 0) return frame;
+    }
+    if (frames.size() < max_pages) {
+        frames.emplace_back();
+        return frames.size() - 1;
+    }
+
+    // Every page gets a second chance, so two sweeps always find one
+    for (size_t step = 0; step < 2 * frames.size(); ++step) {
+        size_t frame = hand;
+        hand = (hand + 1) % frames.size();
+
+        Page& page = frames[frame];
+        if (page.referenced) {
+            page.referenced = false;
+            continue;
+        }
+        if (page.dirty && !WriteBack(page)) return frames.size();
+        DropFrame(frame);
+        stats.evictions++;
+        return frame;
+    }
+    return frames.size();
+}
+
+bool DBFPagePool::WriteBack(Page& page) {
+    if (barrier && !barrier()) return false;
+    file->clear();
+    file->seekp(page.first);
+    file->write(page.data.data(), page.valid);
+    if (!*file) return false;
+
+    page.dirty = false;
+    stats.writebacks++;
+    return true;
+}
+
+void DBFPagePool::DropFrame(size_t frame) {
+    Page& page = frames[frame];
+    if (page.first >= 0) resident.erase((page.first - base) / (long)page_size);
+    page.first = -1;
+    page.valid = 0;
+    page.dirty = false;
+    page.referenced = false;
+}
@@ -0,0 +1,86 @@
+#ifndef DBF_PAGE_POOL_H
+#define DBF_PAGE_POOL_H
+
+#include <fstream>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Fixed-size pages of a table's record area held in memory under a byte
+// budget and evicted by CLOCK. Reads are served from resident pages; writes
+// land in the page and mark it dirty until Flush or eviction writes it back.
+// Pages start at the record area, so header writes never overlap a page.
+// A budget of 0 turns the pool off and every call goes straight to the file.
+class DBFPagePool {
+public:
+    static const size_t DEFAULT_BUDGET = 1 << 20;
+    static const size_t DEFAULT_PAGE_SIZE = 4096;
+
+    struct Stats {
+        unsigned long long hits = 0;
+        unsigned long long misses = 0;
+        unsigned long long evictions = 0;
+        unsigned long long writebacks = 0;
+        size_t resident_pages = 0;
+        size_t dirty_pages = 0;
+        size_t budget = 0;
+        size_t page_size = 0;
+    };
+
+    // Writes back and drops every page before switching sizes
+    bool Configure(size_t budget_bytes, size_t page_size = DEFAULT_PAGE_SIZE);
+    // Serves file from offset base on; any pages held so far are dropped
+    void Attach(std::fstream* table_file, long base);
+    void Detach();
+    // Called before any byte reaches the file, by Write or a write-back;
+    // returning false fails that write. Kept across Attach.
+    void SetWriteBarrier(std::function<bool()> fn) { barrier = std::move(fn); }
+
+    bool isEnabled() const { return file != nullptr && max_pages > 0; }
+
+    // Fails for bytes past the end of the file
+    bool Read(long offset, char* out, size_t length);
+    // Reads the file directly, then copies dirty resident pages over the
+    // bytes they hold. Nothing is loaded or written back, so long block
+    // reads neither evict the hot pages nor force out held-back writes.
+    bool ReadThrough(long offset, char* out, size_t length);
+    // Overwrites existing bytes (not past the end of the file)
+    bool Write(long offset, const char* data, size_t length);
+
+    // Writes every dirty page back in file order, then flushes the stream
+    bool Flush();
+    // Writes back and drops the pages from the one holding offset to the
+    // end; used before the tail of the file is written or cut directly
+    bool ReleaseFrom(long offset);
+    // Drops every page without writing anything back
+    void Discard();
+
+    Stats GetStats() const;
+
+private:
+    struct Page {
+        long first = -1;        // file offset of data[0]; -1 when the frame is free
+        size_t valid = 0;       // bytes of the page that exist in the file
+        bool dirty = false;
+        bool referenced = false;
+        std::vector<char> data;
+    };
+
+    std::fstream* file = nullptr;
+    std::function<bool()> barrier;
+    long base = 0;
+    size_t page_size = DEFAULT_PAGE_SIZE;
+    size_t max_pages = DEFAULT_BUDGET / DEFAULT_PAGE_SIZE;
+
+    std::vector<Page> frames;
+    std::unordered_map<long, size_t> resident; // page number -> frame
+    size_t hand = 0;
+    Stats stats;
+
+    Page* LoadPage(long page_number);
+    size_t ChooseFrame();
+    bool WriteBack(Page& page);
+    void DropFrame(size_t frame);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "DBFParallelScan.h"
+#include "DBFSnapshot.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+DBFParallelScan::DBFParallelScan(DBFManager& scanned, unsigned threads, unsigned chunk)
+    : table(scanned), thread_count(threads), chunk_records(chunk) {
+    if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+    // Whole 64-record words per chunk, so selection bitmaps never share a word
+    chunk_records = std::max(64u, (chunk_records + 63) / 64 * 64);
+}
+
+// One snapshot per worker. A commit landing in between gives mixed
+// versions; then they are simply taken again.
+bool DBFParallelScan::OpenReaders(unsigned workers, unsigned& records) {
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        readers.clear();
+        for (unsigned i = 0; i < workers; ++i) {
+            std::shared_ptr<DBFSnapshot> reader = table.OpenSnapshot();
+            if (!reader) return false;
+            readers.push_back(reader);
+        }
+
+        bool same = std::all_of(readers.begin(), readers.end(),
+            [&](const std::shared_ptr<DBFSnapshot>& reader) { return reader->Version() == readers[0]->Version(); });
+        if (same) {
+            records = readers[0]->RecordCount();
+            return true;
+        }
+    }
+    readers.clear();
+    return false;
+}
+
+bool DBFParallelScan::ForEachChunk(const ChunkFunction& fn) {
+    return Run([](size_t) {}, fn);
+}
+
+bool DBFParallelScan::Run(const std::function<void(size_t chunks)>& prepare, const ChunkFunction& fn) {
+    if (!table.isOpen()) return false;
+
+    unsigned records = table.RecordCount();
+    size_t chunks = (records + (size_t)chunk_records - 1) / chunk_records;
+    unsigned workers = (unsigned)std::min<size_t>(thread_count, std::max<size_t>(chunks, 1));
+
+    // Pending writes are invisible to snapshots: read them through the table
+    bool pending = !table.isMapped() && table.InJournal();
+    if (pending) workers = 1;
+
+    if (!table.isMapped() && !pending) {
+        if (!OpenReaders(workers, records)) return false;
+        chunks = (records + (size_t)chunk_records - 1) / chunk_records;
+    }
+    prepare(chunks);
+
+    std::atomic<size_t> next_chunk(0);
+    std::atomic<bool> failed(false);
+    auto work = [&](unsigned worker) {
+        std::vector<char> scratch;
+        for (;;) {
+            size_t chunk = next_chunk++;
+            if (chunk >= chunks || failed) break;
+
+            unsigned first = (unsigned)(chunk * chunk_records);
+            unsigned count = std::min(chunk_records, records - first);
+            const char* block = readers.empty()
+                ? table.ReadRecordBlock(first, count, scratch)  // mapped: a pointer into the mapping
+                : readers[worker]->ReadRecordBlock(first, count, scratch);
+            if (!block || !fn(chunk, first, count, block)) failed = true;
+        }
+    };
+
+    // The calling thread is worker 0
+    std::vector<std::thread> threads;
+    for (unsigned worker = 1; worker < workers; ++worker) threads.emplace_back(work, worker);
+    work(0);
+    for (auto& thread : threads) thread.join();
+
+    readers.clear();
+    return !failed;
+}
@@ -0,0 +1,63 @@
+#ifndef DBF_PARALLEL_SCAN_H
+#define DBF_PARALLEL_SCAN_H
+
+#include "DBFManager.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Splits the records [0, RecordCount()) of a table into fixed-size chunks
+// and runs them on several threads. Chunks are claimed one at a time from a
+// shared counter, so a thread that drew cheap chunks just takes more and
+// uneven predicates balance out. Each chunk's partial result has its own
+// slot and slots are merged in chunk order on the calling thread, so the
+// result never depends on scheduling.
+//
+// Mapped tables are read straight from the mapping. Otherwise every worker
+// reads through its own DBFSnapshot, all of one version. Snapshots only see
+// committed versions, so inside an open transaction (DBFManager::InJournal)
+// the scan runs on the calling thread through the table itself and sees
+// the transaction's own writes, as serial reads do.
+class DBFParallelScan {
+public:
+    static const unsigned DEFAULT_CHUNK = 8192; // records, a multiple of 64
+
+    // threads = 0 uses every core
+    explicit DBFParallelScan(DBFManager& table, unsigned threads = 0, unsigned chunk_records = DEFAULT_CHUNK);
+
+    unsigned ThreadCount() const { return thread_count; }
+    unsigned ChunkRecords() const { return chunk_records; }
+
+    // Runs fn(chunk, first, count, records) for every chunk; records holds
+    // count raw records. False when a chunk could not be read or fn failed.
+    typedef std::function<bool(size_t chunk, unsigned first, unsigned count, const char* records)> ChunkFunction;
+    bool ForEachChunk(const ChunkFunction& fn);
+
+    // chunkFn(first, count, records, partial) fills one Partial per chunk;
+    // merge(result, partial) then folds them in chunk order.
+    template <typename Partial, typename ChunkFn, typename MergeFn>
+    bool Reduce(ChunkFn chunkFn, MergeFn merge, Partial& result) {
+        std::vector<Partial> partials;
+        bool ok = Run([&](size_t chunks) { partials.resize(chunks); },
+            [&](size_t chunk, unsigned first, unsigned count, const char* records) {
+                return chunkFn(first, count, records, partials[chunk]);
+            });
+        if (!ok) return false;
+
+        for (auto& partial : partials) merge(result, partial);
+        return true;
+    }
+
+private:
+    DBFManager& table;
+    unsigned thread_count;
+    unsigned chunk_records;
+
+    // One per worker when the table is not mapped
+    std::vector<std::shared_ptr<DBFSnapshot>> readers;
+
+    bool OpenReaders(unsigned workers, unsigned& records);
+    bool Run(const std::function<void(size_t chunks)>& prepare, const ChunkFunction& fn);
+};
+
+#endif
@@ -0,0 +1,392 @@
+#include "DBFQueryPlanner.h"
+#include "DBFValue.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    const unsigned PLANNER_BATCH = 1024; // records per block read
+
+    std::string_view TrimmedField(const char* record, const FIELD_DESCRIPTOR& field) {
+        std::string_view value(record + field.address, field.length);
+        size_t end = value.find_last_not_of(" \t");
+        return end == std::string_view::npos ? std::string_view() : value.substr(0, end + 1);
+    }
+
+    // Equi-depth bounds of sorted values, and the distinct count: exact for
+    // a full pass, otherwise the GEE estimate sqrt(N/n) * f1 + (d - f1)
+    template <typename T>
+    void Summarize(std::vector<T>& values, unsigned rows, std::vector<T>& bounds, double& distinct) {
+        std::sort(values.begin(), values.end());
+        size_t n = values.size();
+        bounds.clear();
+        if (n == 0) {
+            distinct = 0;
+            return;
+        }
+
+        for (unsigned b = 1; b <= DBFQueryPlanner::HISTOGRAM_BUCKETS; ++b)
+            bounds.push_back(values[(size_t)b * n / DBFQueryPlanner::HISTOGRAM_BUCKETS - 1]);
+
+        double seen = 0, once = 0;
+        for (size_t i = 0; i < n;) {
+            size_t j = i;
+            while (j < n && values[j] == values[i]) ++j;
+            seen++;
+            if (j - i == 1) once++;
+            i = j;
+        }
+        distinct = n >= rows ? seen : std::sqrt((double)rows / n) * once + (seen - once);
+        distinct = std::min(std::max(distinct, seen), (double)rows);
+    }
+
+    // Fraction of rows whose value is below x. Buckets ending below x count
+    // whole; the bucket holding x counts in proportion for numbers, half for
+    // text.
+    double FractionBelow(const std::vector<double>& bounds, double min, double x) {
+        size_t k = std::lower_bound(bounds.begin(), bounds.end(), x) - bounds.begin();
+        if (k == bounds.size()) return 1;
+        double from = k == 0 ? min : bounds[k - 1];
+        double part = bounds[k] > from ? (x - from) / (bounds[k] - from) : 0;
+        return (k + std::min(std::max(part, 0.0), 1.0)) / bounds.size();
+    }
+
+    double FractionBelow(const std::vector<std::string>& bounds, const std::string&, const std::string& x) {
+        size_t k = std::lower_bound(bounds.begin(), bounds.end(), x) - bounds.begin();
+        if (k == bounds.size()) return 1;
+        return (k + 0.5) / bounds.size();
+    }
+
+    // Share of rows holding exactly x: at least one distinct value's worth,
+    // more when x fills whole buckets of the histogram
+    template <typename T>
+    double FractionEqual(const std::vector<T>& bounds, double distinct, const T& x) {
+        if (bounds.empty() || distinct <= 0) return 0;
+        size_t repeats = std::count(bounds.begin(), bounds.end(), x);
+        double buckets = repeats > 1 ? (double)(repeats - 1) / bounds.size() : 0;
+        return std::max(1.0 / distinct, buckets);
+    }
+
+    template <typename T>
+    double RangeFraction(const std::vector<T>& bounds, const T& min, const T& max, double distinct,
+        const T& low, const T& high) {
+        if (bounds.empty() || high < low || high < min || max < low) return 0;
+        double fraction = FractionBelow(bounds, min, high) - FractionBelow(bounds, min, low)
+            + FractionEqual(bounds, distinct, high);
+        return std::min(std::max(fraction, 0.0), 1.0);
+    }
+}
+
+const FIELD_DESCRIPTOR* DBFQueryPlanner::FindField(const std::string& fieldName) const {
+    for (const auto& field : table.GetFields()) {
+        if (_strnicmp(field.name, fieldName.c_str(), sizeof(field.name)) == 0) return &field;
+    }
+    return nullptr;
+}
+
+bool DBFQueryPlanner::AddCondition(ConditionKind kind, const std::string& fieldName,
+    const std::string& low, const std::string& high) {
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field || low.size() > field->length || high.size() > field->length) return false;
+
+    Condition condition;
+    condition.kind = kind;
+    condition.field = field;
+    condition.numeric = field->type == 'N' || field->type == 'F';
+    if (condition.numeric && kind == COND_PREFIX) return false;
+
+    condition.low = low;
+    condition.high = high;
+    if (!condition.numeric) {
+        condition.low.erase(condition.low.find_last_not_of(" \t") + 1);
+        condition.high.erase(condition.high.find_last_not_of(" \t") + 1);
+    }
+    condition.low_number = atof(low.c_str());
+    condition.high_number = atof(high.c_str());
+
+    // A reversed range matches nothing; refuse it rather than plan it
+    if (kind == COND_BETWEEN && (condition.numeric ? condition.low_number > condition.high_number
+        : condition.low > condition.high)) return false;
+    conditions.push_back(condition);
+    return true;
+}
+
+bool DBFQueryPlanner::Equals(const std::string& fieldName, const std::string& value) {
+    return AddCondition(COND_EQUALS, fieldName, value, value);
+}
+
+bool DBFQueryPlanner::Between(const std::string& fieldName, const std::string& low, const std::string& high) {
+    return AddCondition(COND_BETWEEN, fieldName, low, high);
+}
+
+bool DBFQueryPlanner::StartsWith(const std::string& fieldName, const std::string& prefix) {
+    return !prefix.empty() && AddCondition(COND_PREFIX, fieldName, prefix, prefix);
+}
+
+bool DBFQueryPlanner::Condition::Matches(const char* record) const {
+    if (numeric) {
+        double value = ParseDBFNumber(record + field->address, field->length);
+        return value >= low_number && value <= high_number;
+    }
+
+    std::string_view value = TrimmedField(record, *field);
+    switch (kind) {
+    case COND_EQUALS: return value == low;
+    case COND_BETWEEN: return value >= low && value <= high;
+    default: return value.compare(0, low.size(), low) == 0;
+    }
+}
+
+std::string DBFQueryPlanner::Condition::Describe() const {
+    std::string name = field->name;
+    switch (kind) {
+    case COND_EQUALS: return name + " = '" + low + "'";
+    case COND_BETWEEN: return name + " BETWEEN '" + low + "' AND '" + high + "'";
+    default: return name + " STARTS WITH '" + low + "'";
+    }
+}
+
+bool DBFQueryPlanner::Analyze() {
+    stats.clear();
+    if (!table.isOpen()) return false;
+
+    const std::vector<FIELD_DESCRIPTOR>& fields = table.GetFields();
+    unsigned total = table.RecordCount();
+    unsigned step = std::max(1u, (total + SAMPLE_ROWS - 1) / SAMPLE_ROWS);
+    unsigned short record_size = table.RecordSize();
+
+    std::vector<std::vector<std::string>> texts(fields.size());
+    std::vector<std::vector<double>> numbers(fields.size());
+    unsigned live = 0, sampled = 0;
+
+    std::vector<char> scratch;
+    for (unsigned first = 0; first < total; first += PLANNER_BATCH) {
+        unsigned count = std::min(PLANNER_BATCH, total - first);
+        const char* block = table.ReadRecordBlock(first, count, scratch);
+        if (!block) {
+            stats.clear();
+            return false;
+        }
+
+        for (unsigned i = 0; i < count; ++i) {
+            const char* record = block + (size_t)i * record_size;
+            if (record[0] == '*') continue; // Skip deleted
+            if (live++ % step != 0) continue;
+
+            sampled++;
+            for (size_t f = 0; f < fields.size(); ++f) {
+                if (fields[f].type == 'N' || fields[f].type == 'F')
+                    numbers[f].push_back(ParseDBFNumber(record + fields[f].address, fields[f].length));
+                else
+                    texts[f].emplace_back(TrimmedField(record, fields[f]));
+            }
+        }
+    }
+
+    stats.resize(fields.size());
+    for (size_t f = 0; f < fields.size(); ++f) {
+        FieldStats& s = stats[f];
+        s.field = fields[f].name;
+        s.numeric = fields[f].type == 'N' || fields[f].type == 'F';
+        s.rows = live;
+        s.sampled = sampled;
+
+        if (s.numeric) {
+            Summarize(numbers[f], live, s.numeric_bounds, s.distinct);
+            if (!numbers[f].empty()) {
+                s.min_number = numbers[f].front();
+                s.max_number = numbers[f].back();
+            }
+        }
+        else {
+            Summarize(texts[f], live, s.text_bounds, s.distinct);
+            if (!texts[f].empty()) {
+                s.min_text = texts[f].front();
+                s.max_text = texts[f].back();
+            }
+        }
+    }
+    analyzed_records = total;
+    return true;
+}
+
+const DBFQueryPlanner::FieldStats* DBFQueryPlanner::GetStats(const std::string& fieldName) const {
+    for (const auto& s : stats) {
+        if (_stricmp(s.field.c_str(), fieldName.c_str()) == 0) return &s;
+    }
+    return nullptr;
+}
+
+bool DBFQueryPlanner::StatsCurrent() const {
+    if (stats.empty()) return false;
+    unsigned now = table.RecordCount();
+    unsigned moved = now > analyzed_records ? now - analyzed_records : analyzed_records - now;
+    return moved <= analyzed_records / 5;
+}
+
+double DBFQueryPlanner::Selectivity(const Condition& condition) const {
+    const FieldStats* s = GetStats(condition.field->name);
+    if (!s || s->sampled == 0) return 0;
+
+    if (s->numeric) {
+        return RangeFraction(s->numeric_bounds, s->min_number, s->max_number, s->distinct,
+            condition.low_number, condition.high_number);
+    }
+
+    switch (condition.kind) {
+    case COND_EQUALS:
+        if (condition.low < s->min_text || condition.low > s->max_text) return 0;
+        return FractionEqual(s->text_bounds, s->distinct, condition.low);
+    case COND_BETWEEN:
+        return RangeFraction(s->text_bounds, s->min_text, s->max_text, s->distinct, condition.low, condition.high);
+    default: {
+        // Every value starting with the prefix sorts inside [prefix, prefix + 0xFF...]
+        std::string high = condition.low;
+        high.resize(condition.field->length, '\xFF');
+        return RangeFraction(s->text_bounds, s->min_text, s->max_text, s->distinct, condition.low, high);
+    }
+    }
+}
+
+DBFQueryPlanner::Candidate DBFQueryPlanner::IndexCandidate(size_t index, double live_rows) {
+    const Condition& condition = conditions[index];
+    std::string name = condition.field->name;
+
+    Candidate candidate;
+    candidate.path = PATH_INDEX;
+    candidate.condition = index;
+    candidate.rows = Selectivity(condition) * live_rows;
+    candidate.cost = candidate.rows * FETCH_ROW;
+
+    if (table.HasPersistentIndex(name)) {
+        candidate.cost += TREE_PROBE;
+        candidate.note = "persistent index on " + name;
+        return candidate;
+    }
+
+    bool built = false;
+    for (const auto& index_stats : table.GetIndexStats()) {
+        if (index_stats.field == name) built = index_stats.built;
+    }
+    candidate.cost += std::log2(live_rows + 2);
+    if (built) {
+        candidate.note = "in-memory index on " + name;
+    }
+    else {
+        // The first lookup pays for a pass that builds the index
+        candidate.cost += table.RecordCount() * (SCAN_ROW + BUILD_ROW);
+        candidate.note = "in-memory index on " + name + ", built by this query";
+    }
+    return candidate;
+}
+
+bool DBFQueryPlanner::Choose(Plan& plan) {
+    plan = Plan();
+    if (!table.isOpen() || conditions.empty()) return false;
+    if (!StatsCurrent() && !Analyze()) return false;
+
+    // Independent conditions: selectivities multiply
+    double live_rows = stats[0].rows * ((double)table.RecordCount() / std::max(1u, analyzed_records));
+    plan.estimated_matches = live_rows;
+    for (const auto& condition : conditions) plan.estimated_matches *= Selectivity(condition);
+
+    Candidate scan;
+    scan.path = PATH_FULL_SCAN;
+    scan.condition = 0;
+    scan.rows = table.RecordCount();
+    scan.cost = scan.rows * SCAN_ROW;
+    scan.note = "every record read once, all conditions tested";
+    plan.candidates.push_back(scan);
+
+    for (size_t i = 0; i < conditions.size(); ++i) plan.candidates.push_back(IndexCandidate(i, live_rows));
+
+    for (size_t i = 1; i < plan.candidates.size(); ++i) {
+        if (plan.candidates[i].cost < plan.candidates[plan.chosen].cost) plan.chosen = i;
+    }
+    return true;
+}
+
+std::string DBFQueryPlanner::Explain() {
+    Plan plan;
+    if (!Choose(plan)) return "no plan: table closed or no conditions\n";
+
+    std::string out = "WHERE ";
+    for (size_t i = 0; i < conditions.size(); ++i) out += (i ? " AND " : "") + conditions[i].Describe();
+
+    char line[256];
+    snprintf(line, sizeof(line), "\n  %u records, about %.0f matches\n", table.RecordCount(), plan.estimated_matches);
+    out += line;
+
+    for (size_t i = 0; i < plan.candidates.size(); ++i) {
+        const Candidate& c = plan.candidates[i];
+        std::string what = c.path == PATH_FULL_SCAN ? "full scan" : "index " + conditions[c.condition].Describe();
+        snprintf(line, sizeof(line), "  %s %-50s rows %10.0f  cost %12.1f  (%s)\n",
+            i == plan.chosen ? "*" : " ", what.c_str(), c.rows, c.cost, c.note.c_str());
+        out += line;
+    }
+
+    const Candidate& chosen = plan.candidates[plan.chosen];
+    if (chosen.path == PATH_INDEX)
+        out += "  every condition is tested again on the rows the index returns\n";
+    return out;
+}
+
+bool DBFQueryPlanner::MatchesAll(const char* record) const {
+    for (const auto& condition : conditions) {
+        if (!condition.Matches(record)) return false;
+    }
+    return true;
+}
+
+bool DBFQueryPlanner::RunScan(std::vector<long>& positions) {
+    unsigned total = table.RecordCount();
+    unsigned short record_size = table.RecordSize();
+    std::vector<char> scratch;
+
+    for (unsigned first = 0; first < total; first += PLANNER_BATCH) {
+        unsigned count = std::min(PLANNER_BATCH, total - first);
+        const char* block = table.ReadRecordBlock(first, count, scratch);
+        if (!block) return false;
+
+        for (unsigned i = 0; i < count; ++i) {
+            const char* record = block + (size_t)i * record_size;
+            if (record[0] != '*' && MatchesAll(record)) positions.push_back(table.PositionOfRecno(first + i + 1));
+        }
+    }
+    return true;
+}
+
+bool DBFQueryPlanner::RunIndex(const Condition& index, std::vector<long>& positions) {
+    std::string name = index.field->name;
+    std::vector<long> found;
+
+    // An index that can't be loaded or built leaves the rows to a scan.
+    // Once it is ready, false from these only means nothing matched.
+    if (!table.PrepareIndex(name)) return RunScan(positions);
+    switch (index.kind) {
+    case COND_EQUALS: table.FindAll(name, index.low, found); break;
+    case COND_BETWEEN: table.FindRange(name, index.low, index.high, found); break;
+    default: table.FindPrefix(name, index.low, found); break;
+    }
+    std::sort(found.begin(), found.end());
+
+    // The index only narrows the rows down: each one is read and every
+    // condition, the index's own included, decides on the record itself
+    std::vector<char> record(table.RecordSize());
+    for (long pos : found) {
+        if (!table.ReadRawRecordAt(pos, record.data())) return false;
+        if (record[0] != '*' && MatchesAll(record.data())) positions.push_back(pos);
+    }
+    return true;
+}
+
+bool DBFQueryPlanner::Execute(std::vector<long>& positions) {
+    positions.clear();
+    Plan plan;
+    if (!Choose(plan)) return false;
+
+    const Candidate& chosen = plan.candidates[plan.chosen];
+    return chosen.path == PATH_FULL_SCAN ? RunScan(positions) : RunIndex(conditions[chosen.condition], positions);
+}
@@ -0,0 +1,112 @@
+#ifndef DBF_QUERY_PLANNER_H
+#define DBF_QUERY_PLANNER_H
+
+#include "DBFManager.h"
+#include <string>
+#include <vector>
+
+// Picks how to answer a conjunction such as KBRG = X .AND. TJUAL in March:
+// one pass over the table, or one condition answered through a field index
+// (FindAll / FindRange / FindPrefix) with every condition tested again on
+// the rows it returns. Each way gets a cost from per-field statistics and the indexes
+// the table has right now; the cheapest one runs.
+//
+// Statistics come from one pass over the table (every k-th row past
+// SAMPLE_ROWS): row count, distinct-value estimate, min/max and an
+// equi-depth histogram per field. They are taken on the first plan and
+// again once the record count moved by more than a fifth. Keep one planner
+// per open table and Clear() it between queries to reuse them.
+//
+// Conditions match like the field indexes: numeric fields by value, others
+// by their text with trailing blanks dropped.
+class DBFQueryPlanner {
+public:
+    static const unsigned SAMPLE_ROWS = 65536;
+    static const unsigned HISTOGRAM_BUCKETS = 32;
+
+    // Relative costs, in units of one record read during a sequential pass
+    static constexpr double SCAN_ROW = 1.0;    // read and test a record in a full pass
+    static constexpr double FETCH_ROW = 4.0;   // read a record by position, through the pool
+    static constexpr double BUILD_ROW = 3.0;   // add a record to an in-memory index
+    static constexpr double TREE_PROBE = 12.0; // descend a persistent tree
+
+    explicit DBFQueryPlanner(DBFManager& table) : table(table) {}
+
+    // Conditions, ANDed. False when the field does not exist or does not
+    // fit, or when a range has low above high.
+    bool Equals(const std::string& fieldName, const std::string& value);
+    bool Between(const std::string& fieldName, const std::string& low, const std::string& high);
+    bool StartsWith(const std::string& fieldName, const std::string& prefix);
+    void Clear() { conditions.clear(); }
+
+    struct FieldStats {
+        std::string field;
+        bool numeric = false;
+        unsigned rows = 0;          // live rows when taken
+        unsigned sampled = 0;
+        double distinct = 0;        // estimate when sampled < rows
+        std::string min_text, max_text;
+        double min_number = 0, max_number = 0;
+        // Upper bound of each bucket; every bucket holds about as many rows
+        std::vector<std::string> text_bounds;
+        std::vector<double> numeric_bounds;
+    };
+
+    // Takes the statistics of every field now
+    bool Analyze();
+    const FieldStats* GetStats(const std::string& fieldName) const;
+
+    enum AccessPath { PATH_FULL_SCAN, PATH_INDEX };
+
+    struct Candidate {
+        AccessPath path;
+        size_t condition;           // PATH_INDEX: the condition the index answers
+        double rows;                // rows the path reads
+        double cost;
+        std::string note;
+    };
+
+    struct Plan {
+        std::vector<Candidate> candidates;  // every path considered
+        size_t chosen = 0;
+        double estimated_matches = 0;
+    };
+
+    bool Choose(Plan& plan);
+    // The candidates with their costs and why the chosen one won
+    std::string Explain();
+    // Positions of the matching live records, in file order
+    bool Execute(std::vector<long>& positions);
+
+private:
+    enum ConditionKind { COND_EQUALS, COND_BETWEEN, COND_PREFIX };
+
+    struct Condition {
+        ConditionKind kind;
+        const FIELD_DESCRIPTOR* field;
+        bool numeric;
+        std::string low;            // trimmed text, or the number as given
+        std::string high;
+        double low_number;
+        double high_number;
+
+        bool Matches(const char* record) const;
+        std::string Describe() const;
+    };
+
+    DBFManager& table;
+    std::vector<Condition> conditions;
+    std::vector<FieldStats> stats;      // one per field, empty until analyzed
+    unsigned analyzed_records = 0;
+
+    const FIELD_DESCRIPTOR* FindField(const std::string& fieldName) const;
+    bool AddCondition(ConditionKind kind, const std::string& fieldName, const std::string& low, const std::string& high);
+    bool StatsCurrent() const;
+    double Selectivity(const Condition& condition) const;
+    Candidate IndexCandidate(size_t condition, double live_rows);
+    bool RunIndex(const Condition& index, std::vector<long>& positions);
+    bool RunScan(std::vector<long>& positions);
+    bool MatchesAll(const char* record) const;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "DBFRowCache.h"
+#include "DBFManager.h"
+#include <algorithm>
+
+void DBFRowCache::Clear() {
+    Reset(0);
+    ShrinkToFit();
+}
+
+void DBFRowCache::Reset(size_t fields) {
+    field_count = fields;
+    live_rows = 0;
+    positions.clear();
+    live.clear();
+    cells.clear();
+    arena.clear();
+}
+
+void DBFRowCache::ShrinkToFit() {
+    positions.shrink_to_fit();
+    live.shrink_to_fit();
+    cells.shrink_to_fit();
+    arena.shrink_to_fit();
+}
+
+bool DBFRowCache::AddRow(long pos, const char* record, const std::vector<FIELD_DESCRIPTOR>& fields) {
+    if (fields.size() != field_count || (!positions.empty() && pos <= positions.back())) return false;
+
+    cells.resize(cells.size() + field_count);
+    DecodeRow(cells.data() + cells.size() - field_count, record, fields);
+
+    positions.push_back(pos);
+    live.push_back(true);
+    live_rows++;
+    return true;
+}
+
+bool DBFRowCache::UpdateRow(long pos, const char* record, const std::vector<FIELD_DESCRIPTOR>& fields) {
+    if (fields.size() != field_count || field_count == 0) return false;
+    auto it = std::lower_bound(positions.begin(), positions.end(), pos);
+    size_t row = it - positions.begin();
+
+    // Appended, or a slot that was already deleted when the cache was built
+    if (it == positions.end() || *it != pos) {
+        positions.insert(it, pos);
+        live.insert(live.begin() + row, false);
+        cells.insert(cells.begin() + row * field_count, field_count, DBFCompactValue());
+    }
+
+    // A deleted slot that was refilled comes back live
+    if (!live[row]) {
+        live[row] = true;
+        live_rows++;
+    }
+
+    // Long text goes to fresh arena bytes; the old ones are not reclaimed
+    DecodeRow(cells.data() + row * field_count, record, fields);
+    return true;
+}
+
+void DBFRowCache::DecodeRow(DBFCompactValue* out, const char* record, const std::vector<FIELD_DESCRIPTOR>& fields) {
+    for (const auto& field : fields) {
+        const char* raw = record + field.address;
+        size_t length = field.length;
+        while (length > 0 && (raw[length - 1] == ' ' || raw[length - 1] == '\t')) --length;
+
+        if (field.type == 'N' || field.type == 'F') {
+            char digits[256];
+            memcpy(digits, raw, length);
+            digits[length] = '\0';
+            *out++ = DBFCompactValue::Number(atof(digits));
+        }
+        else if (length <= DBFCompactValue::INLINE_TEXT) {
+            *out++ = DBFCompactValue::Text(raw, length);
+        }
+        else {
+            *out++ = DBFCompactValue::ArenaText((uint32_t)arena.size(), (uint32_t)length);
+            arena.insert(arena.end(), raw, raw + length);
+        }
+    }
+}
+
+bool DBFRowCache::FindRow(long pos, size_t& row) const {
+    auto it = std::lower_bound(positions.begin(), positions.end(), pos);
+    if (it == positions.end() || *it != pos) return false;
+
+    row = it - positions.begin();
+    return live[row];
+}
+
+bool DBFRowCache::Erase(long pos) {
+    size_t row;
+    if (!FindRow(pos, row)) return false;
+
+    // The slot stays so positions remain sorted; its arena bytes are not reclaimed
+    for (size_t i = 0; i < field_count; ++i) cells[row * field_count + i] = DBFCompactValue();
+    live[row] = false;
+    live_rows--;
+    return true;
+}
+
+size_t DBFRowCache::MemoryUsage() const {
+    return positions.capacity() * sizeof(long) + live.capacity() / 8 +
+        cells.capacity() * sizeof(DBFCompactValue) + arena.capacity();
+}
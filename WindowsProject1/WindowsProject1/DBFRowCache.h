@@ -0,0 +1,54 @@
+#ifndef DBF_ROW_CACHE_H
+#define DBF_ROW_CACHE_H
+
+#include "DBFValue.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct FIELD_DESCRIPTOR;
+
+// Decoded copy of table rows, addressed by row and field number rather than
+// by field name. Every value is one 16-byte DBFCompactValue in a flat
+// row-major array; text that does not fit inline is appended to a single
+// arena. Rows are added in ascending record position order.
+class DBFRowCache {
+public:
+    void Clear();
+    // Starts an empty cache for rows of field_count fields
+    void Reset(size_t field_count);
+    // Drops spare capacity once the rows are in
+    void ShrinkToFit();
+
+    // Decodes one live record (trailing blanks trimmed, 'N'/'F' as numbers)
+    bool AddRow(long pos, const char* record, const std::vector<FIELD_DESCRIPTOR>& fields);
+    // Decodes the row written at pos: rewritten in place, refilled or
+    // appended. A position the cache does not hold yet is added in order.
+    bool UpdateRow(long pos, const char* record, const std::vector<FIELD_DESCRIPTOR>& fields);
+    bool Erase(long pos);
+
+    bool FindRow(long pos, size_t& row) const;
+    size_t RowCount() const { return live_rows; }
+    size_t FieldCount() const { return field_count; }
+    long RowPosition(size_t row) const { return positions[row]; }
+    bool isLive(size_t row) const { return live[row]; }
+
+    const DBFCompactValue& Value(size_t row, size_t field) const { return cells[row * field_count + field]; }
+    double Number(size_t row, size_t field) const { return Value(row, field).toDouble(arena.data()); }
+    std::string_view Text(size_t row, size_t field) const { return Value(row, field).text(arena.data()); }
+
+    // Bytes held by the cache's buffers (capacity, not just size)
+    size_t MemoryUsage() const;
+
+private:
+    size_t field_count = 0;
+    size_t live_rows = 0;
+    std::vector<long> positions;            // ascending
+    std::vector<bool> live;
+    std::vector<DBFCompactValue> cells;
+    std::vector<char> arena;
+
+    void DecodeRow(DBFCompactValue* out, const char* record, const std::vector<FIELD_DESCRIPTOR>& fields);
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "DBFScan.h"
+#include "DBFParallelScan.h"
+#include <cstring>
+#include <emmintrin.h>
+#include <intrin.h>
+
+namespace {
+    const unsigned SCAN_BATCH = 1024; // records per block, multiple of 64
+
+    // Compares length bytes 16 at a time. wide is true when 16-byte loads
+    // rounded up past length stay inside the block; value is always padded.
+    inline bool BytesEqual(const char* field, const char* value, unsigned length, bool wide) {
+        if (!wide) return memcmp(field, value, length) == 0;
+
+        unsigned i = 0;
+        for (; i + 16 <= length; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(field + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(value + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) return false;
+        }
+        if (i == length) return true;
+
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(field + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(value + i));
+        unsigned mask = (1u << (length - i)) - 1;
+        return ((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & mask) == mask;
+    }
+
+    // Big-endian load so integer order matches byte order (dates are YYYYMMDD)
+    inline uint64_t LoadKey8(const char* bytes) {
+        uint64_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return _byteswap_uint64(value);
+    }
+
+    inline unsigned RoundUp16(unsigned length) { return (length + 15) & ~15u; }
+
+    inline unsigned LowestBit(uint64_t bits) {
+        unsigned long index;
+#ifdef _WIN64
+        _BitScanForward64(&index, bits);
+#else
+        if (_BitScanForward(&index, (unsigned long)bits)) return index;
+        _BitScanForward(&index, (unsigned long)(bits >> 32));
+        index += 32;
+#endif
+        return index;
+    }
+}
+
+const FIELD_DESCRIPTOR* DBFScanner::FindField(const std::string& fieldName) const {
+    for (const auto& field : table.GetFields()) {
+        if (_strnicmp(field.name, fieldName.c_str(), sizeof(field.name)) == 0) return &field;
+    }
+    return nullptr;
+}
+
+bool DBFScanner::NotDeleted() {
+    predicates.push_back({ PRED_NOT_DELETED, 0, 1, "", "" });
+    return true;
+}
+
+bool DBFScanner::Equals(const std::string& fieldName, const std::string& value) {
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field || value.size() > field->length) return false;
+
+    Predicate pred = { PRED_EQUALS, field->address, field->length, value, "" };
+    pred.low.resize(field->length, ' ');
+    pred.low.resize(RoundUp16(field->length), '\0');
+    predicates.push_back(pred);
+    return true;
+}
+
+bool DBFScanner::StartsWith(const std::string& fieldName, const std::string& prefix) {
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field || prefix.empty() || prefix.size() > field->length) return false;
+
+    Predicate pred = { PRED_STARTS_WITH, field->address, (unsigned)prefix.size(), prefix, "" };
+    pred.low.resize(RoundUp16(pred.length), '\0');
+    predicates.push_back(pred);
+    return true;
+}
+
+bool DBFScanner::Between(const std::string& fieldName, const std::string& low, const std::string& high) {
+    const FIELD_DESCRIPTOR* field = FindField(fieldName);
+    if (!field || (field->type != 'C' && field->type != 'D')) return false;
+    if (low.size() > field->length || high.size() > field->length) return false;
+
+    Predicate pred = { PRED_BETWEEN, field->address, field->length, low, high };
+    pred.low.resize(field->length, ' ');
+    pred.high.resize(field->length, ' ');
+    predicates.push_back(pred);
+    return true;
+}
+
+bool DBFScanner::For(const std::string& condition) {
+    auto expression = std::make_shared<ForExpression>();
+    if (!expression->Compile(condition, table.GetFields())) return false;
+    return For(expression);
+}
+
+bool DBFScanner::For(const std::shared_ptr<const ForExpression>& condition) {
+    if (!condition || !condition->isCompiled()) return false;
+
+    Predicate pred = { PRED_EXPRESSION, 0, 0, "", "" };
+    pred.expression = condition;
+    predicates.push_back(pred);
+    return true;
+}
+
+void DBFScanner::EvaluateBlock(const std::vector<Predicate>& predicates, const char* block,
+    unsigned count, unsigned record_size, uint64_t* selection) {
+    const char* block_end = block + (size_t)count * record_size;
+    unsigned words = (count + 63) / 64;
+    ForExpression::Scratch scratch;
+
+    for (const auto& pred : predicates) {
+        unsigned span = pred.kind == PRED_BETWEEN ? pred.length : RoundUp16(pred.length);
+        uint64_t low8 = 0, high8 = 0;
+        if (pred.kind == PRED_BETWEEN && pred.length == 8) {
+            low8 = LoadKey8(pred.low.data());
+            high8 = LoadKey8(pred.high.data());
+        }
+
+        for (unsigned w = 0; w < words; ++w) {
+            uint64_t bits = selection[w];
+            while (bits) {
+                unsigned bit = LowestBit(bits);
+                bits &= bits - 1;
+
+                unsigned row = w * 64 + bit;
+                const char* field = block + (size_t)row * record_size + pred.offset;
+                bool match = false;
+
+                switch (pred.kind) {
+                case PRED_NOT_DELETED:
+                    match = field[0] != '*';
+                    break;
+                case PRED_EQUALS:
+                case PRED_STARTS_WITH:
+                    match = BytesEqual(field, pred.low.data(), pred.length, field + span <= block_end);
+                    break;
+                case PRED_BETWEEN:
+                    if (pred.length == 8) {
+                        uint64_t key = LoadKey8(field);
+                        match = key >= low8 && key <= high8;
+                    }
+                    else {
+                        match = memcmp(field, pred.low.data(), pred.length) >= 0 &&
+                            memcmp(field, pred.high.data(), pred.length) <= 0;
+                    }
+                    break;
+                case PRED_EXPRESSION:
+                    match = pred.expression->Matches(field, scratch);
+                    break;
+                }
+
+                if (!match) selection[w] &= ~(1ull << bit);
+            }
+        }
+    }
+}
+
+template <typename Visitor>
+bool DBFScanner::ScanBlocks(unsigned start, Visitor visit) {
+    if (!table.isOpen()) return false;
+
+    unsigned total = table.RecordCount();
+    unsigned record_size = table.RecordSize();
+    std::vector<char> scratch;
+    uint64_t selection[SCAN_BATCH / 64];
+
+    for (unsigned first = start; first < total; first += SCAN_BATCH) {
+        unsigned count = std::min(SCAN_BATCH, total - first);
+        const char* block = table.ReadRecordBlock(first, count, scratch);
+        if (!block) return false;
+
+        unsigned words = (count + 63) / 64;
+        for (unsigned w = 0; w < words; ++w) selection[w] = ~0ull;
+        if (count % 64) selection[words - 1] = (1ull << (count % 64)) - 1;
+
+        EvaluateBlock(predicates, block, count, record_size, selection);
+        if (!visit(first, count, selection)) break;
+    }
+    return true;
+}
+
+bool DBFScanner::Scan(std::vector<uint64_t>& bitmap) {
+    bitmap.assign((table.RecordCount() + 63) / 64, 0);
+
+    return ScanBlocks(0, [&](unsigned first, unsigned count, const uint64_t* selection) {
+        memcpy(bitmap.data() + first / 64, selection, ((count + 63) / 64) * sizeof(uint64_t));
+        return true;
+    });
+}
+
+bool DBFScanner::Scan(std::vector<long>& positions) {
+    positions.clear();
+    long header_size = table.GetHeaderSize();
+    long record_size = table.RecordSize();
+
+    return ScanBlocks(0, [&](unsigned first, unsigned count, const uint64_t* selection) {
+        for (unsigned row = 0; row < count; ++row) {
+            if (selection[row / 64] & (1ull << (row % 64)))
+                positions.push_back(header_size + (long)(first + row) * record_size);
+        }
+        return true;
+    });
+}
+
+bool DBFScanner::ScanParallel(std::vector<uint64_t>& bitmap, unsigned threads) {
+    bitmap.clear();
+    unsigned record_size = table.RecordSize();
+    DBFParallelScan scan(table, threads);
+
+    // Chunks are whole words, so each chunk's bitmap words just follow the last
+    return scan.Reduce(
+        [&](unsigned, unsigned count, const char* records, std::vector<uint64_t>& words) {
+            words.assign((count + 63) / 64, ~0ull);
+            if (count % 64) words.back() = (1ull << (count % 64)) - 1;
+            EvaluateBlock(predicates, records, count, record_size, words.data());
+            return true;
+        },
+        [](std::vector<uint64_t>& result, const std::vector<uint64_t>& words) {
+            result.insert(result.end(), words.begin(), words.end());
+        },
+        bitmap);
+}
+
+bool DBFScanner::ScanParallel(std::vector<long>& positions, unsigned threads) {
+    positions.clear();
+    long header_size = table.GetHeaderSize();
+    long record_size = table.RecordSize();
+    DBFParallelScan scan(table, threads);
+
+    return scan.Reduce(
+        [&](unsigned first, unsigned count, const char* records, std::vector<long>& matches) {
+            std::vector<uint64_t> selection((count + 63) / 64, ~0ull);
+            if (count % 64) selection.back() = (1ull << (count % 64)) - 1;
+            EvaluateBlock(predicates, records, count, (unsigned)record_size, selection.data());
+
+            for (unsigned row = 0; row < count; ++row) {
+                if (selection[row / 64] & (1ull << (row % 64)))
+                    matches.push_back(header_size + (long)(first + row) * record_size);
+            }
+            return true;
+        },
+        [](std::vector<long>& result, const std::vector<long>& matches) {
+            result.insert(result.end(), matches.begin(), matches.end());
+        },
+        positions);
+}
+
+bool DBFScanner::Locate(unsigned start, long& out_pos) {
+    bool found = false;
+    long header_size = table.GetHeaderSize();
+    long record_size = table.RecordSize();
+
+    bool ok = ScanBlocks(start, [&](unsigned first, unsigned count, const uint64_t* selection) {
+        for (unsigned row = 0; row < count; ++row) {
+            if (selection[row / 64] & (1ull << (row % 64))) {
+                out_pos = header_size + (long)(first + row) * record_size;
+                found = true;
+                return false;
+            }
+        }
+        return true;
+    });
+    return ok && found;
+}
@@ -0,0 +1,75 @@
+#ifndef DBF_SCAN_H
+#define DBF_SCAN_H
+
+#include "DBFManager.h"
+#include "ForExpression.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Predicate scan over raw fixed-width records.
+// Conditions are compared against the blank-padded field bytes exactly as
+// they sit in the file, 16 bytes at a time, so rows that fail are never
+// decoded. Conditions are ANDed; each one only visits rows that are still
+// selected after the previous ones.
+class DBFScanner {
+public:
+    enum PredicateKind {
+        PRED_NOT_DELETED,
+        PRED_EQUALS,        // field = value (value blank-padded to field width)
+        PRED_STARTS_WITH,   // left(field, len(value)) = value
+        PRED_BETWEEN,       // lo <= field <= hi, bytewise (C and D fields)
+        PRED_EXPRESSION     // compiled xBase FOR condition on the whole record
+    };
+
+    struct Predicate {
+        PredicateKind kind;
+        unsigned offset;    // byte offset inside the record
+        unsigned length;    // bytes compared
+        std::string low;
+        std::string high;
+        std::shared_ptr<const ForExpression> expression = nullptr;   // PRED_EXPRESSION
+    };
+
+    explicit DBFScanner(DBFManager& table) : table(table) {}
+
+    // Builders return false when the field does not exist. Between also
+    // refuses fields other than C and D, whose bytes don't sort by value.
+    bool NotDeleted();
+    bool Equals(const std::string& fieldName, const std::string& value);
+    bool StartsWith(const std::string& fieldName, const std::string& prefix);
+    bool Between(const std::string& fieldName, const std::string& low, const std::string& high);
+    // for <condition>, e.g. "kbrg='AG'.and.tjual>={^2010-08-01}". Compiled
+    // here against the table; conditions naming memory variables are
+    // compiled by the caller (ForExpression::SetText ...) and passed in.
+    bool For(const std::string& condition);
+    bool For(const std::shared_ptr<const ForExpression>& condition);
+    void Clear() { predicates.clear(); }
+    const std::vector<Predicate>& GetPredicates() const { return predicates; }
+
+    // One bit per record number; bit set = record matches
+    bool Scan(std::vector<uint64_t>& bitmap);
+    // File offsets of the matching records, in file order
+    bool Scan(std::vector<long>& positions);
+    // Same results on several threads (0 = every core), see DBFParallelScan.h
+    bool ScanParallel(std::vector<uint64_t>& bitmap, unsigned threads = 0);
+    bool ScanParallel(std::vector<long>& positions, unsigned threads = 0);
+    // locate for: first matching record at or after 0-based index start
+    // (record number start + 1)
+    bool Locate(unsigned start, long& out_pos);
+
+    // Evaluates the predicates for count records laid out record_size apart
+    // and clears the bits of rows that fail. Exposed for other scan engines.
+    static void EvaluateBlock(const std::vector<Predicate>& predicates, const char* block,
+        unsigned count, unsigned record_size, uint64_t* selection);
+
+private:
+    DBFManager& table;
+    std::vector<Predicate> predicates;
+
+    const FIELD_DESCRIPTOR* FindField(const std::string& fieldName) const;
+    template <typename Visitor> bool ScanBlocks(unsigned start, Visitor visit);
+};
+
+#endif
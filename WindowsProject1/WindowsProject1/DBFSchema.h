@@ -0,0 +1,166 @@
+#ifndef DBF_SCHEMA_H
+#define DBF_SCHEMA_H
+
+#include "DBFManager.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// One column of a compile-time schema, bound to a struct member
+template <typename Struct, typename T>
+struct DBFField {
+    const char* name;
+    char type;
+    unsigned char length;
+    unsigned char decimal;
+    T Struct::* member;
+};
+
+template <typename Struct, typename T>
+constexpr DBFField<Struct, T> MakeDBFField(const char* name, char type, unsigned char length,
+    unsigned char decimal, T Struct::* member) {
+    return { name, type, length, decimal, member };
+}
+
+// Specialise per record struct with a constexpr tuple of DBFField, in file
+// column order:
+//     template <> struct DBFSchema<Foo> {
+//         static constexpr auto fields = std::make_tuple(MakeDBFField("ID", 'C', 10, 0, &Foo::id), ...);
+//     };
+template <typename Struct>
+struct DBFSchema;
+
+// Column values to and from raw record bytes. Nothing here allocates except
+// a std::string member growing past its small-string capacity.
+// Encode returns false when the value does not fit its column.
+namespace DBFFieldCodec {
+    // Text is cut to the column width, as AddRecord stores it
+    inline bool Encode(const std::string& value, char* out, unsigned length, unsigned char) {
+        size_t n = value.size() < length ? value.size() : length;
+        memcpy(out, value.data(), n);
+        memset(out + n, ' ', length - n);
+        return true;
+    }
+
+    // Numbers are right-justified as dBASE writes them; a number too wide
+    // for its column is filled with '*', again as dBASE does
+    inline bool Encode(double value, char* out, unsigned length, unsigned char decimal) {
+        char buffer[64];
+        int written = snprintf(buffer, sizeof(buffer), "%*.*f", (int)length, (int)decimal, value);
+        if (written == (int)length) {
+            memcpy(out, buffer, length);
+            return true;
+        }
+        memset(out, '*', length);
+        return false;
+    }
+
+    inline bool Encode(int value, char* out, unsigned length, unsigned char decimal) {
+        return Encode((double)value, out, length, decimal);
+    }
+
+    inline void Decode(const char* raw, unsigned length, std::string& value) {
+        while (length > 0 && (raw[length - 1] == ' ' || raw[length - 1] == '\t')) --length;
+        value.assign(raw, length);
+    }
+
+    inline void Decode(const char* raw, unsigned length, double& value) {
+        char buffer[64];
+        if (length >= sizeof(buffer)) length = sizeof(buffer) - 1;
+        memcpy(buffer, raw, length);
+        buffer[length] = '\0';
+        value = strtod(buffer, nullptr);
+    }
+
+    inline void Decode(const char* raw, unsigned length, int& value) {
+        double number;
+        Decode(raw, length, number);
+        value = (int)number;
+    }
+}
+
+// Record layout derived from DBFSchema<Struct> at compile time: offsets,
+// widths and the record size are constants, and Encode/Decode go straight
+// between the struct and the record bytes without field-name lookups.
+template <typename Struct>
+class DBFRecordLayout {
+    static constexpr auto& fields = DBFSchema<Struct>::fields;
+
+public:
+    static constexpr size_t FieldCount = std::tuple_size<std::decay_t<decltype(DBFSchema<Struct>::fields)>>::value;
+
+    template <size_t I>
+    static constexpr unsigned Offset() {
+        if constexpr (I == 0) return 1; // byte 0 is the delete flag
+        else return Offset<I - 1>() + std::get<I - 1>(fields).length;
+    }
+
+    template <size_t I>
+    static constexpr unsigned Width() { return std::get<I>(fields).length; }
+
+    static constexpr unsigned RecordSize = Offset<FieldCount>();
+
+    // Writes a live record of RecordSize bytes; false if any field overflowed
+    static bool Encode(const Struct& in, char* record) {
+        record[0] = ' ';
+        return EncodeFields(in, record, std::make_index_sequence<FieldCount>{});
+    }
+
+    static void Decode(const char* record, Struct& out) {
+        DecodeFields(record, out, std::make_index_sequence<FieldCount>{});
+    }
+
+    // Descriptors for CreateNew, addresses filled in
+    static std::vector<FIELD_DESCRIPTOR> Descriptors() {
+        std::vector<FIELD_DESCRIPTOR> out;
+        AppendDescriptors(out, std::make_index_sequence<FieldCount>{});
+        return out;
+    }
+
+    // The file on disk must have exactly this layout for Encode/Decode to apply
+    static bool Matches(const std::vector<FIELD_DESCRIPTOR>& table) {
+        return table.size() == FieldCount && MatchFields(table, std::make_index_sequence<FieldCount>{});
+    }
+
+private:
+    // Every field is written, even after one has overflowed
+    template <size_t... I>
+    static bool EncodeFields(const Struct& in, char* record, std::index_sequence<I...>) {
+        return (true & ... & DBFFieldCodec::Encode(in.*(std::get<I>(fields).member), record + Offset<I>(),
+            Width<I>(), std::get<I>(fields).decimal));
+    }
+
+    template <size_t... I>
+    static void DecodeFields(const char* record, Struct& out, std::index_sequence<I...>) {
+        (DBFFieldCodec::Decode(record + Offset<I>(), Width<I>(), out.*(std::get<I>(fields).member)), ...);
+    }
+
+    template <size_t... I>
+    static bool MatchFields(const std::vector<FIELD_DESCRIPTOR>& table, std::index_sequence<I...>) {
+        return ((_strnicmp(table[I].name, std::get<I>(fields).name, sizeof(table[I].name)) == 0 &&
+            table[I].type == std::get<I>(fields).type && table[I].length == Width<I>() &&
+            table[I].address == Offset<I>()) && ...);
+    }
+
+    template <size_t... I>
+    static void AppendDescriptors(std::vector<FIELD_DESCRIPTOR>& out, std::index_sequence<I...>) {
+        (out.push_back(MakeDescriptor(std::get<I>(fields), Offset<I>())), ...);
+    }
+
+    template <typename T>
+    static FIELD_DESCRIPTOR MakeDescriptor(const DBFField<Struct, T>& field, unsigned address) {
+        FIELD_DESCRIPTOR desc = {};
+        memcpy(desc.name, field.name, std::min(strlen(field.name), sizeof(desc.name) - 1));
+        desc.type = field.type;
+        desc.address = address;
+        desc.length = field.length;
+        desc.decimal = field.decimal;
+        return desc;
+    }
+};
+
+#endif
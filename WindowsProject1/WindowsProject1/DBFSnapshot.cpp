@@ -0,0 +1,257 @@
+#include "DBFSnapshot.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+DBFVersionStore::DBFVersionStore(const std::string& file, const DBF_HEADER& header,
+    const std::vector<FIELD_DESCRIPTOR>& table_fields)
+    : filename(file), header_size(header.header_size), record_size(header.record_size),
+      fields(table_fields), committed_records(header.num_records),
+      committed_rewrites(header.rewrite_count), indexes(table_fields.size()) {}
+
+void DBFVersionStore::Retain(long pos, const char* before) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+
+    // Only the first write of a version matters; later ones overwrite its own bytes
+    std::vector<Image>& slot = images[pos];
+    if (!slot.empty() && slot.back().version == committed + 1) return;
+    slot.push_back({ committed + 1, std::vector<char>(before, before + record_size) });
+}
+
+void DBFVersionStore::Publish(unsigned records, unsigned rewrites) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    committed++;
+    committed_records = records;
+    committed_rewrites = rewrites;
+    Collect();
+}
+
+bool DBFVersionStore::HasReaders() const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return !readers.empty();
+}
+
+unsigned DBFVersionStore::VisibleRecords() const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return reader_records.empty() ? 0 : *reader_records.rbegin();
+}
+
+uint64_t DBFVersionStore::Acquire(unsigned& records, unsigned& rewrites) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    readers.insert(committed);
+    reader_records.insert(committed_records);
+    records = committed_records;
+    rewrites = committed_rewrites;
+    return committed;
+}
+
+void DBFVersionStore::Release(uint64_t version, unsigned records) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    auto it = readers.find(version);
+    if (it != readers.end()) readers.erase(it);
+    auto count = reader_records.find(records);
+    if (count != reader_records.end()) reader_records.erase(count);
+    Collect();
+}
+
+// Drops images no live snapshot can ask for. A snapshot of version v needs
+// the images replaced by versions after v; a pending write's image stays.
+void DBFVersionStore::Collect() {
+    uint64_t oldest = readers.empty() ? committed : *readers.begin();
+    for (auto it = images.begin(); it != images.end();) {
+        std::vector<Image>& slot = it->second;
+        auto keep = std::find_if(slot.begin(), slot.end(), [oldest](const Image& image) { return image.version > oldest; });
+        slot.erase(slot.begin(), keep);
+        it = slot.empty() ? images.erase(it) : std::next(it);
+    }
+}
+
+void DBFVersionStore::Overlay(long first_pos, size_t count, uint64_t version, char* records) const {
+    std::shared_lock<std::shared_mutex> guard(lock);
+
+    long end_pos = first_pos + (long)(count * record_size);
+    for (auto it = images.lower_bound(first_pos); it != images.end() && it->first < end_pos; ++it) {
+        // The oldest image written after the snapshot holds what it saw
+        for (const Image& image : it->second) {
+            if (image.version <= version) continue;
+            memcpy(records + (it->first - first_pos), image.bytes.data(), record_size);
+            break;
+        }
+    }
+}
+
+std::shared_ptr<const DBFVersionStore::KeyIndex> DBFVersionStore::GetIndex(size_t field) const {
+    return std::atomic_load(&indexes[field]);
+}
+
+void DBFVersionStore::PublishIndex(size_t field, const std::shared_ptr<const KeyIndex>& index) {
+    // Never replace a newer version's index with an older one
+    std::shared_ptr<const KeyIndex> current = std::atomic_load(&indexes[field]);
+    if (current && current->version > index->version) return;
+    std::atomic_store(&indexes[field], index);
+}
+
+DBFSnapshot::DBFSnapshot(const std::shared_ptr<DBFVersionStore>& version_store)
+    : store(version_store), indexes(version_store->GetFields().size()) {
+    // Its own handle: positional reads never share a file pointer
+    file = CreateFileA(store->GetFileName().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+        nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    version = store->Acquire(records, rewrites);
+}
+
+DBFSnapshot::~DBFSnapshot() {
+    store->Release(version, records);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+bool DBFSnapshot::ReadAt(long pos, char* out, size_t length) {
+    OVERLAPPED at = {};
+    at.Offset = (DWORD)pos;
+    at.OffsetHigh = 0;
+    DWORD read = 0;
+    return ReadFile(file, out, (DWORD)length, &read, &at) && read == length;
+}
+
+const char* DBFSnapshot::ReadRecordBlock(unsigned first, unsigned count, std::vector<char>& scratch) {
+    if (!isOpen() || count == 0 || first + count > records) return nullptr;
+
+    long pos = PositionOfRecno(first + 1);
+    scratch.resize((size_t)count * store->RecordSize());
+    if (!ReadAt(pos, scratch.data(), scratch.size())) return nullptr;
+    store->Overlay(pos, count, version, scratch.data());
+    return scratch.data();
+}
+
+bool DBFSnapshot::ReadRecordAt(long pos, std::vector<std::string>& out) {
+    out.clear();
+    long first = pos - store->GetHeaderSize();
+    if (first < 0 || first % store->RecordSize() != 0) return false;
+
+    const char* record = ReadRecordBlock((unsigned)(first / store->RecordSize()), 1, record_buffer);
+    if (!record || record[0] == '*') return false;
+    DecodeRecord(record, out);
+    return true;
+}
+
+size_t DBFSnapshot::FindFieldNumber(const std::string& fieldName) const {
+    const std::vector<FIELD_DESCRIPTOR>& fields = GetFields();
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (_strnicmp(fields[i].name, fieldName.c_str(), sizeof(fields[i].name)) == 0) return i;
+    }
+    return fields.size();
+}
+
+// The index of this snapshot's version: the shared one when some snapshot
+// of the version already built it, otherwise built here from the snapshot
+// and offered to the others.
+const DBFVersionStore::KeyIndex* DBFSnapshot::LoadIndex(size_t field) {
+    if (indexes[field]) return indexes[field].get();
+
+    std::shared_ptr<const DBFVersionStore::KeyIndex> shared = store->GetIndex(field);
+    if (shared && shared->version == version) {
+        indexes[field] = shared;
+        return shared.get();
+    }
+
+    const FIELD_DESCRIPTOR& desc = GetFields()[field];
+    bool numeric = desc.type == 'N' || desc.type == 'F';
+    auto index = std::make_shared<DBFVersionStore::KeyIndex>();
+    index->version = version;
+
+    const unsigned batch = 1024;
+    std::vector<char> scratch;
+    for (unsigned first = 0; first < records; first += batch) {
+        unsigned count = std::min(batch, records - first);
+        const char* block = ReadRecordBlock(first, count, scratch);
+        if (!block) return nullptr;
+
+        for (unsigned i = 0; i < count; ++i) {
+            const char* record = block + (size_t)i * store->RecordSize();
+            if (record[0] == '*') continue; // Skip deleted
+
+            std::string value(record + desc.address, desc.length);
+            value.erase(value.find_last_not_of(" \t") + 1);
+            long pos = PositionOfRecno(first + i + 1);
+            if (numeric) index->numeric.emplace_back(atof(value.c_str()), pos);
+            else index->text.emplace_back(std::move(value), pos);
+        }
+    }
+
+    // Stable: equal keys keep file order, as in the DBFManager indexes
+    auto by_key = [](const auto& a, const auto& b) { return a.first < b.first; };
+    std::stable_sort(index->text.begin(), index->text.end(), by_key);
+    std::stable_sort(index->numeric.begin(), index->numeric.end(), by_key);
+
+    store->PublishIndex(field, index);
+    indexes[field] = index;
+    return index.get();
+}
+
+bool DBFSnapshot::PrepareIndex(const std::string& fieldName) {
+    size_t field = FindFieldNumber(fieldName);
+    return field < GetFields().size() && LoadIndex(field) != nullptr;
+}
+
+bool DBFSnapshot::FindAll(const std::string& fieldName, const std::string& key, std::vector<long>& positions) {
+    positions.clear();
+    size_t field = FindFieldNumber(fieldName);
+    if (field == GetFields().size()) return false;
+
+    const DBFVersionStore::KeyIndex* index = LoadIndex(field);
+    if (!index) return false;
+
+    const FIELD_DESCRIPTOR& desc = GetFields()[field];
+    if (desc.type == 'N' || desc.type == 'F') {
+        std::pair<double, long> probe(atof(key.c_str()), 0);
+        auto range = std::equal_range(index->numeric.begin(), index->numeric.end(), probe,
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (auto it = range.first; it != range.second; ++it) positions.push_back(it->second);
+    }
+    else {
+        std::pair<std::string, long> probe(key, 0);
+        probe.first.erase(probe.first.find_last_not_of(" \t") + 1);
+        auto range = std::equal_range(index->text.begin(), index->text.end(), probe,
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (auto it = range.first; it != range.second; ++it) positions.push_back(it->second);
+    }
+    return !positions.empty();
+}
+
+bool DBFSnapshot::GetByFieldKey(const std::string& fieldName, const std::string& key, std::vector<std::string>& out) {
+    std::vector<long> positions;
+    if (!FindAll(fieldName, key, positions)) return false;
+    return ReadRecordAt(positions[0], out);
+}
+
+bool DBFSnapshot::GetAllRecords(std::vector<std::vector<std::string>>& out) {
+    out.clear();
+    if (!isOpen()) return false;
+
+    const unsigned batch = 1024;
+    std::vector<char> scratch;
+    for (unsigned first = 0; first < records; first += batch) {
+        unsigned count = std::min(batch, records - first);
+        const char* block = ReadRecordBlock(first, count, scratch);
+        if (!block) return false;
+
+        for (unsigned i = 0; i < count; ++i) {
+            const char* record = block + (size_t)i * store->RecordSize();
+            if (record[0] == '*') continue; // Skip deleted records
+
+            std::vector<std::string> current_record;
+            DecodeRecord(record, current_record);
+            out.push_back(std::move(current_record));
+        }
+    }
+    return true;
+}
+
+void DBFSnapshot::DecodeRecord(const char* record, std::vector<std::string>& out) const {
+    out.reserve(GetFields().size());
+    for (const auto& field : GetFields()) {
+        std::string value(record + field.address, field.length);
+        value.erase(value.find_last_not_of(" \t") + 1);
+        out.push_back(value);
+    }
+}
@@ -0,0 +1,131 @@
+#ifndef DBF_SNAPSHOT_H
+#define DBF_SNAPSHOT_H
+
+#include "DBFManager.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+// What snapshot readers of one open table share: the committed version and
+// record count, and the before-image of every slot the writer overwrote
+// since the oldest live snapshot began. The owning DBFManager is the only
+// writer; snapshots on any thread only read.
+class DBFVersionStore {
+public:
+    DBFVersionStore(const std::string& filename, const DBF_HEADER& header, const std::vector<FIELD_DESCRIPTOR>& fields);
+
+    const std::string& GetFileName() const { return filename; }
+    unsigned short GetHeaderSize() const { return header_size; }
+    unsigned short RecordSize() const { return record_size; }
+    const std::vector<FIELD_DESCRIPTOR>& GetFields() const { return fields; }
+
+    // Writer: the slot as it was before the pending version first touched it
+    void Retain(long pos, const char* before);
+    // Writer: the pending version is in the file; snapshots taken from now
+    // on start from it
+    void Publish(unsigned records, unsigned rewrites);
+    bool HasReaders() const;
+    // Writer: records some live snapshot still reads (0 with none). Slots
+    // up to there may lie past the table's end after a compaction and
+    // must be retained before an append reuses them.
+    unsigned VisibleRecords() const;
+
+    // Readers: registers a snapshot of the committed version
+    uint64_t Acquire(unsigned& records, unsigned& rewrites);
+    void Release(uint64_t version, unsigned records);
+    // Puts back the bytes a slot had at version into records read from the
+    // file, for every slot of the block written since
+    void Overlay(long first_pos, size_t count, uint64_t version, char* records) const;
+
+    // Immutable key index of one field at one version, in key order with
+    // equal keys in file order. Shared by every snapshot of that version.
+    struct KeyIndex {
+        uint64_t version = 0;
+        std::vector<std::pair<std::string, long>> text;
+        std::vector<std::pair<double, long>> numeric;
+    };
+    std::shared_ptr<const KeyIndex> GetIndex(size_t field) const;
+    void PublishIndex(size_t field, const std::shared_ptr<const KeyIndex>& index);
+
+private:
+    struct Image {
+        uint64_t version;           // the version whose write replaced these bytes
+        std::vector<char> bytes;
+    };
+
+    std::string filename;
+    unsigned short header_size;
+    unsigned short record_size;
+    std::vector<FIELD_DESCRIPTOR> fields;
+
+    mutable std::shared_mutex lock;
+    uint64_t committed = 0;
+    unsigned committed_records;
+    unsigned committed_rewrites;    // the header's rewrite_count at that version
+    std::map<long, std::vector<Image>> images;   // per slot, oldest first
+    std::multiset<uint64_t> readers;
+    std::multiset<unsigned> reader_records;
+    // Swapped with std::atomic_load/atomic_store, never under the lock
+    std::vector<std::shared_ptr<const KeyIndex>> indexes;
+
+    void Collect();
+};
+
+// Read-only view of a table as of one committed version, for one reader
+// thread. Any number of snapshots can be read on different threads while
+// the DBFManager goes on writing: each has its own file handle and reads by
+// position, rows changed since come from the version store, and key
+// lookups walk an immutable index without taking any lock.
+class DBFSnapshot {
+public:
+    explicit DBFSnapshot(const std::shared_ptr<DBFVersionStore>& store);
+    ~DBFSnapshot();
+    DBFSnapshot(const DBFSnapshot&) = delete;
+    DBFSnapshot& operator=(const DBFSnapshot&) = delete;
+
+    bool isOpen() const { return file != INVALID_HANDLE_VALUE; }
+    uint64_t Version() const { return version; }
+    unsigned RecordCount() const { return records; }
+    // The table's RewriteCount as of the snapshot
+    unsigned RewriteCount() const { return rewrites; }
+    const std::vector<FIELD_DESCRIPTOR>& GetFields() const { return store->GetFields(); }
+    unsigned short GetHeaderSize() const { return store->GetHeaderSize(); }
+    unsigned short RecordSize() const { return store->RecordSize(); }
+    long PositionOfRecno(unsigned recno) const {
+        return store->GetHeaderSize() + (long)(recno - 1) * store->RecordSize();
+    }
+
+    // Raw records as of the snapshot, count * RecordSize bytes
+    const char* ReadRecordBlock(unsigned first, unsigned count, std::vector<char>& scratch);
+    bool ReadRecordAt(long pos, std::vector<std::string>& out);
+
+    // Same matching as DBFManager::FindAll and GetByFieldKey
+    //
+    // PrepareIndex builds (or shares) the key index of fieldName up front:
+    // false when the field is missing or the index can't be read. After
+    // it, FindAll returning false only means nothing matched.
+    bool PrepareIndex(const std::string& fieldName);
+    bool FindAll(const std::string& fieldName, const std::string& key, std::vector<long>& positions);
+    bool GetByFieldKey(const std::string& fieldName, const std::string& key, std::vector<std::string>& out);
+    bool GetAllRecords(std::vector<std::vector<std::string>>& out);
+
+private:
+    std::shared_ptr<DBFVersionStore> store;
+    HANDLE file = INVALID_HANDLE_VALUE;
+    uint64_t version = 0;
+    unsigned records = 0;
+    unsigned rewrites = 0;
+    std::vector<char> record_buffer;
+    std::vector<std::shared_ptr<const DBFVersionStore::KeyIndex>> indexes;
+
+    bool ReadAt(long pos, char* out, size_t length);
+    size_t FindFieldNumber(const std::string& fieldName) const;
+    const DBFVersionStore::KeyIndex* LoadIndex(size_t field);
+    void DecodeRecord(const char* record, std::vector<std::string>& out) const;
+};
+
+#endif
@@ -1,43 +1,34 @@
 #include "DBFTableManager.h"
 
-std::string DBFTableManager::FormatFieldValue(const FIELD_DESCRIPTOR& desc, const std::string& value) {
-    std::string formatted;
-
+bool DBFTableManager::EncodeFieldValue(const FIELD_DESCRIPTOR& desc, const std::string& value, char* out) {
     if (desc.type == 'N' || desc.type == 'F') {
-        char buffer[32];
-        double num = atof(value.c_str());
-        snprintf(buffer, sizeof(buffer), "%-*.*f", desc.length, desc.decimal, num);
-        formatted.assign(buffer, desc.length);
-    }
-    else {
-        formatted = value.substr(0, desc.length);
-        formatted.resize(desc.length, ' ');
+        return DBFFieldCodec::Encode(atof(value.c_str()), out, desc.length, desc.decimal);
     }
-    return formatted;
+    return DBFFieldCodec::Encode(value, out, desc.length, desc.decimal);
 }
 
 bool DBFTableManager::GetAllRecords(std::vector<std::map<std::string, std::string>>& out) {
     if (!Open()) return false;
 
-    std::vector<std::vector<std::string>> rawRecords;
-    if (!dbf.GetAllRecords(rawRecords)) return false;
-
-    for (const auto& rawRecord : rawRecords) {
+    // Straight from the record bytes, without a decoded copy of the table
+    DBFCursor cursor(dbf);
+    size_t count = std::min(fieldDescriptors.size(), dbf.GetFields().size());
+    for (const DBFRecordView& row : cursor) {
         std::map<std::string, std::string> record;
-        for (size_t i = 0; i < fieldDescriptors.size() && i < rawRecord.size(); ++i) {
-            record[fieldDescriptors[i].name] = rawRecord[i];
+        for (size_t i = 0; i < count; ++i) {
+            record[fieldDescriptors[i].name] = std::string(row.field(i));
         }
-        out.push_back(record);
+        out.push_back(std::move(record));
     }
-    return true;
+    return !cursor.Failed();
 }
 
 bool DBFTableManager::CreateDB() {
     if (fieldDescriptors.empty()) return false;
-    return dbf.CreateNew(filename, fieldDescriptors) && dbf.Open(filename);
+    return dbf.CreateNew(filename, fieldDescriptors) && dbf.Open(filename) && AttachExpressionIndexes();
 }
 
-bool DBFTableManager::AddRecord(const std::map<std::string, std::string>& fieldValues, bool inTransaction = false) {
+bool DBFTableManager::AddRecord(const std::map<std::string, std::string>& fieldValues, bool inTransaction) {
     if (!inTransaction && transactionState == TRANSACTION_ACTIVE) return false; // Require explicit transaction control
     if (!dbf.isOpen() && !CreateDB()) return false;
 
@@ -45,57 +36,75 @@ bool DBFTableManager::AddRecord(const std::map<std::string, std::string>& fieldV
     record.reserve(fieldDescriptors.size());
 
     for (const auto& desc : fieldDescriptors) {
-        std::string value;
+        std::string value(desc.length, ' ');
         auto it = fieldValues.find(desc.name);
-        if (it != fieldValues.end()) {
-            value = FormatFieldValue(desc, it->second);
-        }
-        else {
-            value.assign(desc.length, ' ');
-        }
+        if (it != fieldValues.end() && !EncodeFieldValue(desc, it->second, &value[0])) return false;
         record.push_back(value);
     }
 
     return dbf.AddRecord(record);
 }
 
-bool DBFTableManager::DeleteRecord(const std::string& keyField, const std::string& keyValue, bool inTransaction = false) {
+bool DBFTableManager::AddRecords(const std::vector<std::map<std::string, std::string>>& rows, bool inTransaction) {
+    if (!inTransaction && transactionState == TRANSACTION_ACTIVE) return false;
+    if (!Open() && !CreateDB()) return false;
+
+    const std::vector<FIELD_DESCRIPTOR>& fields = dbf.GetFields();
+    if (fields.size() != fieldDescriptors.size()) return false;
+
+    // Encoded straight into the record bytes; missing fields stay blank.
+    // A number too wide for its column fails the whole batch.
+    unsigned short record_size = dbf.RecordSize();
+    std::vector<char> records(rows.size() * record_size, ' ');
+    for (size_t row = 0; row < rows.size(); ++row) {
+        char* record = records.data() + row * record_size;
+        for (size_t i = 0; i < fieldDescriptors.size(); ++i) {
+            auto it = rows[row].find(fieldDescriptors[i].name);
+            if (it == rows[row].end()) continue;
+
+            if (!EncodeFieldValue(fields[i], it->second, record + fields[i].address)) return false;
+        }
+    }
+    return dbf.AddRawRecords(records.data(), rows.size());
+}
+
+bool DBFTableManager::DeleteRecord(const std::string& keyField, const std::string& keyValue, bool inTransaction) {
     if (!inTransaction && transactionState == TRANSACTION_ACTIVE) return false; // Require explicit transaction control
 
     const FIELD_DESCRIPTOR* keyDesc = GetFieldDescriptor(keyField);
     
-    if (!keyDesc) return false;
+    if (!keyDesc || !Open()) return false;
 
-    if (keyDesc->type == 'N' || keyDesc->type == 'F') {
-        return dbf.DeleteRecordByNumericKey(atof(keyValue.c_str()));
-    }
-    return dbf.DeleteRecordByTextKey(keyValue);
+    return dbf.DeleteByFieldKey(keyField, keyValue);
 }
 
 bool DBFTableManager::UpdateRecord(const std::string& keyField, const std::string& keyValue,
-    const std::map<std::string, std::string>& updates, bool inTransaction = false) {
+    const std::map<std::string, std::string>& updates, bool inTransaction) {
     if (!inTransaction && transactionState == TRANSACTION_ACTIVE) return false;
 
-    if (!DeleteRecord(keyField, keyValue)) return false;
+    if (!GetFieldDescriptor(keyField) || !Open()) return false;
 
-    return AddRecord(updates);
+    // Rewritten in place; fields missing from updates keep their values
+    std::map<std::string, std::string> formatted;
+    for (const auto& update : updates) {
+        const FIELD_DESCRIPTOR* desc = GetFieldDescriptor(update.first);
+        if (!desc) return false;
+        std::string value(desc->length, ' ');
+        if (!EncodeFieldValue(*desc, update.second, &value[0])) return false;
+        formatted[update.first] = value;
+    }
+    return dbf.UpdateByFieldKey(keyField, keyValue, formatted);
 }
 
 bool DBFTableManager::GetRecord(const std::string& keyField,
     const std::string& keyValue,
     std::map<std::string, std::string>& out) {
     std::vector<std::string> record;
-    bool success = false;
 
     const FIELD_DESCRIPTOR* keyDesc = GetFieldDescriptor(keyField);
-    if (!keyDesc) return false;
+    if (!keyDesc || !Open()) return false;
 
-    if (keyDesc->type == 'N' || keyDesc->type == 'F') {
-        success = dbf.GetByNumericKey(atof(keyValue.c_str()), record);
-    }
-    else {
-        success = dbf.GetByTextKey(keyValue, record);
-    }
+    bool success = dbf.GetByFieldKey(keyField, keyValue, record);
 
     if (success && record.size() == fieldDescriptors.size()) {
         for (size_t i = 0; i < fieldDescriptors.size(); ++i) {
@@ -120,13 +129,12 @@ bool DBFTableManager::ValidateField(const std::string& fieldName, const std::str
 }
 
 // Transaction Management
-bool DBFTableManager::BeginTransaction() {
-    if (transactionState != TRANSACTION_NONE) {
+bool DBFTableManager::BeginTransaction(const std::string& masterJournal) {
+    if (transactionState == TRANSACTION_ACTIVE) {
         return false;
     }
 
-    tempTransactionFile = filename + ".tmp";
-    if (!CreateBackup()) {
+    if (!Open() || !dbf.BeginJournal(masterJournal)) {
         transactionState = TRANSACTION_FAILED;
         return false;
     }
@@ -140,7 +148,7 @@ bool DBFTableManager::CommitTransaction() {
         return false;
     }
 
-    if (!FinalizeTransaction()) {
+    if (!dbf.CommitJournal()) {
         transactionState = TRANSACTION_FAILED;
         return false;
     }
@@ -150,11 +158,12 @@ bool DBFTableManager::CommitTransaction() {
 }
 
 bool DBFTableManager::RollbackTransaction() {
-    if (transactionState != TRANSACTION_ACTIVE) {
+    if (transactionState != TRANSACTION_ACTIVE && transactionState != TRANSACTION_FAILED) {
         return false;
     }
 
-    if (!RestoreBackup()) {
+    // A failed commit still holds its journal; undo it here
+    if (dbf.InJournal() && !dbf.RollbackJournal()) {
         transactionState = TRANSACTION_FAILED;
         return false;
     }
@@ -162,34 +171,3 @@ bool DBFTableManager::RollbackTransaction() {
     transactionState = TRANSACTION_NONE;
     return true;
 }
-
-// Private Helpers
-bool DBFTableManager::CreateBackup() {
-    std::ifstream src(filename, std::ios::binary);
-    if (!src.is_open()) return false;
-
-    std::ofstream dst(tempTransactionFile, std::ios::binary);
-    if (!dst.is_open()) return false;
-
-    dst << src.rdbuf();
-    return src && dst;
-}
-
-bool DBFTableManager::RestoreBackup() {
-    dbf.close();
-
-    if (std::remove(filename.c_str()) != 0) {
-        return false;
-    }
-
-    if (std::rename(tempTransactionFile.c_str(), filename.c_str()) != 0) {
-        return false;
-    }
-
-    return dbf.Open(filename);
-}
-
-bool DBFTableManager::FinalizeTransaction() {
-    dbf.close();
-    return std::remove(tempTransactionFile.c_str()) == 0;
-}
\ No newline at end of file
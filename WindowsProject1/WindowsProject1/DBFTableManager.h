@@ -2,6 +2,9 @@
 #define DBFTABLEMANAGER_H
 
 #include "DBFManager.h"
+#include "DBFCursor.h"
+#include "DBFParallelScan.h"
+#include "DBFSchema.h"
 #include <algorithm>
 #include <cstring>
 #include <map>
@@ -21,9 +24,19 @@ protected:
     std::string filename;
     std::vector<FIELD_DESCRIPTOR> fieldDescriptors;
     TransactionState transactionState;
-    std::string tempTransactionFile;
+    // Expression indexes by tag, added to the table whenever it is opened
+    std::map<std::string, std::string> expressionIndexes;
 
-    std::string FormatFieldValue(const FIELD_DESCRIPTOR& desc, const std::string& value);
+    bool AttachExpressionIndexes() {
+        for (const auto& index : expressionIndexes) {
+            if (!dbf.HasExpressionIndex(index.first)) dbf.AddExpressionIndex(index.first, index.second);
+        }
+        return true;
+    }
+
+    // Writes desc.length bytes as the typed path does: numbers right-justified,
+    // text cut to the column. False when a number does not fit its column.
+    bool EncodeFieldValue(const FIELD_DESCRIPTOR& desc, const std::string& value, char* out);
 
     const FIELD_DESCRIPTOR* GetFieldDescriptor(const std::string& fieldName) const {
         for (const auto& desc : fieldDescriptors) {
@@ -39,16 +52,84 @@ public:
         : filename(file),
         transactionState(TRANSACTION_NONE) {}
 
+    const std::string& GetFileName() const { return filename; }
+
+    // Reuses the open table instead of re-reading it on every call
     bool Open() {
-        return dbf.Open(filename);
+        return dbf.isOpen() || (dbf.Open(filename) && AttachExpressionIndexes());
+    }
+
+    // Keep an on-disk index for a field; call before the table is opened
+    bool AddPersistentIndex(const std::string& fieldName) {
+        return dbf.AddPersistentIndex(fieldName);
+    }
+
+    // Composite index on an xBase key expression such as kbrg+DTOS(tjual)
+    // (see DBFManager::AddExpressionIndex). May be called before the table
+    // exists: it is added whenever the table is opened or created. Built by
+    // its first lookup, then kept current by every write.
+    bool AddExpressionIndex(const std::string& tag, const std::string& expression) {
+        expressionIndexes[tag] = expression;
+        return !dbf.isOpen() || dbf.AddExpressionIndex(tag, expression);
+    }
+
+    // Positions of the live rows whose key lies in [low, high], in key
+    // order. False when the table has no such index or it could not be
+    // read, so the caller scans instead; true and no positions when
+    // nothing matched.
+    bool FindKeyRange(const std::string& tag, const std::string& low, const std::string& high,
+        std::vector<long>& positions) {
+        positions.clear();
+        return Open() && dbf.FindExpressionRange(tag, low, high, positions);
+    }
+
+    // Raw bytes of the record at pos, read through the page pool into
+    // scratch
+    const char* ReadRawRecord(long pos, std::vector<char>& scratch) {
+        if (!Open()) return nullptr;
+        scratch.resize(dbf.RecordSize());
+        return dbf.ReadRawRecordAt(pos, scratch.data()) ? scratch.data() : nullptr;
     }
 
     bool GetAllRecords(std::vector<std::map<std::string, std::string>>& out);
 
+    // Walks the live rows one at a time instead of loading them all; the
+    // table must not be written during the walk (see DBFCursor.h)
+    DBFCursor OpenCursor() {
+        Open();
+        return DBFCursor(dbf);
+    }
+
+    // Chunked pass over the raw records on several threads (see
+    // DBFParallelScan.h); threads = 0 uses every core
+    DBFParallelScan OpenParallelScan(unsigned threads = 0) {
+        Open();
+        return DBFParallelScan(dbf, threads);
+    }
+
+    // Committed rows only, readable from any thread while the table is
+    // written (see DBFSnapshot.h); nullptr when there is no file
+    std::shared_ptr<DBFSnapshot> OpenSnapshot() {
+        return Open() ? dbf.OpenSnapshot() : nullptr;
+    }
+
+    // Records in the file, deleted ones included (0 when there is no file)
+    unsigned RecordCount() {
+        return Open() ? dbf.RecordCount() : 0;
+    }
+
+    // See DBFManager::RewriteCount
+    unsigned RewriteCount() {
+        return Open() ? dbf.RewriteCount() : 0;
+    }
+
     bool CreateDB();
 
     bool AddRecord(const std::map<std::string, std::string>& fieldValues, bool inTransaction = false);
 
+    // Imports many rows with a single append (see DBFManager::AddRawRecords)
+    bool AddRecords(const std::vector<std::map<std::string, std::string>>& rows, bool inTransaction = false);
+
     bool DeleteRecord(const std::string& keyField, const std::string& keyValue, bool inTransaction = false);
 
     bool UpdateRecord(const std::string& keyField, const std::string& keyValue,
@@ -58,6 +139,53 @@ public:
         const std::string& keyValue,
         std::map<std::string, std::string>& out);
 
+    // Typed access through a compile-time schema (DBFSchema.h): the record
+    // is encoded/decoded in place, with no per-field maps or strings
+    template <typename Struct>
+    bool GetTypedRecord(const std::string& keyField, const std::string& keyValue, Struct& out) {
+        if (!Open() || !DBFRecordLayout<Struct>::Matches(dbf.GetFields())) return false;
+
+        const char* record = dbf.GetRawByFieldKey(keyField, keyValue);
+        if (!record) return false;
+        DBFRecordLayout<Struct>::Decode(record, out);
+        return true;
+    }
+
+    template <typename Struct>
+    bool AddTypedRecord(const Struct& in, bool inTransaction = false) {
+        if (!inTransaction && transactionState == TRANSACTION_ACTIVE) return false;
+        if (!Open() && !CreateDB()) return false;
+        if (!DBFRecordLayout<Struct>::Matches(dbf.GetFields())) return false;
+
+        char record[DBFRecordLayout<Struct>::RecordSize];
+        return DBFRecordLayout<Struct>::Encode(in, record) && dbf.AddRawRecord(record);
+    }
+
+    template <typename Struct>
+    bool AddTypedRecords(const std::vector<Struct>& rows, bool inTransaction = false) {
+        if (!inTransaction && transactionState == TRANSACTION_ACTIVE) return false;
+        if (!Open() && !CreateDB()) return false;
+        if (!DBFRecordLayout<Struct>::Matches(dbf.GetFields())) return false;
+
+        const size_t size = DBFRecordLayout<Struct>::RecordSize;
+        std::vector<char> records(rows.size() * size);
+        for (size_t i = 0; i < rows.size(); ++i) {
+            if (!DBFRecordLayout<Struct>::Encode(rows[i], records.data() + i * size)) return false;
+        }
+        return dbf.AddRawRecords(records.data(), rows.size());
+    }
+
+    template <typename Struct>
+    bool UpdateTypedRecord(const std::string& keyField, const std::string& keyValue,
+        const Struct& in, bool inTransaction = false) {
+        if (!inTransaction && transactionState == TRANSACTION_ACTIVE) return false;
+        if (!Open() || !DBFRecordLayout<Struct>::Matches(dbf.GetFields())) return false;
+
+        // Same slot, same record number; only changed fields are written
+        char record[DBFRecordLayout<Struct>::RecordSize];
+        return DBFRecordLayout<Struct>::Encode(in, record) && dbf.UpdateRawByFieldKey(keyField, keyValue, record);
+    }
+
     bool PackDatabase() {
         return dbf.Pack();
     }
@@ -69,18 +197,15 @@ public:
 
     bool ValidateField(const std::string& fieldName, const std::string& value) const;
 
-    bool BeginTransaction();
+    // Journaled through DBFManager::BeginJournal; only the rows touched
+    // are copied, never the whole file
+    bool BeginTransaction(const std::string& masterJournal = "");
     bool CommitTransaction();
     bool RollbackTransaction();
+    bool SyncToDisk() { return dbf.Sync(); }
     TransactionState GetTransactionState() const {
         return transactionState;
     }
-
-
-private:
-    bool CreateBackup();
-    bool RestoreBackup();
-    bool FinalizeTransaction();
 };
 
 #endif
\ No newline at end of file
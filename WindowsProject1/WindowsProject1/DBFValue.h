@@ -1,7 +1,11 @@
 #ifndef DBFVALUE_H
 #define DBFVALUE_H
 
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <string>
+#include <string_view>
 
 class DBFValue {
 public:
@@ -29,4 +33,113 @@ public:
     bool isNumber() const override { return true; }
 };
 
+// Non-virtual 16-byte value used by DBFRowCache. Numbers and text up to
+// INLINE_TEXT bytes are stored in the value itself; longer text is an
+// offset/length pair into the owning cache's arena.
+class DBFCompactValue {
+public:
+    enum Tag : unsigned char { TAG_EMPTY, TAG_NUMBER, TAG_TEXT, TAG_ARENA };
+    static const size_t INLINE_TEXT = 14;
+
+    DBFCompactValue() { memset(bytes, 0, sizeof(bytes)); }
+
+    static DBFCompactValue Number(double value) {
+        DBFCompactValue out;
+        memcpy(out.bytes, &value, sizeof(value));
+        out.bytes[15] = TAG_NUMBER;
+        return out;
+    }
+
+    // length must not exceed INLINE_TEXT
+    static DBFCompactValue Text(const char* text, size_t length) {
+        DBFCompactValue out;
+        memcpy(out.bytes, text, length);
+        out.bytes[14] = (unsigned char)length;
+        out.bytes[15] = TAG_TEXT;
+        return out;
+    }
+
+    static DBFCompactValue ArenaText(uint32_t offset, uint32_t length) {
+        DBFCompactValue out;
+        memcpy(out.bytes, &offset, sizeof(offset));
+        memcpy(out.bytes + 4, &length, sizeof(length));
+        out.bytes[15] = TAG_ARENA;
+        return out;
+    }
+
+    Tag tag() const { return (Tag)bytes[15]; }
+    bool isNumber() const { return tag() == TAG_NUMBER; }
+
+    std::string_view text(const char* arena) const {
+        if (tag() == TAG_TEXT) return std::string_view(reinterpret_cast<const char*>(bytes), bytes[14]);
+        if (tag() != TAG_ARENA) return std::string_view();
+
+        uint32_t offset, length;
+        memcpy(&offset, bytes, sizeof(offset));
+        memcpy(&length, bytes + 4, sizeof(length));
+        return std::string_view(arena + offset, length);
+    }
+
+    double toDouble(const char* arena) const {
+        if (isNumber()) {
+            double value;
+            memcpy(&value, bytes, sizeof(value));
+            return value;
+        }
+        std::string value(text(arena));
+        return atof(value.c_str());
+    }
+
+    std::string toString(const char* arena) const {
+        return isNumber() ? std::to_string(toDouble(arena)) : std::string(text(arena));
+    }
+
+private:
+    // [0..13] inline text, or [0..7] number / arena offset+length;
+    // [14] inline length; [15] tag
+    alignas(8) unsigned char bytes[16];
+};
+
+// Value of a blank-padded fixed-point field such as "   -12.50" (blank is
+// 0). Up to 15 digits the digits are an exact integer and one division by
+// an exact power of ten rounds the same as strtod; anything else goes to
+// strtod.
+inline double ParseDBFNumber(const char* raw, size_t length) {
+    static const double powers_of_ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+        1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+    size_t i = 0;
+    while (i < length && raw[i] == ' ') ++i;
+    if (i == length) return 0;
+
+    bool negative = raw[i] == '-';
+    if (negative || raw[i] == '+') ++i;
+
+    int64_t digits = 0;
+    unsigned count = 0, decimals = 0;
+    bool point = false;
+    for (; i < length; ++i) {
+        char c = raw[i];
+        if (c >= '0' && c <= '9') {
+            // Past 15 digits strtod takes over; stop before int64_t can overflow
+            if (++count <= 15) digits = digits * 10 + (c - '0');
+            if (point) decimals++;
+        }
+        else if (c == '.' && !point) point = true;
+        else break;
+    }
+    while (i < length && raw[i] == ' ') ++i;
+
+    if (i != length || count > 15) {
+        char buffer[64];
+        if (length >= sizeof(buffer)) length = sizeof(buffer) - 1;
+        memcpy(buffer, raw, length);
+        buffer[length] = '\0';
+        return strtod(buffer, nullptr);
+    }
+
+    double value = (double)digits / powers_of_ten[decimals];
+    return negative ? -value : value;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "FIFOCostLayers.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+int32_t FIFOCostLayers::DateKey(const std::string& date) {
+    int32_t key = 0;
+    for (size_t i = 0; i < date.size() && i < 8; i++) {
+        if (date[i] < '0' || date[i] > '9') return 0;
+        key = key * 10 + (date[i] - '0');
+    }
+    return key;
+}
+
+// The product's ledger when the movement can be applied in place
+FIFOCostLayers::Ledger* FIFOCostLayers::Accept(const std::string& productId, int32_t date) {
+    unsaved++;
+    Ledger& ledger = ledgers[productId];
+    if (ledger.stale) return nullptr;
+    if (date < ledger.last_date) {
+        ledger.stale = true;
+        return nullptr;
+    }
+    ledger.last_date = date;
+    return &ledger;
+}
+
+void FIFOCostLayers::Purchase(const std::string& productId, int32_t date, int32_t quantity, double unitCost) {
+    Ledger* ledger = Accept(productId, date);
+    if (ledger && quantity > 0) ledger->layers.push_back({ quantity, unitCost });
+}
+
+void FIFOCostLayers::Sale(const std::string& productId, int32_t date, int32_t quantity) {
+    Ledger* ledger = Accept(productId, date);
+    if (!ledger) return;
+
+    int32_t remaining = quantity < 0 ? -quantity : quantity;
+    double cost = 0;
+    while (remaining > 0 && !ledger->layers.empty()) {
+        Layer& oldest = ledger->layers.front();
+        int32_t used = std::min(remaining, oldest.quantity);
+        cost += used * oldest.unitCost;
+        remaining -= used;
+        oldest.quantity -= used;
+        if (oldest.quantity == 0) ledger->layers.pop_front();
+    }
+
+    auto& sold = ledger->sold;
+    if (!sold.empty() && sold.back().first == date) sold.back().second += cost;
+    else sold.emplace_back(date, (sold.empty() ? 0 : sold.back().second) + cost);
+}
+
+bool FIFOCostLayers::NeedsReplay(const std::string& productId) const {
+    auto it = ledgers.find(productId);
+    return it != ledgers.end() && it->second.stale;
+}
+
+void FIFOCostLayers::Reset(const std::string& productId) {
+    ledgers[productId] = Ledger();
+}
+
+void FIFOCostLayers::Clear() {
+    ledgers.clear();
+    synced_records = synced_rewrites = 0;
+    unsaved = 0;
+}
+
+double FIFOCostLayers::SoldThrough(const Ledger& ledger, int32_t date) {
+    auto after = std::upper_bound(ledger.sold.begin(), ledger.sold.end(), date,
+        [](int32_t d, const std::pair<int32_t, double>& entry) { return d < entry.first; });
+    return after == ledger.sold.begin() ? 0 : (after - 1)->second;
+}
+
+double FIFOCostLayers::COGS(const std::string& productId, int32_t from, int32_t to) const {
+    auto it = ledgers.find(productId);
+    if (it == ledgers.end() || to < from) return 0;
+    return SoldThrough(it->second, to) - SoldThrough(it->second, from - 1);
+}
+
+const std::deque<FIFOCostLayers::Layer>* FIFOCostLayers::GetLayers(const std::string& productId) const {
+    auto it = ledgers.find(productId);
+    return it == ledgers.end() ? nullptr : &it->second.layers;
+}
+
+// Per product: id length and bytes, last date, stale flag, then the layers
+// and the sold entries, each preceded by their count
+bool FIFOCostLayers::Save(const std::string& filepath) {
+    std::string tempfile = filepath + ".tmp";
+    {
+        std::ofstream out(tempfile, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        FIFO_HEADER header = {};
+        memcpy(header.magic, "DBFFIFO1", 8);
+        header.product_count = (unsigned int)ledgers.size();
+        header.synced_records = synced_records;
+        header.synced_rewrites = synced_rewrites;
+        out.write((const char*)&header, sizeof(header));
+
+        for (const auto& entry : ledgers) {
+            const Ledger& ledger = entry.second;
+            uint16_t id_length = (uint16_t)entry.first.size();
+            uint8_t stale = ledger.stale ? 1 : 0;
+            uint32_t layers = (uint32_t)ledger.layers.size();
+            uint32_t sold = (uint32_t)ledger.sold.size();
+
+            out.write((const char*)&id_length, sizeof(id_length));
+            out.write(entry.first.data(), id_length);
+            out.write((const char*)&ledger.last_date, sizeof(ledger.last_date));
+            out.write((const char*)&stale, sizeof(stale));
+            out.write((const char*)&layers, sizeof(layers));
+            for (const Layer& layer : ledger.layers) {
+                out.write((const char*)&layer.quantity, sizeof(layer.quantity));
+                out.write((const char*)&layer.unitCost, sizeof(layer.unitCost));
+            }
+            out.write((const char*)&sold, sizeof(sold));
+            for (const auto& s : ledger.sold) {
+                out.write((const char*)&s.first, sizeof(s.first));
+                out.write((const char*)&s.second, sizeof(s.second));
+            }
+        }
+        if (!out.flush()) return false;
+    }
+
+    remove(filepath.c_str());
+    if (rename(tempfile.c_str(), filepath.c_str()) != 0) return false;
+    unsaved = 0;
+    return true;
+}
+
+// A missing, foreign or truncated file leaves the state empty
+bool FIFOCostLayers::Load(const std::string& filepath) {
+    Clear();
+    std::ifstream in(filepath, std::ios::binary);
+    if (!in) return false;
+
+    FIFO_HEADER header;
+    if (!in.read((char*)&header, sizeof(header)) || memcmp(header.magic, "DBFFIFO1", 8) != 0) return false;
+
+    for (unsigned p = 0; p < header.product_count; p++) {
+        uint16_t id_length;
+        if (!in.read((char*)&id_length, sizeof(id_length))) break;
+        std::string id(id_length, '\0');
+        Ledger ledger;
+        uint8_t stale = 0;
+        uint32_t layers = 0, sold = 0;
+        if (!in.read(&id[0], id_length) ||
+            !in.read((char*)&ledger.last_date, sizeof(ledger.last_date)) ||
+            !in.read((char*)&stale, sizeof(stale)) ||
+            !in.read((char*)&layers, sizeof(layers))) break;
+        ledger.stale = stale != 0;
+
+        for (uint32_t i = 0; i < layers && in; i++) {
+            Layer layer;
+            in.read((char*)&layer.quantity, sizeof(layer.quantity));
+            in.read((char*)&layer.unitCost, sizeof(layer.unitCost));
+            ledger.layers.push_back(layer);
+        }
+        if (!in.read((char*)&sold, sizeof(sold))) break;
+        for (uint32_t i = 0; i < sold && in; i++) {
+            std::pair<int32_t, double> entry;
+            in.read((char*)&entry.first, sizeof(entry.first));
+            in.read((char*)&entry.second, sizeof(entry.second));
+            ledger.sold.push_back(entry);
+        }
+        if (!in) break;
+        ledgers.emplace(std::move(id), std::move(ledger));
+    }
+
+    if (ledgers.size() != header.product_count) {
+        Clear();
+        return false;
+    }
+    synced_records = header.synced_records;
+    synced_rewrites = header.synced_rewrites;
+    return true;
+}
@@ -0,0 +1,90 @@
+#ifndef FIFO_COST_LAYERS_H
+#define FIFO_COST_LAYERS_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#pragma pack(push, 1)
+struct FIFO_HEADER {
+    char magic[8];                  // "DBFFIFO1"
+    unsigned int product_count;
+    unsigned int synced_records;    // movements applied, counted in file order
+    unsigned int synced_rewrites;   // the table's RewriteCount when they were read
+    char unused[12];
+};
+#pragma pack(pop)
+
+// Perpetual FIFO state of every product: the purchase layers still on hand,
+// oldest first, and the running cost of goods sold after each sale date.
+// Movements are applied once, in file order, as they are recorded; the COGS
+// of any date window is then two binary searches instead of a replay of the
+// product's history.
+//
+// A sale consumes the layers left by everything before it, purchases dated
+// before the window included. Units sold beyond what is on hand cost
+// nothing. A movement dated before the last one applied to its product
+// cannot be applied in place: the product is marked and its movements must
+// be replayed in date order (Reset, then Purchase/Sale) before the next
+// COGS.
+//
+// Save writes the whole state next to the movements table, Load reads it
+// back so that only the movements appended since have to be applied.
+class FIFOCostLayers {
+public:
+    struct Layer {
+        int32_t quantity;
+        double unitCost;
+    };
+
+    // Dates are YYYYMMDD as stored in a 'D' field
+    void Purchase(const std::string& productId, int32_t date, int32_t quantity, double unitCost);
+    void Sale(const std::string& productId, int32_t date, int32_t quantity);
+
+    bool NeedsReplay(const std::string& productId) const;
+    // Forgets one product before its movements are replayed
+    void Reset(const std::string& productId);
+    void Clear();
+
+    // Cost of the units sold on dates within [from, to]
+    double COGS(const std::string& productId, int32_t from, int32_t to) const;
+    // Layers on hand, oldest first (nullptr for an unknown product)
+    const std::deque<Layer>* GetLayers(const std::string& productId) const;
+
+    unsigned SyncedRecords() const { return synced_records; }
+    unsigned SyncedRewrites() const { return synced_rewrites; }
+    void SetSynced(unsigned records, unsigned rewrites) {
+        synced_records = records;
+        synced_rewrites = rewrites;
+    }
+    // Movements applied since the last Save or Load
+    unsigned Unsaved() const { return unsaved; }
+
+    bool Load(const std::string& filepath);
+    bool Save(const std::string& filepath);
+
+    // YYYYMMDD of a stored date, 0 when blank
+    static int32_t DateKey(const std::string& date);
+
+private:
+    struct Ledger {
+        std::deque<Layer> layers;
+        int32_t last_date = 0;
+        bool stale = false;
+        // (sale date, cost of every sale up to and including that date)
+        std::vector<std::pair<int32_t, double>> sold;
+    };
+
+    std::unordered_map<std::string, Ledger> ledgers;
+    unsigned synced_records = 0;
+    unsigned synced_rewrites = 0;
+    unsigned unsaved = 0;
+
+    Ledger* Accept(const std::string& productId, int32_t date);
+    static double SoldThrough(const Ledger& ledger, int32_t date);
+};
+
+#endif
@@ -0,0 +1,740 @@
+#include "ForExpression.h"
+#include "DBFManager.h"
+#include "DBFValue.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    // YYYYMMDD from stored date bytes, 0 when blank or damaged
+    int ReadDate(const char* raw, size_t length) {
+        if (length < 8) return 0;
+        int value = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            if (raw[i] < '0' || raw[i] > '9') return 0;
+            value = value * 10 + (raw[i] - '0');
+        }
+        return value;
+    }
+
+    // Days since 1970-01-01 and back, proleptic Gregorian
+    long DaysFromCivil(int y, int m, int d) {
+        y -= m <= 2;
+        long era = (y >= 0 ? y : y - 399) / 400;
+        long yoe = y - era * 400;
+        long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+        long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + doe - 719468;
+    }
+
+    int CivilFromDays(long z) {
+        z += 719468;
+        long era = (z >= 0 ? z : z - 146096) / 146097;
+        long doe = z - era * 146097;
+        long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        long mp = (5 * doy + 2) / 153;
+        int d = (int)(doy - (153 * mp + 2) / 5 + 1);
+        int m = (int)(mp < 10 ? mp + 3 : mp - 9);
+        int y = (int)(yoe + era * 400) + (m <= 2);
+        return y * 10000 + m * 100 + d;
+    }
+
+    long DaysOf(int date) {
+        return DaysFromCivil(date / 10000, date / 100 % 100, date % 100);
+    }
+
+    // 0 unless y/m/d is a real day
+    int MakeDate(int y, int m, int d) {
+        if (y < 1 || y > 9999 || m < 1 || m > 12 || d < 1 || d > 31) return 0;
+        int date = y * 10000 + m * 100 + d;
+        return CivilFromDays(DaysOf(date)) == date ? date : 0;
+    }
+
+    // mm/dd/yy or mm/dd/yyyy, any of / - . between; iso is yyyy-mm-dd
+    int ParseDateText(std::string_view text, bool iso) {
+        int parts[3] = { 0, 0, 0 };
+        int digits[3] = { 0, 0, 0 };
+        int part = 0;
+        for (char c : text) {
+            if (c >= '0' && c <= '9') {
+                if (part > 2) return 0;
+                parts[part] = parts[part] * 10 + (c - '0');
+                digits[part]++;
+            }
+            else if (c == '/' || c == '-' || c == '.') {
+                if (digits[part] == 0) return 0;
+                part++;
+            }
+            else if (c != ' ') return 0;
+        }
+        if (part != 2 || digits[2] == 0) return 0;
+
+        if (iso) return MakeDate(parts[0], parts[1], parts[2]);
+        int year = parts[2];
+        if (digits[2] <= 2) year += year < 50 ? 2000 : 1900;
+        return MakeDate(year, parts[0], parts[1]);
+    }
+
+    std::string_view TrimRight(std::string_view text) {
+        size_t end = text.find_last_not_of(" \t\r\n");
+        return end == std::string_view::npos ? std::string_view() : text.substr(0, end + 1);
+    }
+
+    std::string_view TrimLeft(std::string_view text) {
+        size_t start = text.find_first_not_of(" \t\r\n");
+        return start == std::string_view::npos ? std::string_view() : text.substr(start);
+    }
+
+    size_t Clamp(double count, size_t limit) {
+        if (!(count > 0)) return 0;
+        return count >= (double)limit ? limit : (size_t)count;
+    }
+}
+
+void ForExpression::SetText(const std::string& name, const std::string& value) {
+    variables[KeyName(name)] = { 'C', value, 0, false };
+}
+
+void ForExpression::SetNumber(const std::string& name, double value) {
+    variables[KeyName(name)] = { 'N', "", value, false };
+}
+
+void ForExpression::SetDate(const std::string& name, const std::string& yyyymmdd) {
+    variables[KeyName(name)] = { 'D', "", (double)ReadDate(yyyymmdd.c_str(), yyyymmdd.size()), false };
+}
+
+void ForExpression::SetLogical(const std::string& name, bool value) {
+    variables[KeyName(name)] = { 'L', "", 0, value };
+}
+
+std::string ForExpression::KeyName(const std::string& name) {
+    std::string key;
+    for (char c : name) key += (char)toupper((unsigned char)c);
+    return key;
+}
+
+bool ForExpression::Compile(const std::string& expression, const std::vector<FIELD_DESCRIPTOR>& fields) {
+    source = expression;
+    nodes.clear();
+    root = -1;
+    slots = 0;
+    table_fields = &fields;
+    cursor = source.c_str();
+
+    int top = ParseOr();
+    bool ok = top >= 0;
+    if (ok) {
+        SkipBlanks();
+        ok = *cursor == '\0' && TypeOf(top) == 'L';
+    }
+    table_fields = nullptr;
+    cursor = nullptr;
+    if (!ok) {
+        nodes.clear();
+        return false;
+    }
+
+    root = top;
+    own_scratch.text.assign(slots, std::string());
+    return true;
+}
+
+bool ForExpression::Matches(const char* record, Scratch& scratch) const {
+    if (root < 0) return false;
+    if (scratch.text.size() < (size_t)slots) scratch.text.resize(slots);
+    return Evaluate(root, record, scratch).logical;
+}
+
+void ForExpression::SkipBlanks() {
+    while (*cursor == ' ' || *cursor == '\t') ++cursor;
+}
+
+bool ForExpression::Accept(char c) {
+    SkipBlanks();
+    if (*cursor != c) return false;
+    ++cursor;
+    return true;
+}
+
+// Dotted operators and logicals: .AND. .or. .T. ...
+bool ForExpression::AcceptWord(const char* word) {
+    SkipBlanks();
+    size_t length = strlen(word);
+    if (_strnicmp(cursor, word, length) != 0) return false;
+    cursor += length;
+    return true;
+}
+
+bool ForExpression::ParseName(std::string& name) {
+    SkipBlanks();
+    name.clear();
+    if (!isalpha((unsigned char)*cursor) && *cursor != '_') return false;
+    while (isalnum((unsigned char)*cursor) || *cursor == '_') name += (char)toupper((unsigned char)*cursor++);
+    return true;
+}
+
+int ForExpression::ParseOr() {
+    int left = ParseAnd();
+    while (left >= 0 && AcceptWord(".OR.")) {
+        int right = ParseAnd();
+        if (right < 0 || TypeOf(left) != 'L' || TypeOf(right) != 'L') return -1;
+        left = Fold(Add(OP_OR, 'L', { left, right }));
+    }
+    return left;
+}
+
+int ForExpression::ParseAnd() {
+    int left = ParseNot();
+    while (left >= 0 && AcceptWord(".AND.")) {
+        int right = ParseNot();
+        if (right < 0 || TypeOf(left) != 'L' || TypeOf(right) != 'L') return -1;
+        left = Fold(Add(OP_AND, 'L', { left, right }));
+    }
+    return left;
+}
+
+int ForExpression::ParseNot() {
+    if (Accept('!') || AcceptWord(".NOT.")) {
+        int operand = ParseNot();
+        if (operand < 0 || TypeOf(operand) != 'L') return -1;
+        return Fold(Add(OP_NOT, 'L', { operand }));
+    }
+    return ParseCompare();
+}
+
+int ForExpression::ParseCompare() {
+    int left = ParseSum();
+    if (left < 0) return -1;
+
+    SkipBlanks();
+    Op op;
+    size_t length = 2;
+    if (cursor[0] == '=' && cursor[1] == '=') op = OP_EXACT;
+    else if (cursor[0] == '<' && cursor[1] == '>') op = OP_NOT_EQUAL;
+    else if (cursor[0] == '!' && cursor[1] == '=') op = OP_NOT_EQUAL;
+    else if (cursor[0] == '<' && cursor[1] == '=') op = OP_LESS_EQUAL;
+    else if (cursor[0] == '>' && cursor[1] == '=') op = OP_GREATER_EQUAL;
+    else {
+        length = 1;
+        switch (cursor[0]) {
+        case '=': op = OP_EQUAL; break;
+        case '#': op = OP_NOT_EQUAL; break;
+        case '<': op = OP_LESS; break;
+        case '>': op = OP_GREATER; break;
+        case '$': op = OP_CONTAINS; break;
+        default: return left;
+        }
+    }
+    cursor += length;
+
+    int right = ParseSum();
+    char type = TypeOf(left);
+    if (right < 0 || TypeOf(right) != type) return -1;
+    if (op == OP_CONTAINS && type != 'C') return -1;
+    if (type == 'L' && op != OP_EQUAL && op != OP_EXACT && op != OP_NOT_EQUAL) return -1;
+    return Fold(Add(op, 'L', { left, right }));
+}
+
+int ForExpression::ParseSum() {
+    int left = ParseProduct();
+    while (left >= 0) {
+        SkipBlanks();
+        char sign = *cursor;
+        if (sign != '+' && (sign != '-' || cursor[1] == '>')) break;
+        ++cursor;
+
+        int right = ParseProduct();
+        if (right < 0) return -1;
+
+        char lt = TypeOf(left), rt = TypeOf(right);
+        if (sign == '+') {
+            if (lt == 'C' && rt == 'C') left = Add(OP_CONCAT, 'C', { left, right });
+            else if (lt == 'N' && rt == 'N') left = Add(OP_ADD, 'N', { left, right });
+            else if (lt == 'D' && rt == 'N') left = Add(OP_DATE_ADD, 'D', { left, right });
+            else if (lt == 'N' && rt == 'D') left = Add(OP_DATE_ADD, 'D', { right, left });
+            else return -1;
+        }
+        else {
+            if (lt == 'C' && rt == 'C') left = Add(OP_CONCAT_TRIM, 'C', { left, right });
+            else if (lt == 'N' && rt == 'N') left = Add(OP_SUBTRACT, 'N', { left, right });
+            else if (lt == 'D' && rt == 'N') left = Add(OP_DATE_SUBTRACT, 'D', { left, right });
+            else if (lt == 'D' && rt == 'D') left = Add(OP_DATE_DIFF, 'N', { left, right });
+            else return -1;
+        }
+        left = Fold(left);
+    }
+    return left;
+}
+
+int ForExpression::ParseProduct() {
+    int left = ParseUnary();
+    while (left >= 0) {
+        SkipBlanks();
+        char op = *cursor;
+        if (op != '*' && op != '/') break;
+        ++cursor;
+
+        int right = ParseUnary();
+        if (right < 0 || TypeOf(left) != 'N' || TypeOf(right) != 'N') return -1;
+        left = Fold(Add(op == '*' ? OP_MULTIPLY : OP_DIVIDE, 'N', { left, right }));
+    }
+    return left;
+}
+
+int ForExpression::ParseUnary() {
+    SkipBlanks();
+    if (cursor[0] == '-' && cursor[1] != '>') {
+        ++cursor;
+        int operand = ParseUnary();
+        if (operand < 0 || TypeOf(operand) != 'N') return -1;
+        return Fold(Add(OP_NEGATE, 'N', { operand }));
+    }
+    if (*cursor == '+') {
+        ++cursor;
+        int operand = ParseUnary();
+        return TypeOf(operand) == 'N' ? operand : -1;
+    }
+    return ParsePrimary();
+}
+
+int ForExpression::ParsePrimary() {
+    SkipBlanks();
+    char c = *cursor;
+
+    if (c == '(') {
+        ++cursor;
+        int inner = ParseOr();
+        return inner >= 0 && Accept(')') ? inner : -1;
+    }
+    if (c == '\'' || c == '"' || c == '[') return ParseLiteral();
+    if (c == '{') return ParseDateLiteral();
+
+    if (isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)cursor[1]))) {
+        // A '.' not followed by a digit starts .AND. and the like
+        const char* start = cursor;
+        while (isdigit((unsigned char)*cursor)) ++cursor;
+        if (*cursor == '.' && isdigit((unsigned char)cursor[1])) {
+            ++cursor;
+            while (isdigit((unsigned char)*cursor)) ++cursor;
+        }
+        return AddConstant('N', "", strtod(std::string(start, cursor).c_str(), nullptr), false);
+    }
+
+    if (AcceptWord(".T.") || AcceptWord(".Y.")) return AddConstant('L', "", 0, true);
+    if (AcceptWord(".F.") || AcceptWord(".N.")) return AddConstant('L', "", 0, false);
+
+    std::string name;
+    if (!ParseName(name)) return -1;
+
+    // alias->name, m->name or m.name
+    bool memory_only = false;
+    SkipBlanks();
+    if (cursor[0] == '-' && cursor[1] == '>') {
+        cursor += 2;
+        memory_only = name == "M";
+        if (!ParseName(name)) return -1;
+    }
+    else if (name == "M" && cursor[0] == '.' && isalpha((unsigned char)cursor[1]) &&
+        _strnicmp(cursor, ".AND.", 5) != 0 && _strnicmp(cursor, ".OR.", 4) != 0 && _strnicmp(cursor, ".NOT.", 5) != 0) {
+        ++cursor;
+        memory_only = true;
+        if (!ParseName(name)) return -1;
+    }
+
+    if (!memory_only && Accept('(')) {
+        int call = ParseFunction(name);
+        return call >= 0 && Accept(')') ? call : -1;
+    }
+    return Resolve(name, memory_only);
+}
+
+int ForExpression::ParseLiteral() {
+    char close = *cursor == '[' ? ']' : *cursor;
+    const char* start = ++cursor;
+    while (*cursor && *cursor != close) ++cursor;
+    if (*cursor != close) return -1;
+
+    std::string text(start, cursor++ - start);
+    return AddConstant('C', text, 0, false);
+}
+
+// {^2010-08-01}, {08/01/2010}, {08/01/10}; {} and { / / } are the blank date
+int ForExpression::ParseDateLiteral() {
+    const char* start = ++cursor;
+    while (*cursor && *cursor != '}') ++cursor;
+    if (*cursor != '}') return -1;
+
+    std::string_view text = TrimLeft(TrimRight(std::string_view(start, cursor++ - start)));
+    bool iso = !text.empty() && text[0] == '^';
+    if (iso) text.remove_prefix(1);
+    if (text.find_first_of("0123456789") == std::string_view::npos) return AddConstant('D', "", 0, false);
+
+    int date = ParseDateText(text, iso);
+    return date ? AddConstant('D', "", date, false) : -1;
+}
+
+// Fields first, as xBase does; m. / m-> names only memory variables
+int ForExpression::Resolve(const std::string& name, bool memory_only) {
+    if (!memory_only) {
+        for (const auto& field : *table_fields) {
+            if (_strnicmp(field.name, name.c_str(), sizeof(field.name)) != 0) continue;
+
+            char type = field.type;
+            if (type == 'F') type = 'N';
+            else if (type != 'N' && type != 'D' && type != 'L') type = 'C';
+            int node = Add(OP_FIELD, type, {});
+            nodes[node].offset = field.address;
+            nodes[node].length = field.length;
+            return node;
+        }
+    }
+
+    auto found = variables.find(name);
+    if (found == variables.end()) return -1;
+    const Variable& var = found->second;
+    return AddConstant(var.type, var.text, var.number, var.logical);
+}
+
+int ForExpression::ParseFunction(const std::string& name) {
+    std::vector<int> args;
+    SkipBlanks();
+    if (*cursor != ')') {
+        do {
+            int arg = ParseOr();
+            if (arg < 0) return -1;
+            args.push_back(arg);
+        } while (Accept(','));
+    }
+
+    // Argument types, one letter each; '?' takes any type
+    auto takes = [&](const char* types) {
+        size_t count = strlen(types);
+        if (args.size() != count) return false;
+        for (size_t i = 0; i < count; ++i) {
+            if (types[i] != '?' && TypeOf(args[i]) != types[i]) return false;
+        }
+        return true;
+    };
+    auto same_type = [&](size_t from) {
+        for (size_t i = from; i < args.size(); ++i) {
+            if (TypeOf(args[i]) != TypeOf(args[0])) return false;
+        }
+        return true;
+    };
+
+    int node = -1;
+    if (name == "UPPER" && takes("C")) node = Add(OP_UPPER, 'C', args);
+    else if (name == "LOWER" && takes("C")) node = Add(OP_LOWER, 'C', args);
+    else if (name == "LEFT" && takes("CN")) node = Add(OP_LEFT, 'C', args);
+    else if (name == "RIGHT" && takes("CN")) node = Add(OP_RIGHT, 'C', args);
+    else if (name == "SUBSTR" && (takes("CN") || takes("CNN"))) node = Add(OP_SUBSTR, 'C', args);
+    else if ((name == "TRIM" || name == "RTRIM") && takes("C")) node = Add(OP_RTRIM, 'C', args);
+    else if (name == "LTRIM" && takes("C")) node = Add(OP_LTRIM, 'C', args);
+    else if (name == "ALLTRIM" && takes("C")) node = Add(OP_ALLTRIM, 'C', args);
+    else if (name == "LEN" && takes("C")) node = Add(OP_LEN, 'N', args);
+    else if (name == "EMPTY" && takes("?")) node = Add(OP_EMPTY, 'L', args);
+    else if (name == "STR" && (takes("N") || takes("NN") || takes("NNN"))) node = Add(OP_STR, 'C', args);
+    else if (name == "VAL" && takes("C")) node = Add(OP_VAL, 'N', args);
+    else if (name == "DTOS" && takes("D")) node = Add(OP_DTOS, 'C', args);
+    else if (name == "DTOC" && (takes("D") || takes("DN"))) node = Add(OP_DTOC, 'C', args);
+    else if (name == "CTOD" && takes("C")) node = Add(OP_CTOD, 'D', args);
+    else if (name == "YEAR" && takes("D")) node = Add(OP_YEAR, 'N', args);
+    else if (name == "MONTH" && takes("D")) node = Add(OP_MONTH, 'N', args);
+    else if (name == "DAY" && takes("D")) node = Add(OP_DAY, 'N', args);
+    else if (name == "ABS" && takes("N")) node = Add(OP_ABS, 'N', args);
+    else if (name == "INT" && takes("N")) node = Add(OP_INT, 'N', args);
+    else if (name == "ROUND" && takes("NN")) node = Add(OP_ROUND, 'N', args);
+    else if (name == "BETWEEN" && takes("???") && same_type(1) && TypeOf(args[0]) != 'L') node = Add(OP_BETWEEN, 'L', args);
+    else if (name == "INLIST" && args.size() >= 2 && same_type(1)) node = Add(OP_INLIST, 'L', args);
+    else if (name == "IIF" && takes("L??") && TypeOf(args[1]) == TypeOf(args[2])) node = Add(OP_IIF, TypeOf(args[1]), args);
+    else if (name == "DELETED" && args.empty()) return Add(OP_DELETED, 'L', args);
+    // A record being tested is never past either end
+    else if ((name == "EOF" || name == "BOF") && args.empty()) return AddConstant('L', "", 0, false);
+
+    return node < 0 ? -1 : Fold(node);
+}
+
+int ForExpression::Add(Op op, char type, std::vector<int> args) {
+    Node node;
+    node.op = op;
+    node.type = type;
+    node.args = std::move(args);
+    switch (op) {
+    case OP_CONCAT: case OP_CONCAT_TRIM: case OP_UPPER: case OP_LOWER:
+    case OP_STR: case OP_DTOS: case OP_DTOC:
+        node.slot = slots++;
+        break;
+    default:
+        break;
+    }
+    nodes.push_back(std::move(node));
+    return (int)nodes.size() - 1;
+}
+
+int ForExpression::AddConstant(char type, const std::string& text, double number, bool logical) {
+    int index = Add(OP_CONST, type, {});
+    Node& node = nodes[index];
+    node.text = text;
+    node.number = number;
+    node.logical = logical;
+    return index;
+}
+
+// Computes a node whose operands are all constants once, here
+int ForExpression::Fold(int index) {
+    Node& node = nodes[index];
+    if (node.op == OP_CONST || node.op == OP_FIELD || node.op == OP_DELETED) return index;
+    for (int arg : node.args) {
+        if (nodes[arg].op != OP_CONST) return index;
+    }
+
+    Scratch scratch;
+    scratch.text.resize(slots);
+    Value value = Evaluate(index, nullptr, scratch);
+
+    Node& folded = nodes[index];
+    folded.text = std::string(value.text);
+    folded.number = value.number;
+    folded.logical = value.logical;
+    folded.op = OP_CONST;
+    folded.args.clear();
+    return index;
+}
+
+// SET EXACT OFF: the right side's length decides, the left is cut or
+// blank-padded to it
+int ForExpression::CompareText(std::string_view left, std::string_view right) {
+    size_t common = std::min(left.size(), right.size());
+    int result = memcmp(left.data(), right.data(), common);
+    if (result != 0 || common == right.size()) return result;
+
+    for (size_t i = common; i < right.size(); ++i) {
+        if (right[i] != ' ') return (unsigned char)right[i] > ' ' ? -1 : 1;
+    }
+    return 0;
+}
+
+int ForExpression::Compare(char type, const Value& left, const Value& right) {
+    switch (type) {
+    case 'C': return CompareText(left.text, right.text);
+    case 'L': return (int)left.logical - (int)right.logical;
+    default:  return left.number < right.number ? -1 : left.number > right.number ? 1 : 0;
+    }
+}
+
+ForExpression::Value ForExpression::Evaluate(int index, const char* record, Scratch& scratch) const {
+    const Node& node = nodes[index];
+    const std::vector<int>& args = node.args;
+    Value out;
+
+    auto arg = [&](size_t i) { return Evaluate(args[i], record, scratch); };
+
+    switch (node.op) {
+    case OP_CONST:
+        out.text = node.text;
+        out.number = node.number;
+        out.logical = node.logical;
+        break;
+
+    case OP_FIELD: {
+        const char* raw = record + node.offset;
+        switch (node.type) {
+        case 'N': out.number = ParseDBFNumber(raw, node.length); break;
+        case 'D': out.number = ReadDate(raw, node.length); break;
+        case 'L': out.logical = strchr("TtYy", raw[0]) != nullptr && raw[0] != '\0'; break;
+        default:  out.text = std::string_view(raw, node.length); break;
+        }
+        break;
+    }
+
+    case OP_DELETED: out.logical = record[0] == '*'; break;
+    case OP_AND: out.logical = arg(0).logical && arg(1).logical; break;
+    case OP_OR: out.logical = arg(0).logical || arg(1).logical; break;
+    case OP_NOT: out.logical = !arg(0).logical; break;
+
+    case OP_EQUAL: case OP_NOT_EQUAL: case OP_LESS: case OP_LESS_EQUAL:
+    case OP_GREATER: case OP_GREATER_EQUAL: {
+        int result = Compare(TypeOf(args[0]), arg(0), arg(1));
+        switch (node.op) {
+        case OP_EQUAL: out.logical = result == 0; break;
+        case OP_NOT_EQUAL: out.logical = result != 0; break;
+        case OP_LESS: out.logical = result < 0; break;
+        case OP_LESS_EQUAL: out.logical = result <= 0; break;
+        case OP_GREATER: out.logical = result > 0; break;
+        default: out.logical = result >= 0; break;
+        }
+        break;
+    }
+    case OP_EXACT: {
+        Value left = arg(0), right = arg(1);
+        out.logical = TypeOf(args[0]) == 'C' ? left.text == right.text
+                                             : Compare(TypeOf(args[0]), left, right) == 0;
+        break;
+    }
+    case OP_CONTAINS: {
+        Value needle = arg(0), haystack = arg(1);
+        out.logical = !needle.text.empty() && haystack.text.find(needle.text) != std::string_view::npos;
+        break;
+    }
+
+    case OP_ADD: out.number = arg(0).number + arg(1).number; break;
+    case OP_SUBTRACT: out.number = arg(0).number - arg(1).number; break;
+    case OP_MULTIPLY: out.number = arg(0).number * arg(1).number; break;
+    case OP_DIVIDE: {
+        double divisor = arg(1).number;
+        out.number = divisor == 0 ? 0 : arg(0).number / divisor;
+        break;
+    }
+    case OP_NEGATE: out.number = -arg(0).number; break;
+
+    case OP_CONCAT: case OP_CONCAT_TRIM: {
+        Value left = arg(0), right = arg(1);
+        std::string& text = scratch.text[node.slot];
+        if (node.op == OP_CONCAT) {
+            text.assign(left.text.data(), left.text.size());
+            text.append(right.text.data(), right.text.size());
+        }
+        else {
+            // a - b: a's trailing blanks move to the end
+            std::string_view trimmed = TrimRight(left.text);
+            text.assign(trimmed.data(), trimmed.size());
+            text.append(right.text.data(), right.text.size());
+            text.append(left.text.size() - trimmed.size(), ' ');
+        }
+        out.text = text;
+        break;
+    }
+
+    case OP_DATE_ADD: case OP_DATE_SUBTRACT: {
+        int date = (int)arg(0).number;
+        double days = arg(1).number;
+        if (node.op == OP_DATE_SUBTRACT) days = -days;
+        out.number = date ? CivilFromDays(DaysOf(date) + (long)std::floor(days)) : 0;
+        break;
+    }
+    case OP_DATE_DIFF: {
+        int left = (int)arg(0).number, right = (int)arg(1).number;
+        out.number = left && right ? (double)(DaysOf(left) - DaysOf(right)) : 0;
+        break;
+    }
+
+    case OP_UPPER: case OP_LOWER: {
+        std::string_view from = arg(0).text;
+        std::string& text = scratch.text[node.slot];
+        text.resize(from.size());
+        for (size_t i = 0; i < from.size(); ++i) {
+            unsigned char c = (unsigned char)from[i];
+            text[i] = (char)(node.op == OP_UPPER ? toupper(c) : tolower(c));
+        }
+        out.text = text;
+        break;
+    }
+    case OP_LEFT: {
+        std::string_view text = arg(0).text;
+        out.text = text.substr(0, Clamp(arg(1).number, text.size()));
+        break;
+    }
+    case OP_RIGHT: {
+        std::string_view text = arg(0).text;
+        out.text = text.substr(text.size() - Clamp(arg(1).number, text.size()));
+        break;
+    }
+    case OP_SUBSTR: {
+        std::string_view text = arg(0).text;
+        size_t start = Clamp(arg(1).number, text.size() + 1);
+        if (start == 0) break;
+        text = text.substr(start - 1);
+        out.text = args.size() > 2 ? text.substr(0, Clamp(arg(2).number, text.size())) : text;
+        break;
+    }
+    case OP_RTRIM: out.text = TrimRight(arg(0).text); break;
+    case OP_LTRIM: out.text = TrimLeft(arg(0).text); break;
+    case OP_ALLTRIM: out.text = TrimLeft(TrimRight(arg(0).text)); break;
+    case OP_LEN: out.number = (double)arg(0).text.size(); break;
+
+    case OP_EMPTY: {
+        Value value = arg(0);
+        switch (TypeOf(args[0])) {
+        case 'C': out.logical = TrimRight(value.text).empty(); break;
+        case 'L': out.logical = !value.logical; break;
+        default:  out.logical = value.number == 0; break;
+        }
+        break;
+    }
+
+    case OP_STR: {
+        // Right-justified, all asterisks when it does not fit
+        double value = arg(0).number;
+        int width = args.size() > 1 ? (int)arg(1).number : 10;
+        int decimals = args.size() > 2 ? (int)arg(2).number : 0;
+        if (width < 1) width = 1;
+        if (width > 255) width = 255;
+        if (decimals < 0 || decimals >= width) decimals = 0;
+
+        char digits[320];
+        int written = snprintf(digits, sizeof(digits), "%*.*f", width, decimals, value);
+        std::string& text = scratch.text[node.slot];
+        if (written == width) text.assign(digits, width);
+        else text.assign(width, '*');
+        out.text = text;
+        break;
+    }
+    case OP_VAL: {
+        std::string_view text = TrimLeft(arg(0).text);
+        out.number = text.empty() ? 0 : ParseDBFNumber(text.data(), text.size());
+        break;
+    }
+
+    case OP_DTOS: case OP_DTOC: {
+        int date = (int)arg(0).number;
+        bool compact = node.op == OP_DTOS || (args.size() > 1 && arg(1).number == 1);
+        char digits[16];
+        std::string& text = scratch.text[node.slot];
+        if (compact) {
+            if (date) snprintf(digits, sizeof(digits), "%08d", date);
+            text.assign(date ? digits : "        ", 8);
+        }
+        else {
+            // SET DATE AMERICAN: MM/DD/YY
+            if (date) snprintf(digits, sizeof(digits), "%02d/%02d/%02d", date / 100 % 100, date % 100, date / 10000 % 100);
+            text.assign(date ? digits : "  /  /  ", 8);
+        }
+        out.text = text;
+        break;
+    }
+    case OP_CTOD: out.number = ParseDateText(arg(0).text, false); break;
+    case OP_YEAR: out.number = (int)arg(0).number / 10000; break;
+    case OP_MONTH: out.number = (int)arg(0).number / 100 % 100; break;
+    case OP_DAY: out.number = (int)arg(0).number % 100; break;
+
+    case OP_ABS: out.number = std::fabs(arg(0).number); break;
+    case OP_INT: out.number = std::trunc(arg(0).number); break;
+    case OP_ROUND: {
+        double scale = std::pow(10.0, arg(1).number);
+        double value = arg(0).number * scale;
+        out.number = (value < 0 ? -std::floor(-value + 0.5) : std::floor(value + 0.5)) / scale;
+        break;
+    }
+
+    case OP_BETWEEN: {
+        char type = TypeOf(args[0]);
+        Value value = arg(0);
+        out.logical = Compare(type, value, arg(1)) >= 0 && Compare(type, value, arg(2)) <= 0;
+        break;
+    }
+    case OP_INLIST: {
+        char type = TypeOf(args[0]);
+        Value value = arg(0);
+        for (size_t i = 1; i < args.size() && !out.logical; ++i) out.logical = Compare(type, value, arg(i)) == 0;
+        break;
+    }
+    case OP_IIF:
+        out = arg(0).logical ? arg(1) : arg(2);
+        break;
+    }
+    return out;
+}
@@ -0,0 +1,126 @@
+#ifndef FOR_EXPRESSION_H
+#define FOR_EXPRESSION_H
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct FIELD_DESCRIPTOR;
+
+// xBase FOR / WHILE condition such as
+//     thilang>=tdo1.and.thilang<=tdo2.and.!eof()
+// compiled once against a table's fields. Field names resolve to record
+// offsets and memory variables to constants at Compile; Matches then works
+// on the raw record bytes, with text compared in place and numbers and
+// dates read straight from their digits. A &macro is substituted by the
+// caller before Compile, as FoxPro does before it parses.
+//
+// Supported: fields (alias-> prefix ignored), memory variables (m. or m->
+// prefix optional), 'text' "text" [text], numbers, .T./.F., {^yyyy-mm-dd}
+// and {mm/dd/yy[yy]} dates; .AND. .OR. .NOT. !, = == <> # != < <= > >= $,
+// + - * / (dates +- days, date - date); UPPER, LOWER, LEFT, RIGHT, SUBSTR,
+// TRIM, RTRIM, LTRIM, ALLTRIM, LEN, EMPTY, STR, VAL, DTOS, DTOC, CTOD,
+// YEAR, MONTH, DAY, ABS, INT, ROUND, BETWEEN, INLIST, IIF, DELETED, EOF
+// and BOF. Text compares as under SET EXACT OFF (= stops at the end of the
+// right side); dates are SET DATE AMERICAN with years below 50 in 20xx.
+class ForExpression {
+public:
+    // Memory variables the expression may name; set them before Compile
+    void SetText(const std::string& name, const std::string& value);
+    void SetNumber(const std::string& name, double value);
+    void SetDate(const std::string& name, const std::string& yyyymmdd);
+    void SetLogical(const std::string& name, bool value);
+
+    bool Compile(const std::string& expression, const std::vector<FIELD_DESCRIPTOR>& fields);
+    bool isCompiled() const { return root >= 0; }
+    const std::string& GetSource() const { return source; }
+
+    // Room for the text some functions build (UPPER, +, STR ...). One per
+    // thread: a compiled expression is otherwise only read.
+    struct Scratch {
+        std::vector<std::string> text;
+    };
+    bool Matches(const char* record, Scratch& scratch) const;
+    // Same on the expression's own scratch, for one thread
+    bool Matches(const char* record) { return Matches(record, own_scratch); }
+
+private:
+    enum Op {
+        OP_CONST, OP_FIELD, OP_DELETED,
+        OP_AND, OP_OR, OP_NOT,
+        OP_EQUAL, OP_EXACT, OP_NOT_EQUAL, OP_LESS, OP_LESS_EQUAL, OP_GREATER, OP_GREATER_EQUAL, OP_CONTAINS,
+        OP_ADD, OP_SUBTRACT, OP_MULTIPLY, OP_DIVIDE, OP_NEGATE,
+        OP_CONCAT, OP_CONCAT_TRIM, OP_DATE_ADD, OP_DATE_SUBTRACT, OP_DATE_DIFF,
+        OP_UPPER, OP_LOWER, OP_LEFT, OP_RIGHT, OP_SUBSTR, OP_RTRIM, OP_LTRIM, OP_ALLTRIM,
+        OP_LEN, OP_EMPTY, OP_STR, OP_VAL, OP_DTOS, OP_DTOC, OP_CTOD, OP_YEAR, OP_MONTH, OP_DAY,
+        OP_ABS, OP_INT, OP_ROUND, OP_BETWEEN, OP_INLIST, OP_IIF
+    };
+
+    // What a node evaluates to: text for 'C', number for 'N', YYYYMMDD
+    // (0 when blank) for 'D', logical for 'L'
+    struct Value {
+        std::string_view text;
+        double number = 0;
+        bool logical = false;
+    };
+
+    struct Node {
+        Op op;
+        char type;              // 'C', 'N', 'D' or 'L'
+        std::vector<int> args;  // child nodes
+        unsigned offset = 0;    // OP_FIELD: record bytes
+        unsigned length = 0;
+        std::string text;       // OP_CONST
+        double number = 0;
+        bool logical = false;
+        int slot = -1;          // scratch text built by this node
+    };
+
+    struct Variable {
+        char type;
+        std::string text;
+        double number;
+        bool logical;
+    };
+
+    std::string source;
+    std::map<std::string, Variable> variables;
+    std::vector<Node> nodes;
+    int root = -1;
+    int slots = 0;
+    Scratch own_scratch;
+
+    // Parser state, only used inside Compile
+    const std::vector<FIELD_DESCRIPTOR>* table_fields = nullptr;
+    const char* cursor = nullptr;
+
+    void SkipBlanks();
+    bool Accept(char c);
+    bool AcceptWord(const char* word);
+    bool ParseName(std::string& name);
+    int ParseOr();
+    int ParseAnd();
+    int ParseNot();
+    int ParseCompare();
+    int ParseSum();
+    int ParseProduct();
+    int ParseUnary();
+    int ParsePrimary();
+    int ParseLiteral();
+    int ParseDateLiteral();
+    int Resolve(const std::string& name, bool memory_only);
+    int ParseFunction(const std::string& name);
+    static std::string KeyName(const std::string& name);
+
+    int Add(Op op, char type, std::vector<int> args);
+    int AddConstant(char type, const std::string& text, double number, bool logical);
+    int Fold(int node);
+    char TypeOf(int node) const { return node < 0 ? 0 : nodes[node].type; }
+
+    Value Evaluate(int node, const char* record, Scratch& scratch) const;
+    static int CompareText(std::string_view left, std::string_view right);
+    static int Compare(char type, const Value& left, const Value& right);
+};
+
+#endif
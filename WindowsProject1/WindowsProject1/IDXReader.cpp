@@ -0,0 +1,154 @@
+#include "IDXReader.h"
+#include <cstring>
+
+namespace {
+    const int IDX_NODE_SIZE = 512;
+    const unsigned short IDX_LEAF = 2;
+
+    // Node pointers and record numbers are stored big-endian
+    unsigned ReadBigEndian32(const char* bytes) {
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(bytes);
+        return ((unsigned)b[0] << 24) | ((unsigned)b[1] << 16) | ((unsigned)b[2] << 8) | b[3];
+    }
+
+    std::string TrimExpression(const char* raw, size_t length) {
+        std::string value(raw, strnlen(raw, length));
+        value.erase(value.find_last_not_of(" \t") + 1);
+        return value;
+    }
+}
+
+bool IDXReader::Open(const std::string& filepath) {
+    Close();
+    idx_file.open(filepath, std::ios::binary | std::ios::in);
+    if (!idx_file) return false;
+
+    idx_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (idx_file.gcount() != sizeof(header) || header.key_length == 0 ||
+        header.key_length + 4u > sizeof(IDX_NODE::entries) || header.root_node < IDX_NODE_SIZE) {
+        Close();
+        return false;
+    }
+
+    // Compact (.CDX style) leaves pack their keys; only the plain layout is supported
+    if (header.options & 32) {
+        Close();
+        return false;
+    }
+
+    key_expression = TrimExpression(header.key_expression, sizeof(header.key_expression));
+    for_expression = TrimExpression(header.for_expression, sizeof(header.for_expression));
+    return true;
+}
+
+bool IDXReader::ReadNode(int offset, IDX_NODE& node) {
+    if (offset < IDX_NODE_SIZE) return false;
+
+    idx_file.clear();
+    idx_file.seekg(offset);
+    idx_file.read(reinterpret_cast<char*>(&node), sizeof(node));
+    if (idx_file.gcount() != sizeof(node)) return false;
+
+    return node.key_count * (header.key_length + 4u) <= sizeof(node.entries);
+}
+
+bool IDXReader::FindFirstLeaf(const std::string& prefix, IDX_NODE& leaf, unsigned& entry) {
+    const unsigned entry_size = header.key_length + 4;
+    int offset = header.root_node;
+
+    // Interior keys hold the highest key of their subtree: descend into the
+    // first child whose highest key is not below the prefix
+    for (int depth = 0; depth < 64; ++depth) {
+        if (!ReadNode(offset, leaf)) return false;
+
+        if (leaf.attributes & IDX_LEAF) {
+            for (;;) {
+                for (entry = 0; entry < leaf.key_count; ++entry) {
+                    if (memcmp(leaf.entries + entry * entry_size, prefix.data(), prefix.size()) >= 0)
+                        return true;
+                }
+                if (leaf.right_node == -1 || !ReadNode(leaf.right_node, leaf)) return false;
+            }
+        }
+
+        unsigned i = 0;
+        for (; i < leaf.key_count; ++i) {
+            const char* key = leaf.entries + i * entry_size;
+            if (memcmp(key, prefix.data(), prefix.size()) >= 0) {
+                offset = (int)ReadBigEndian32(key + header.key_length);
+                break;
+            }
+        }
+        if (i == leaf.key_count) return false; // every key sorts below the prefix
+    }
+    return false;
+}
+
+bool IDXReader::SeekPrefix(const std::string& prefix, std::vector<unsigned>& out_recnos, size_t limit) {
+    out_recnos.clear();
+    if (!isOpen() || prefix.empty() || prefix.size() > header.key_length) return false;
+
+    IDX_NODE leaf;
+    unsigned entry;
+    if (!FindFirstLeaf(prefix, leaf, entry)) return false;
+
+    const unsigned entry_size = header.key_length + 4;
+    while (out_recnos.size() < limit) {
+        if (entry == leaf.key_count) {
+            if (leaf.right_node == -1 || !ReadNode(leaf.right_node, leaf)) break;
+            entry = 0;
+            continue;
+        }
+
+        const char* key = leaf.entries + entry * entry_size;
+        if (memcmp(key, prefix.data(), prefix.size()) != 0) break;
+
+        out_recnos.push_back(ReadBigEndian32(key + header.key_length));
+        ++entry;
+    }
+    return !out_recnos.empty();
+}
+
+bool IDXReader::SeekAll(const std::string& key, std::vector<unsigned>& out_recnos) {
+    if (key.size() > header.key_length) {
+        out_recnos.clear();
+        return false;
+    }
+
+    std::string padded = key;
+    padded.resize(header.key_length, ' ');
+    return SeekPrefix(padded, out_recnos);
+}
+
+bool IDXReader::Seek(const std::string& key, unsigned& out_recno) {
+    if (!isOpen() || key.size() > header.key_length) return false;
+
+    std::string padded = key;
+    padded.resize(header.key_length, ' ');
+
+    std::vector<unsigned> recnos;
+    if (!SeekPrefix(padded, recnos, 1)) return false;
+
+    out_recno = recnos[0];
+    return true;
+}
+
+std::string IDXReader::EncodeNumericKey(double value) {
+    std::string key(8, '\0');
+    EncodeNumericKey(value, &key[0]);
+    return key;
+}
+
+void IDXReader::EncodeNumericKey(double value, char* out) {
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    // Flip so unsigned byte order matches numeric order
+    if (bits & 0x8000000000000000ull) bits = ~bits;
+    else bits |= 0x8000000000000000ull;
+
+    for (int i = 7; i >= 0; --i) {
+        out[i] = (char)(bits & 0xFF);
+        bits >>= 8;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef IDX_READER_H
+#define IDX_READER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#pragma pack(push, 1)
+struct IDX_HEADER {
+    int root_node;
+    int free_list;              // -1 when empty
+    int end_of_file;
+    unsigned short key_length;
+    unsigned char options;      // 1 unique, 8 FOR clause, 32 compact
+    unsigned char signature;
+    char key_expression[220];
+    char for_expression[220];
+    char reserved[56];
+};
+
+struct IDX_NODE {
+    unsigned short attributes;  // 0 index, 1 root, 2 leaf
+    unsigned short key_count;
+    int left_node;
+    int right_node;
+    char entries[500];          // key bytes + 4-byte big-endian pointer each
+};
+#pragma pack(pop)
+
+// Read-only access to the FoxBase/FoxPro .IDX files shipped with the app.
+// Only the header is read at open; every seek walks root-to-leaf, one
+// 512-byte node read per level, and follows right siblings for runs of
+// equal or prefixed keys. Record numbers are 1-based like FoxPro recno().
+class IDXReader {
+    std::ifstream idx_file;
+    IDX_HEADER header;
+    std::string key_expression;
+    std::string for_expression;
+
+    bool ReadNode(int offset, IDX_NODE& node);
+    bool FindFirstLeaf(const std::string& prefix, IDX_NODE& leaf, unsigned& entry);
+
+public:
+    IDXReader() = default;
+    ~IDXReader() { Close(); }
+
+    bool Open(const std::string& filepath);
+    void Close() { if (idx_file.is_open()) idx_file.close(); }
+    bool isOpen() const { return idx_file.is_open(); }
+
+    const std::string& GetKeyExpression() const { return key_expression; }
+    const std::string& GetForExpression() const { return for_expression; }
+    unsigned short GetKeyLength() const { return header.key_length; }
+    bool isUnique() const { return (header.options & 1) != 0; }
+
+    // seek key: first record whose key equals key blank-padded to key length
+    bool Seek(const std::string& key, unsigned& out_recno);
+    // Every record with exactly that key, in index order
+    bool SeekAll(const std::string& key, std::vector<unsigned>& out_recnos);
+    // Every record whose key starts with prefix (seek left(x, n) style)
+    bool SeekPrefix(const std::string& prefix, std::vector<unsigned>& out_recnos, size_t limit = SIZE_MAX);
+
+    // Key bytes for a numeric key expression (sortable IEEE double)
+    static std::string EncodeNumericKey(double value);
+    static void EncodeNumericKey(double value, char* out);
+};
+
+#endif
@@ -0,0 +1,281 @@
+#include "KeyExpression.h"
+#include "DBFManager.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+unsigned KeyExpression::Part::Length() const {
+    unsigned length = 0;
+    for (const auto& segment : segments) length += segment.length;
+    return length;
+}
+
+bool KeyExpression::Compile(const std::string& expression, const std::vector<FIELD_DESCRIPTOR>& fields) {
+    source = expression;
+    segments.clear();
+    key_length = 0;
+    table_fields = &fields;
+    cursor = source.c_str();
+
+    Part part;
+    bool ok = ParseSum(part);
+    SkipBlanks();
+    ok = ok && *cursor == '\0';
+    table_fields = nullptr;
+    cursor = nullptr;
+    if (!ok) return false;
+
+    // Fold runs of adjacent record bytes into one copy each
+    for (const auto& segment : part.segments) {
+        if (segment.length == 0) continue;
+        if (!segments.empty()) {
+            Segment& last = segments.back();
+            bool same_kind = last.kind == segment.kind && (segment.kind == SEG_COPY || segment.kind == SEG_UPPER);
+            if (same_kind && last.offset + last.length == segment.offset) {
+                last.length += segment.length;
+                continue;
+            }
+            if (last.kind == SEG_LITERAL && segment.kind == SEG_LITERAL) {
+                last.literal += segment.literal;
+                last.length += segment.length;
+                continue;
+            }
+        }
+        segments.push_back(segment);
+    }
+    key_length = part.Length();
+    return !segments.empty();
+}
+
+void KeyExpression::Extract(const char* record, char* out) const {
+    for (const auto& segment : segments) {
+        switch (segment.kind) {
+        case SEG_COPY:
+            memcpy(out, record + segment.offset, segment.length);
+            break;
+        case SEG_UPPER:
+            for (unsigned i = 0; i < segment.length; ++i)
+                out[i] = (char)toupper((unsigned char)record[segment.offset + i]);
+            break;
+        case SEG_LITERAL:
+            memcpy(out, segment.literal.data(), segment.length);
+            break;
+        case SEG_STR:
+        case SEG_NUMBER: {
+            char digits[256];
+            memcpy(digits, record + segment.offset, segment.source_length);
+            digits[segment.source_length] = '\0';
+            double value = atof(digits);
+
+            if (segment.kind == SEG_NUMBER) {
+                IDXReader::EncodeNumericKey(value, out);
+                break;
+            }
+
+            // STR(): right-justified, all asterisks when it does not fit
+            int written = snprintf(digits, sizeof(digits), "%*.*f", (int)segment.length, (int)segment.decimals, value);
+            if (written == (int)segment.length) memcpy(out, digits, segment.length);
+            else memset(out, '*', segment.length);
+            break;
+        }
+        }
+        out += segment.length;
+    }
+}
+
+void KeyExpression::Extract(const char* record, std::string& out) const {
+    out.resize(key_length);
+    Extract(record, &out[0]);
+}
+
+void KeyExpression::SkipBlanks() {
+    while (*cursor == ' ' || *cursor == '\t') ++cursor;
+}
+
+bool KeyExpression::Accept(char c) {
+    SkipBlanks();
+    if (*cursor != c) return false;
+    ++cursor;
+    return true;
+}
+
+bool KeyExpression::ParseName(std::string& name) {
+    SkipBlanks();
+    name.clear();
+    while (isalnum((unsigned char)*cursor) || *cursor == '_') name += (char)toupper((unsigned char)*cursor++);
+    return !name.empty();
+}
+
+bool KeyExpression::ParseInteger(int& value) {
+    SkipBlanks();
+    if (!isdigit((unsigned char)*cursor)) return false;
+    value = 0;
+    while (isdigit((unsigned char)*cursor)) value = value * 10 + (*cursor++ - '0');
+    return true;
+}
+
+bool KeyExpression::ParseSum(Part& out) {
+    if (!ParseTerm(out)) return false;
+
+    while (Accept('+')) {
+        Part next;
+        if (!ParseTerm(next)) return false;
+        // Only character concatenation; date and numeric + is arithmetic
+        if (out.type != 'C' || next.type != 'C') return false;
+        out.segments.insert(out.segments.end(), next.segments.begin(), next.segments.end());
+    }
+    return true;
+}
+
+bool KeyExpression::ParseTerm(Part& out) {
+    SkipBlanks();
+
+    char quote = *cursor;
+    if (quote == '\'' || quote == '"' || quote == '[') {
+        char close = quote == '[' ? ']' : quote;
+        const char* start = ++cursor;
+        while (*cursor && *cursor != close) ++cursor;
+        if (*cursor != close) return false;
+
+        std::string text(start, cursor++ - start);
+        out.type = 'C';
+        out.segments.push_back({ SEG_LITERAL, 0, (unsigned)text.size(), 0, 0, text });
+        return true;
+    }
+
+    if (Accept('(')) return ParseSum(out) && Accept(')');
+
+    std::string name;
+    if (!ParseName(name)) return false;
+
+    // alias->field: the alias is always this table
+    SkipBlanks();
+    if (cursor[0] == '-' && cursor[1] == '>') {
+        cursor += 2;
+        if (!ParseName(name)) return false;
+        SkipBlanks();
+    }
+
+    if (Accept('(')) return ParseFunction(name, out) && Accept(')');
+    return ParseField(name, out);
+}
+
+bool KeyExpression::ParseField(const std::string& name, Part& out) {
+    for (const auto& field : *table_fields) {
+        if (_strnicmp(field.name, name.c_str(), sizeof(field.name)) != 0) continue;
+
+        if (field.type == 'N' || field.type == 'F') {
+            out.type = 'N';
+            out.segments.push_back({ SEG_NUMBER, field.address, 8, field.length, field.decimal, "" });
+        }
+        else {
+            out.type = field.type == 'D' ? 'D' : 'C';
+            out.segments.push_back({ SEG_COPY, field.address, field.length, 0, 0, "" });
+        }
+        return true;
+    }
+    return false;
+}
+
+bool KeyExpression::ParseFunction(const std::string& name, Part& out) {
+    Part arg;
+    if (!ParseSum(arg)) return false;
+
+    if (name == "DTOS" || name == "DTOC") {
+        if (arg.type != 'D' || arg.segments.size() != 1) return false;
+        const Segment& date = arg.segments[0];
+        out.type = 'C';
+
+        int mode = 0;
+        if (name == "DTOC" && Accept(',') && !ParseInteger(mode)) return false;
+        if (name == "DTOS" || mode == 1) {
+            out.segments.push_back(date);
+            return true;
+        }
+
+        // DTOC(d) under SET DATE AMERICAN: MM/DD/YY
+        out.segments.push_back({ SEG_COPY, date.offset + 4, 2, 0, 0, "" });
+        out.segments.push_back({ SEG_LITERAL, 0, 1, 0, 0, "/" });
+        out.segments.push_back({ SEG_COPY, date.offset + 6, 2, 0, 0, "" });
+        out.segments.push_back({ SEG_LITERAL, 0, 1, 0, 0, "/" });
+        out.segments.push_back({ SEG_COPY, date.offset + 2, 2, 0, 0, "" });
+        return true;
+    }
+
+    if (name == "STR") {
+        if (arg.type != 'N' || arg.segments.size() != 1) return false;
+        int width = 10, decimals = 0;
+        if (Accept(',') && !ParseInteger(width)) return false;
+        if (Accept(',') && !ParseInteger(decimals)) return false;
+        if (width <= 0 || width > 255 || decimals >= width) return false;
+
+        Segment segment = arg.segments[0];
+        segment.kind = SEG_STR;
+        segment.length = width;
+        segment.decimals = (unsigned char)decimals;
+        out.type = 'C';
+        out.segments.push_back(segment);
+        return true;
+    }
+
+    if (arg.type != 'C') return false;
+
+    if (name == "UPPER") {
+        out = arg;
+        for (auto& segment : out.segments) {
+            if (segment.kind == SEG_COPY) segment.kind = SEG_UPPER;
+            for (auto& c : segment.literal) c = (char)toupper((unsigned char)c);
+        }
+        return true;
+    }
+
+    unsigned length = arg.Length();
+    int first = 0, count = 0;
+
+    if (name == "LEFT" || name == "RIGHT") {
+        if (!Accept(',') || !ParseInteger(count)) return false;
+        count = std::min<int>(count, length);
+        first = name == "LEFT" ? 0 : length - count;
+    }
+    else if (name == "SUBSTR") {
+        if (!Accept(',') || !ParseInteger(first) || first < 1 || (unsigned)first > length) return false;
+        first--;
+        count = length - first;
+        if (Accept(',') && !ParseInteger(count)) return false;
+        count = std::min<int>(count, length - first);
+    }
+    else {
+        return false;
+    }
+
+    return count > 0 && Slice(arg, first, count, out);
+}
+
+bool KeyExpression::Slice(const Part& in, unsigned start, unsigned count, Part& out) {
+    out.type = 'C';
+    unsigned end = start + count;
+    unsigned at = 0;
+
+    for (const auto& segment : in.segments) {
+        unsigned from = std::max(start, at);
+        unsigned to = std::min(end, at + segment.length);
+        if (from < to) {
+            Segment piece = segment;
+            if (segment.kind == SEG_STR || segment.kind == SEG_NUMBER) {
+                // Formatted numbers are produced whole
+                if (from != at || to != at + segment.length) return false;
+            }
+            else if (segment.kind == SEG_LITERAL) {
+                piece.literal = segment.literal.substr(from - at, to - from);
+            }
+            else {
+                piece.offset += from - at;
+            }
+            piece.length = to - from;
+            out.segments.push_back(piece);
+        }
+        at += segment.length;
+    }
+    return !out.segments.empty();
+}
@@ -0,0 +1,68 @@
+#ifndef KEY_EXPRESSION_H
+#define KEY_EXPRESSION_H
+
+#include <string>
+#include <vector>
+
+struct FIELD_DESCRIPTOR;
+
+// xBase index key expression (kbrg+DTOC(tjual,1), LEFT(no_perk,2)+STR(kredit,14)
+// and the like) compiled once against a table's fields. Extract then writes
+// the fixed-width key straight from the raw record bytes into the caller's
+// buffer, one memcpy per adjacent run of bytes.
+//
+// Supported: field names (alias-> prefix ignored), 'text' literals, +,
+// DTOC(d[,1]), DTOS(d), STR(n[,w[,d]]), LEFT, RIGHT, SUBSTR and UPPER.
+// A numeric field on its own gives the 8-byte sortable key .IDX files use;
+// a date field on its own keys on its stored YYYYMMDD bytes.
+class KeyExpression {
+public:
+    bool Compile(const std::string& expression, const std::vector<FIELD_DESCRIPTOR>& fields);
+    bool isCompiled() const { return !segments.empty(); }
+
+    const std::string& GetSource() const { return source; }
+    unsigned GetKeyLength() const { return key_length; }
+
+    // Writes exactly GetKeyLength() bytes to out
+    void Extract(const char* record, char* out) const;
+    void Extract(const char* record, std::string& out) const;
+
+private:
+    enum SegmentKind { SEG_COPY, SEG_UPPER, SEG_LITERAL, SEG_STR, SEG_NUMBER };
+
+    struct Segment {
+        SegmentKind kind;
+        unsigned offset;        // record offset of the source bytes
+        unsigned length;        // bytes written to the key
+        unsigned source_length; // numeric field width (SEG_STR, SEG_NUMBER)
+        unsigned char decimals; // STR decimals
+        std::string literal;    // SEG_LITERAL text
+    };
+
+    // What a sub-expression evaluates to while parsing
+    struct Part {
+        char type = 'C';        // 'C', 'D' or 'N'
+        std::vector<Segment> segments;
+        unsigned Length() const;
+    };
+
+    std::string source;
+    std::vector<Segment> segments;
+    unsigned key_length = 0;
+
+    // Parser state, only used inside Compile
+    const std::vector<FIELD_DESCRIPTOR>* table_fields = nullptr;
+    const char* cursor = nullptr;
+
+    void SkipBlanks();
+    bool Accept(char c);
+    bool ParseName(std::string& name);
+    bool ParseInteger(int& value);
+    bool ParseSum(Part& out);
+    bool ParseTerm(Part& out);
+    bool ParseField(const std::string& name, Part& out);
+    bool ParseFunction(const std::string& name, Part& out);
+    static bool Slice(const Part& in, unsigned start, unsigned count, Part& out);
+};
+
+#endif
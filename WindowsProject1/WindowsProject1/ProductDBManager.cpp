@@ -1,8 +1,13 @@
 #include "ProductDBManager.h"
+#include "DBFSnapshot.h"
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <cstdlib>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 Product::InventoryMovement Product::ParseMovementRecord(const std::vector<std::string>&record) {
     InventoryMovement mov;
@@ -18,70 +23,38 @@ Product::InventoryMovement Product::ParseMovementRecord(const std::vector<std::s
 }
 
 bool Product::UpdateProductStock(const std::string& productId, int quantityChange) {
-    if (!BeginTransaction()) return false;
+    ProductFields product;
+    if (!GetProduct(productId, product)) return false;
 
-    try {
-        ProductFields product;
-        if (!GetProduct(productId, product)) {
-            RollbackTransaction();
-            return false;
-        }
+    product.stock += quantityChange;
+    return UpdateTypedRecord("ID", productId, product, true);
+}
 
-        product.stock += quantityChange;
+const char* const Product::MOVEMENT_KEY = "PRODUCT_DATE";
 
-        std::map<std::string, std::string> update = {
-            {"STOCK", std::to_string(product.stock)}
-        };
+Product::Product() : DBFTableManager("products.dbf"), movementsDB("inventory_movements.dbf"),
+    transactions("products.mjl", { this, &movementsDB }) {
 
-        if (!UpdateRecord("ID", productId, update)) {
-            RollbackTransaction();
-            return false;
-        }
+    // Layouts come from the DBFSchema specialisations in ProductDBManager.h
+    fieldDescriptors = DBFRecordLayout<ProductFields>::Descriptors();
+    movementFields = DBFRecordLayout<InventoryMovement>::Descriptors();
+    for (const auto& desc : movementFields) movementsDB.AddFieldDescriptor(desc);
+    movementsDB.AddExpressionIndex(MOVEMENT_KEY, "PRODUCTID+DTOS(DATE)");
 
-        if (!CommitTransaction()) {
-            RollbackTransaction();
-            return false;
-        }
-
-        return true;
-    }
-    catch (...) {
-        RollbackTransaction();
-        return false;
-    }
+    AddPersistentIndex("ID");
 }
 
-Product::Product() : DBFTableManager("products.dbf"), movementsDB("inventory_movements.dbf") {
-
-    fieldDescriptors = {
-        {"ID",        'C', 0, 10, 0},
-        {"NAME",      'C', 0, 30, 0},
-        {"COST",      'N', 0, 12, 2},
-        {"PRICE",     'N', 0, 12, 2},
-        {"STOCK",     'N', 0, 8, 0},
-        {"SUPPLIERID",'C', 0, 10, 0}
-    };
-
-    movementFields = {
-        {"DATE",      'D', 0, 8, 0},
-        {"PRODUCTID", 'C', 0, 10, 0},
-        {"QUANTITY",  'N', 0, 8, 0},
-        {"UNITCOST",  'N', 0, 12, 2},
-        {"TYPE",      'C', 0, 10, 0},
-        {"REFERENCE", 'C', 0, 20, 0}
-    };
+Product::~Product() {
+    std::lock_guard<std::mutex> guard(costLayersLock);
+    if (costLayersLoaded && costLayers.Unsaved() > 0) costLayers.Save(CostLayersPath());
 }
 
 bool Product::AddProduct(const ProductFields& product) {
-    std::map<std::string, std::string> record = {
-        {"ID", product.id},
-        {"NAME", product.name},
-        {"COST", std::to_string(product.cost)},
-        {"PRICE", std::to_string(product.price)},
-        {"STOCK", std::to_string(product.stock)},
-        {"SUPPLIERID", product.supplierId}
-    };
-    return AddRecord(record);
+    return AddTypedRecord(product);
+}
+
+bool Product::GetProduct(const std::string& id, ProductFields& out) {
+    return GetTypedRecord("ID", id, out);
 }
 
 bool Product::DeleteProduct(const std::string& id) {
@@ -89,26 +62,19 @@ bool Product::DeleteProduct(const std::string& id) {
 }
 
 bool Product::UpdateProduct(const std::string& id, const ProductFields& updates) {
-    std::map<std::string, std::string> recordUpdates = {
-        {"NAME", updates.name},
-        {"COST", std::to_string(updates.cost)},
-        {"PRICE", std::to_string(updates.price)},
-        {"STOCK", std::to_string(updates.stock)},
-        {"SUPPLIERID", updates.supplierId}
-    };
-    return UpdateRecord("ID", id, recordUpdates);
+    // The key stays the same whatever updates.id says
+    ProductFields record = updates;
+    record.id = id;
+    return UpdateTypedRecord("ID", id, record);
 }
 
 bool Product::RecordMovement(const InventoryMovement& movement) {
-    std::map<std::string, std::string> record = {
-        {"DATE", movement.date},
-        {"PRODUCTID", movement.productId},
-        {"QUANTITY", std::to_string(movement.quantity)},
-        {"UNITCOST", std::to_string(movement.unitCost)},
-        {"TYPE", movement.type},
-        {"REFERENCE", movement.reference}
-    };
-    return movementsDB.AddRecord(record);
+    // Other threads may be leading a batch on the same table
+    if (!transactions.Execute([&] { return movementsDB.AddTypedRecord(movement, true); })) return false;
+
+    std::lock_guard<std::mutex> guard(costLayersLock);
+    SyncCostLayers(movementsDB.OpenSnapshot().get());
+    return true;
 }
 
 bool Product::RecordPurchase(const std::string& productId,
@@ -116,62 +82,32 @@ bool Product::RecordPurchase(const std::string& productId,
     int quantity,
     double unitCost,
     const std::string& reference) {
-    if (!BeginTransaction() || !movementsDB.BeginTransaction()) {
-        return false;
-    }
-
-    try {
-        InventoryMovement movement;
-        movement.date = date;
-        movement.productId = productId;
-        movement.quantity = quantity;
-        movement.unitCost = unitCost;
-        movement.type = "PURCHASE";
-        movement.reference = reference;
-
-        if (!RecordMovement(movement)) {
-            RollbackTransaction();
-            movementsDB.RollbackTransaction();
-            return false;
-        }
-
-        if (!UpdateProductStock(productId, quantity)) {
-            RollbackTransaction();
-            movementsDB.RollbackTransaction();
-            return false;
-        }
-
-        if (!CommitTransaction() || !movementsDB.CommitTransaction()) {
-            RollbackTransaction();
-            movementsDB.RollbackTransaction();
-            return false;
-        }
-
-        return true;
-    }
-    catch (...) {
-        RollbackTransaction();
-        movementsDB.RollbackTransaction();
-        return false;
-    }
+    InventoryMovement movement;
+    movement.date = date;
+    movement.productId = productId;
+    movement.quantity = quantity;
+    movement.unitCost = unitCost;
+    movement.type = "PURCHASE";
+    movement.reference = reference;
+
+    if (!transactions.Execute([&] {
+        return movementsDB.AddTypedRecord(movement, true) &&
+            UpdateProductStock(productId, quantity);
+    })) return false;
+
+    // Outside Execute the tables are off limits; the layers read a snapshot
+    std::lock_guard<std::mutex> guard(costLayersLock);
+    SyncCostLayers(movementsDB.OpenSnapshot().get());
+    return true;
 }
 
-
 bool Product::RecordSale(const std::string& productId,
     const std::string& date,
     int quantity,
     const std::string& reference) {
-    if (!BeginTransaction() || !movementsDB.BeginTransaction()) {
-        return false;
-    }
-
-    try {
+    if (!transactions.Execute([&] {
         ProductFields product;
-        if (!GetProduct(productId, product) || product.stock < quantity) {
-            RollbackTransaction();
-            movementsDB.RollbackTransaction();
-            return false;
-        }
+        if (!GetProduct(productId, product) || product.stock < quantity) return false;
 
         InventoryMovement movement;
         movement.date = date;
@@ -181,129 +117,315 @@ bool Product::RecordSale(const std::string& productId,
         movement.type = "SALE";
         movement.reference = reference;
 
-        if (!RecordMovement(movement)) {
-            RollbackTransaction();
-            movementsDB.RollbackTransaction();
-            return false;
-        }
+        return movementsDB.AddTypedRecord(movement, true) &&
+            UpdateProductStock(productId, -quantity);
+    })) return false;
+
+    std::lock_guard<std::mutex> guard(costLayersLock);
+    SyncCostLayers(movementsDB.OpenSnapshot().get());
+    return true;
+}
 
-        if (!UpdateProductStock(productId, -quantity)) {
-            RollbackTransaction();
-            movementsDB.RollbackTransaction();
-            return false;
+// A snapshot is what may be read outside Execute while other threads
+// record movements; its PRODUCTID index is built once per committed
+// version and shared by every snapshot of it.
+//
+// On the table, keys are the product ID blank-padded to its width followed
+// by the date, so one product's movements within the window are one
+// contiguous range. Without the index every row is tested on its raw field
+// bytes instead.
+template <typename Visitor>
+bool Product::ForEachMovement(DBFSnapshot* snapshot, const std::string& productId,
+    const std::string& startDate, const std::string& endDate, Visitor visit) {
+    typedef DBFRecordLayout<InventoryMovement> Layout;
+    if (snapshot) {
+        if (!Layout::Matches(snapshot->GetFields()) || !snapshot->PrepareIndex("PRODUCTID")) return false;
+
+        std::vector<long> positions;
+        snapshot->FindAll("PRODUCTID", productId, positions);
+        std::vector<char> scratch;
+        for (long pos : positions) {
+            unsigned index = (unsigned)((pos - snapshot->GetHeaderSize()) / Layout::RecordSize);
+            const char* record = snapshot->ReadRecordBlock(index, 1, scratch);
+            if (!record) return false;
+
+            InventoryMovement mov;
+            Layout::Decode(record, mov);
+            if (mov.date < startDate || mov.date > endDate) continue;
+            visit(mov);
         }
+        return true;
+    }
 
-        if (!CommitTransaction() || !movementsDB.CommitTransaction()) {
-            RollbackTransaction();
-            movementsDB.RollbackTransaction();
-            return false;
+    DBFCursor cursor = movementsDB.OpenCursor();
+    if (!Layout::Matches(cursor.GetFields())) return false;
+
+    const unsigned idWidth = Layout::Width<1>(), dateWidth = Layout::Width<0>();
+    if (productId.size() > idWidth) return true;
+    std::string low = productId, high = productId;
+    low.resize(idWidth, ' ');
+    high.resize(idWidth, ' ');
+    low += startDate.substr(0, dateWidth);
+    high += endDate.substr(0, dateWidth);
+
+    std::vector<long> positions;
+    if (movementsDB.FindKeyRange(MOVEMENT_KEY, low, high, positions)) {
+        std::vector<char> scratch;
+        for (long pos : positions) {
+            const char* record = movementsDB.ReadRawRecord(pos, scratch);
+            if (!record) return false;
+
+            InventoryMovement mov;
+            Layout::Decode(record, mov);
+            visit(mov);
         }
+        return true;
+    }
+
+    size_t productField = cursor.FieldNumber("PRODUCTID");
+    size_t dateField = cursor.FieldNumber("DATE");
+    for (const DBFRecordView& row : cursor) {
+        std::string_view date = row.field(dateField);
+        if (row.field(productField) != productId || date < startDate || date > endDate) continue;
+
+        InventoryMovement mov;
+        DBFRecordLayout<InventoryMovement>::Decode(row.raw(), mov);
+        visit(mov);
+    }
+    return !cursor.Failed();
+}
+
+void Product::ApplyCostLayers(const InventoryMovement& movement) {
+    int32_t date = FIFOCostLayers::DateKey(movement.date);
+    if (movement.type == "PURCHASE") {
+        costLayers.Purchase(movement.productId, date, movement.quantity, movement.unitCost);
+    }
+    else if (movement.type == "SALE") {
+        costLayers.Sale(movement.productId, date, movement.quantity);
+    }
+}
 
+// Appends are applied as they come. Anything else since the last sync (a
+// delete, an update, a refilled slot or compaction, a pack) may have
+// changed movements already applied, so the table's RewriteCount moves and
+// the layers are rebuilt from scratch; so is a checkpoint that claims more
+// movements than the table holds. Movements are read from the snapshot, so
+// a transaction another thread is running is neither raced nor seen before
+// it commits; without one (a mapped table, which nobody writes) the table
+// is read directly.
+bool Product::SyncCostLayers(DBFSnapshot* snapshot) {
+    if (!costLayersLoaded) {
+        costLayers.Load(CostLayersPath());
+        costLayersLoaded = true;
+    }
+
+    unsigned records = snapshot ? snapshot->RecordCount() : movementsDB.RecordCount();
+    unsigned rewrites = snapshot ? snapshot->RewriteCount() : movementsDB.RewriteCount();
+    if (costLayers.SyncedRecords() > records || costLayers.SyncedRewrites() != rewrites) costLayers.Clear();
+    if (costLayers.SyncedRecords() == records) {
+        costLayers.SetSynced(records, rewrites);
         return true;
     }
-    catch (...) {
-        RollbackTransaction();
-        movementsDB.RollbackTransaction();
-        return false;
+
+    DBFCursor cursor = snapshot ? DBFCursor(*snapshot) : movementsDB.OpenCursor();
+    if (!DBFRecordLayout<InventoryMovement>::Matches(cursor.GetFields())) return false;
+
+    cursor.Seek(costLayers.SyncedRecords());
+    for (const DBFRecordView& row : cursor) {
+        InventoryMovement mov;
+        DBFRecordLayout<InventoryMovement>::Decode(row.raw(), mov);
+        ApplyCostLayers(mov);
     }
+    if (cursor.Failed()) return false;
+
+    costLayers.SetSynced(records, rewrites);
+    if (costLayers.Unsaved() >= COST_CHECKPOINT) costLayers.Save(CostLayersPath());
+    return true;
 }
 
-double Product::CalculateCOGS_FIFO(const std::string& productId,
-    const std::string& startDate,
-    const std::string& endDate) {
-    std::vector<std::map<std::string, std::string>> records;
-    if (!movementsDB.GetAllRecords(records)) return -1;
+// Reads what SyncCostLayers read and no further: movements past the synced
+// count are applied by the next sync, and would otherwise count twice
+bool Product::ReplayCostLayers(DBFSnapshot* snapshot, const std::string& productId) {
+    typedef DBFRecordLayout<InventoryMovement> Layout;
+    DBFCursor cursor = snapshot ? DBFCursor(*snapshot) : movementsDB.OpenCursor();
+    if (!Layout::Matches(cursor.GetFields())) return false;
 
     std::vector<InventoryMovement> movements;
-    for (const auto& record : records) {
-        InventoryMovement mov = {
-            record.at("DATE"),
-            record.at("PRODUCTID"),
-            std::stoi(record.at("QUANTITY")),
-            std::stod(record.at("UNITCOST")),
-            record.at("TYPE"),
-            record.at("REFERENCE")
-        };
-
-        if (mov.productId == productId &&
-            mov.date >= startDate &&
-            mov.date <= endDate) {
-            movements.push_back(mov);
-        }
+    size_t productField = cursor.FieldNumber("PRODUCTID");
+    for (const DBFRecordView& row : cursor) {
+        if (cursor.Recno() > costLayers.SyncedRecords()) break;
+        if (row.field(productField) != productId) continue;
+
+        InventoryMovement mov;
+        Layout::Decode(row.raw(), mov);
+        movements.push_back(mov);
     }
+    if (cursor.Failed()) return false;
 
-    //Sort by date (FIFO)
-    std::sort(movements.begin(), movements.end(),
+    // Same-day movements keep file order
+    std::stable_sort(movements.begin(), movements.end(),
         [](const InventoryMovement& a, const InventoryMovement& b) {
             return a.date < b.date;
         });
 
-    //Create a separate list of available purchases
-    std::vector<std::pair<double, int>> availablePurchases; // <unitCost, quantity>
-    for (const auto& mov : movements) {
-        if (mov.type == "PURCHASE") {
-            availablePurchases.emplace_back(mov.unitCost, mov.quantity);
-        }
-    }
-
-    double cogs = 0;
-    size_t currentPurchase = 0;
-
-    for (const auto& mov : movements) {
-        if (mov.type == "SALE") {
-            int remaining = abs(mov.quantity);
-
-            // Consume from available purchases in FIFO order
-            while (remaining > 0 && currentPurchase < availablePurchases.size()) {
-                int available = availablePurchases[currentPurchase].second;
-                int used = (remaining < available) ? remaining : available;
+    costLayers.Reset(productId);
+    for (const auto& mov : movements) ApplyCostLayers(mov);
+    return true;
+}
 
-                cogs += used * availablePurchases[currentPurchase].first;
-                remaining -= used;
-                availablePurchases[currentPurchase].second -= used;
+bool Product::RebuildCostLayers() {
+    std::lock_guard<std::mutex> guard(costLayersLock);
+    costLayers.Clear();
+    costLayersLoaded = true;
+    return SyncCostLayers(movementsDB.OpenSnapshot().get()) && costLayers.Save(CostLayersPath());
+}
 
-                if (availablePurchases[currentPurchase].second == 0) {
-                    currentPurchase++;
-                }
-            }
-        }
-    }
-    return cogs;
+double Product::CalculateCOGS_FIFO(const std::string& productId,
+    const std::string& startDate,
+    const std::string& endDate) {
+    std::lock_guard<std::mutex> guard(costLayersLock);
+    // Sync and replay read the same committed version
+    std::shared_ptr<DBFSnapshot> snapshot = movementsDB.OpenSnapshot();
+    if (!SyncCostLayers(snapshot.get())) return -1;
+    if (costLayers.NeedsReplay(productId) && !ReplayCostLayers(snapshot.get(), productId)) return -1;
+
+    return costLayers.COGS(productId, FIFOCostLayers::DateKey(startDate),
+        FIFOCostLayers::DateKey(endDate));
 }
 
 double Product::CalculateCOGS_Average(const std::string& productId,
     const std::string& startDate,
     const std::string& endDate) {
-    std::vector<std::map<std::string, std::string>> records;
-    if (!movementsDB.GetAllRecords(records)) return -1;
-
     double totalCost = 0;
     int totalUnits = 0;
     int soldUnits = 0;
 
-    for (const auto& record : records) {
-        InventoryMovement mov = {
-            record.at("DATE"),
-            record.at("PRODUCTID"),
-            std::stoi(record.at("QUANTITY")),
-            std::stod(record.at("UNITCOST")),
-            record.at("TYPE"),
-            record.at("REFERENCE")
-        };
-
-        if (mov.productId == productId &&
-            mov.date >= startDate &&
-            mov.date <= endDate) {
-            if (mov.type == "PURCHASE") {
-                totalCost += mov.quantity * mov.unitCost;
-                totalUnits += mov.quantity;
-            }
-            else if (mov.type == "SALE") {
-                soldUnits += abs(mov.quantity);
-            }
+    std::shared_ptr<DBFSnapshot> snapshot = movementsDB.OpenSnapshot();
+    bool ok = ForEachMovement(snapshot.get(), productId, startDate, endDate, [&](const InventoryMovement& mov) {
+        if (mov.type == "PURCHASE") {
+            totalCost += mov.quantity * mov.unitCost;
+            totalUnits += mov.quantity;
         }
-    }
+        else if (mov.type == "SALE") {
+            soldUnits += abs(mov.quantity);
+        }
+    });
+    if (!ok) return -1;
 
     if (totalUnits == 0) return 0;
     return soldUnits * (totalCost / totalUnits);
-}
\ No newline at end of file
+}
+
+namespace {
+    // What costing needs of one movement
+    struct CostMovement {
+        int32_t date;
+        int32_t quantity;
+        double unitCost;
+        bool purchase;
+        bool sale;
+    };
+    // Each product's movements in file order
+    typedef std::unordered_map<std::string, std::vector<CostMovement>> MovementsByProduct;
+}
+
+bool Product::CalculateCOGS_Batch(const std::string& startDate, const std::string& endDate,
+    std::vector<COGSResult>& out, const std::vector<std::string>& productIds, unsigned threads) {
+    typedef DBFRecordLayout<InventoryMovement> Layout;
+    out.clear();
+
+    std::unordered_set<std::string> wanted(productIds.begin(), productIds.end());
+    MovementsByProduct byProduct;
+
+    // Pass 1: every chunk buckets its rows by product; merging the chunks in
+    // order keeps each product's movements in file order
+    if (movementsDB.RecordCount() > 0) {
+        if (!Layout::Matches(movementsDB.OpenCursor().GetFields())) return false;
+
+        DBFParallelScan scan = movementsDB.OpenParallelScan(threads);
+        bool ok = scan.Reduce(
+            [&](unsigned, unsigned count, const char* records, MovementsByProduct& part) {
+                InventoryMovement mov;
+                for (unsigned i = 0; i < count; ++i) {
+                    const char* record = records + (size_t)i * Layout::RecordSize;
+                    if (record[0] == '*') continue;
+
+                    DBFFieldCodec::Decode(record + Layout::Offset<1>(), Layout::Width<1>(), mov.productId);
+                    if (!wanted.empty() && wanted.count(mov.productId) == 0) continue;
+
+                    Layout::Decode(record, mov);
+                    part[mov.productId].push_back({ FIFOCostLayers::DateKey(mov.date), mov.quantity,
+                        mov.unitCost, mov.type == "PURCHASE", mov.type == "SALE" });
+                }
+                return true;
+            },
+            [](MovementsByProduct& result, MovementsByProduct& part) {
+                for (auto& entry : part) {
+                    std::vector<CostMovement>& all = result[entry.first];
+                    all.insert(all.end(), entry.second.begin(), entry.second.end());
+                }
+            },
+            byProduct);
+        if (!ok) return false;
+    }
+
+    std::vector<std::string> ids(productIds.begin(), productIds.end());
+    if (ids.empty()) {
+        for (const auto& entry : byProduct) ids.push_back(entry.first);
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    out.resize(ids.size());
+
+    int32_t from = FIFOCostLayers::DateKey(startDate);
+    int32_t to = FIFOCostLayers::DateKey(endDate);
+
+    // Pass 2: products are independent, so workers claim them one at a time
+    std::atomic<size_t> next(0);
+    auto worker = [&] {
+        FIFOCostLayers layers;
+        std::vector<CostMovement> movements;
+        for (size_t i = next++; i < ids.size(); i = next++) {
+            COGSResult& result = out[i];
+            result.productId = ids[i];
+            result.fifo = result.average = 0;
+
+            auto found = byProduct.find(ids[i]);
+            if (found == byProduct.end()) continue;
+
+            movements = found->second;
+            std::stable_sort(movements.begin(), movements.end(),
+                [](const CostMovement& a, const CostMovement& b) { return a.date < b.date; });
+
+            double totalCost = 0;
+            int totalUnits = 0;
+            int soldUnits = 0;
+            layers.Clear();
+            for (const CostMovement& mov : movements) {
+                bool inWindow = mov.date >= from && mov.date <= to;
+                if (mov.purchase) {
+                    layers.Purchase(ids[i], mov.date, mov.quantity, mov.unitCost);
+                    if (inWindow) {
+                        totalCost += mov.quantity * mov.unitCost;
+                        totalUnits += mov.quantity;
+                    }
+                }
+                else if (mov.sale) {
+                    layers.Sale(ids[i], mov.date, mov.quantity);
+                    if (inWindow) soldUnits += abs(mov.quantity);
+                }
+            }
+
+            result.fifo = layers.COGS(ids[i], from, to);
+            if (totalUnits != 0) result.average = soldUnits * (totalCost / totalUnits);
+        }
+    };
+
+    unsigned workers = threads == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threads;
+    workers = (unsigned)std::min<size_t>(workers, ids.size());
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < workers; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool) thread.join();
+    return true;
+}
@@ -2,6 +2,9 @@
 #define PRODUCT_H
 
 #include "DBFTableManager.h"
+#include "FIFOCostLayers.h"
+#include "TransactionCoordinator.h"
+#include <mutex>
 #include <vector>
 #include <string>
 
@@ -26,6 +29,8 @@ public:
     };
 
     Product();
+    // Checkpoints the FIFO cost layers
+    ~Product();
 
     // Product CRUD operations
     bool AddProduct(const ProductFields& product);
@@ -41,6 +46,9 @@ public:
         int quantity, const std::string& reference = "");
 
     // Reporting
+    // Perpetual FIFO: sales dated within the window consume the cost layers
+    // left by every earlier movement, purchases before startDate included.
+    // Answered from cost layers kept up to date as movements are recorded.
     double CalculateCOGS_FIFO(const std::string& productId,
         const std::string& startDate,
         const std::string& endDate);
@@ -48,12 +56,88 @@ public:
         const std::string& startDate,
         const std::string& endDate);
 
+    struct COGSResult {
+        std::string productId;
+        double fifo;        // as CalculateCOGS_FIFO
+        double average;     // as CalculateCOGS_Average
+    };
+    // Both COGS of every product that has movements, or of productIds only,
+    // from one pass over the movements table instead of one per product.
+    // The pass and the per-product costing each run on threads threads
+    // (0 = every core). Results come sorted by product ID.
+    bool CalculateCOGS_Batch(const std::string& startDate, const std::string& endDate,
+        std::vector<COGSResult>& out, const std::vector<std::string>& productIds = {},
+        unsigned threads = 0);
+
+    // Rebuilds the FIFO cost layers from the movements table. Deletes and
+    // updates made through DBFManager are noticed on their own; this is
+    // for a table some other program has edited.
+    bool RebuildCostLayers();
+
 private:
     DBFTableManager movementsDB;
     std::vector<FIELD_DESCRIPTOR> movementFields;
+    // Purchases and sales commit products and movements together
+    TransactionCoordinator transactions;
+
+    // Saved to inventory_movements.dbf.fifo every COST_CHECKPOINT movements
+    // and on destruction. Callers of Record* on several threads share them,
+    // so they are only touched under costLayersLock.
+    static const unsigned COST_CHECKPOINT = 256;
+    std::mutex costLayersLock;
+    FIFOCostLayers costLayers;
+    bool costLayersLoaded = false;
+
+    std::string CostLayersPath() const { return movementsDB.GetFileName() + ".fifo"; }
+    // Loads the checkpoint once, then applies the movements appended since,
+    // as snapshot holds them. Caller holds costLayersLock.
+    bool SyncCostLayers(DBFSnapshot* snapshot);
+    // Applies one product's movements again, in date order, from the
+    // snapshot the layers were just synced with
+    bool ReplayCostLayers(DBFSnapshot* snapshot, const std::string& productId);
+    void ApplyCostLayers(const InventoryMovement& movement);
+
+    // Only called inside a coordinated transaction
     bool UpdateProductStock(const std::string& productId, int quantityChange);
 
     InventoryMovement ParseMovementRecord(const std::vector<std::string>& record);
+
+    // Movements ordered by product, then date: PRODUCTID+DTOS(DATE)
+    static const char* const MOVEMENT_KEY;
+
+    // Calls visit(movement) for every movement of productId dated within
+    // [startDate, endDate]. Reads the snapshot through its PRODUCTID index,
+    // in file order; without a snapshot (a mapped table, which nobody
+    // writes) the table through the MOVEMENT_KEY index, by date. False if
+    // the movements can't be read.
+    template <typename Visitor>
+    bool ForEachMovement(DBFSnapshot* snapshot, const std::string& productId,
+        const std::string& startDate, const std::string& endDate, Visitor visit);
+};
+
+// products.dbf and inventory_movements.dbf layouts
+template <>
+struct DBFSchema<Product::ProductFields> {
+    typedef Product::ProductFields P;
+    static constexpr auto fields = std::make_tuple(
+        MakeDBFField("ID", 'C', 10, 0, &P::id),
+        MakeDBFField("NAME", 'C', 30, 0, &P::name),
+        MakeDBFField("COST", 'N', 12, 2, &P::cost),
+        MakeDBFField("PRICE", 'N', 12, 2, &P::price),
+        MakeDBFField("STOCK", 'N', 8, 0, &P::stock),
+        MakeDBFField("SUPPLIERID", 'C', 10, 0, &P::supplierId));
+};
+
+template <>
+struct DBFSchema<Product::InventoryMovement> {
+    typedef Product::InventoryMovement M;
+    static constexpr auto fields = std::make_tuple(
+        MakeDBFField("DATE", 'D', 8, 0, &M::date),
+        MakeDBFField("PRODUCTID", 'C', 10, 0, &M::productId),
+        MakeDBFField("QUANTITY", 'N', 8, 0, &M::quantity),
+        MakeDBFField("UNITCOST", 'N', 12, 2, &M::unitCost),
+        MakeDBFField("TYPE", 'C', 10, 0, &M::type),
+        MakeDBFField("REFERENCE", 'C', 20, 0, &M::reference));
 };
 
 #endif
\ No newline at end of file
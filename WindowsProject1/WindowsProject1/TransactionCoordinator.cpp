@@ -0,0 +1,131 @@
+#include "TransactionCoordinator.h"
+#include <cstdio>
+#include <fstream>
+
+bool TransactionCoordinator::Execute(const Work& work) {
+    Pending pending;
+    pending.work = &work;
+
+    std::unique_lock<std::mutex> guard(lock);
+    queue.push_back(&pending);
+
+    // Someone else is committing: our work rides along in their next batch
+    while (leader_active && !pending.done) finished.wait(guard);
+    if (pending.done) return pending.result;
+
+    leader_active = true;
+    std::vector<Pending*> batch;
+    try {
+        while (!queue.empty()) {
+            batch.assign(queue.begin(), queue.end());
+            queue.clear();
+
+            guard.unlock();
+            RunBatch(batch);
+            guard.lock();
+
+            for (Pending* item : batch) item->done = true;
+            batch.clear();
+            finished.notify_all();
+        }
+    }
+    catch (...) {
+        // Whatever escaped, the waiters must not sleep on a leader that is
+        // gone: finish the batch in flight and let one of them lead
+        if (!guard.owns_lock()) guard.lock();
+        for (Pending* item : batch) item->done = true;
+        leader_active = false;
+        finished.notify_all();
+        throw;
+    }
+    leader_active = false;
+    return pending.result;
+}
+
+void TransactionCoordinator::RunBatch(const std::vector<Pending*>& batch) {
+    if (RunAll(batch)) return;
+
+    // One failure must not sink the others: retry each on its own
+    if (batch.size() > 1) {
+        for (Pending* item : batch) RunAll({ item });
+    }
+}
+
+bool TransactionCoordinator::RunAll(const std::vector<Pending*>& batch) {
+    for (Pending* item : batch) item->result = false;
+
+    bool ok = true;
+    try {
+        if (!Begin()) return false;
+
+        for (Pending* item : batch) {
+            try {
+                ok = (*item->work)();
+            }
+            catch (...) {
+                ok = false;
+            }
+            if (!ok) break;
+        }
+        ok = ok && Commit();
+    }
+    catch (...) {
+        ok = false; // Begin or Commit threw part way; undo what is open
+    }
+
+    if (!ok) {
+        Rollback();
+        return false;
+    }
+
+    works += batch.size();
+    for (Pending* item : batch) item->result = true;
+    return true;
+}
+
+bool TransactionCoordinator::Begin() {
+    // Opening first lets each table settle any journal left by a crash
+    // before a new master file exists for it to misread
+    for (DBFTableManager* table : tables) {
+        if (!table->Open() && !table->CreateDB()) return false;
+    }
+
+    // The master must be on the disk before any journal names it: a journal
+    // whose master is missing after a crash counts as committed
+    std::ofstream master(master_journal, std::ios::trunc);
+    for (DBFTableManager* table : tables) master << table->GetFileName() << '\n';
+    master.close();
+    if (!master || !DBFManager::SyncFile(master_journal)) {
+        remove(master_journal.c_str());
+        return false;
+    }
+
+    for (size_t i = 0; i < tables.size(); ++i) {
+        if (tables[i]->BeginTransaction(master_journal)) continue;
+
+        for (size_t j = 0; j < i; ++j) tables[j]->RollbackTransaction();
+        remove(master_journal.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool TransactionCoordinator::Commit() {
+    // Every table durable first (each forces its journal to the disk before
+    // its data), then the single commit point
+    for (DBFTableManager* table : tables) {
+        if (!table->SyncToDisk()) return false;
+    }
+    if (remove(master_journal.c_str()) != 0) return false;
+
+    // From here the transaction stands even if a journal removal fails:
+    // a leftover journal whose master is gone is discarded at next open
+    for (DBFTableManager* table : tables) table->CommitTransaction();
+    commits++;
+    return true;
+}
+
+void TransactionCoordinator::Rollback() {
+    for (DBFTableManager* table : tables) table->RollbackTransaction();
+    remove(master_journal.c_str());
+}
@@ -0,0 +1,59 @@
+#ifndef TRANSACTION_COORDINATOR_H
+#define TRANSACTION_COORDINATOR_H
+
+#include "DBFTableManager.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One atomic transaction over several tables. Every table journals under a
+// shared master journal file; deleting that file is the single commit
+// point, so after a crash either all tables keep the change or all undo it.
+//
+// Execute may be called from many threads. Work arriving while a commit is
+// being flushed waits and is then run together in the next transaction, so
+// a burst of sales costs one disk flush per table instead of one per sale.
+// Work runs on whichever caller leads the batch; while a coordinator is in
+// use, its tables must only be touched from inside Execute.
+class TransactionCoordinator {
+public:
+    typedef std::function<bool()> Work;
+
+    TransactionCoordinator(const std::string& masterJournal, const std::vector<DBFTableManager*>& tables)
+        : master_journal(masterJournal), tables(tables) {}
+
+    // Runs work atomically with respect to all tables. Returning false (or
+    // throwing) undoes everything work did and nothing else.
+    bool Execute(const Work& work);
+
+    unsigned long GetCommitCount() const { return commits; }
+    unsigned long GetWorkCount() const { return works; }
+
+private:
+    struct Pending {
+        const Work* work;
+        bool done = false;
+        bool result = false;
+    };
+
+    std::string master_journal;
+    std::vector<DBFTableManager*> tables;
+
+    std::mutex lock;
+    std::condition_variable finished;
+    std::deque<Pending*> queue;
+    bool leader_active = false;
+    unsigned long commits = 0;
+    unsigned long works = 0;
+
+    void RunBatch(const std::vector<Pending*>& batch);
+    bool RunAll(const std::vector<Pending*>& batch);
+    bool Begin();
+    bool Commit();
+    void Rollback();
+};
+
+#endif